@@ -24,9 +24,9 @@
 
 bool chr::ApeInstance::Load( const std::string &filename )
 {
-	void *ptr;
+	const void *ptr;
 
-	ssize_t size = FS_LoadFile( filename.c_str(), &ptr );
+	ssize_t size = FS_MapFile( filename.c_str(), &ptr );
 	if ( size == -1 || ptr == nullptr )
 	{
 		Com_Printf( "Failed to load ape file (%s)!\n", filename.c_str() );
@@ -39,7 +39,7 @@ bool chr::ApeInstance::Load( const std::string &filename )
 		Com_Printf( "Failed to parse ape file (%s)!\n", filename.c_str() );
 	}
 
-	FS_FreeFile( ptr );
+	FS_UnmapFile( ptr );
 
 	return success;
 }
@@ -18,13 +18,17 @@
 	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 ******************************************************************************/
 
-#include <SDL2/SDL.h>
+#if !defined( DEDICATED_ONLY )
+#	include <SDL2/SDL.h>
+#endif
 
 #if defined( _WIN32 )
 #	include <windows.h>
 #	include <debugapi.h>
 #endif
 
+#include <chrono>
+
 #include "qcommon/qcommon.h"
 
 #include "client/keys.h"
@@ -34,36 +38,52 @@ chr::App *chr::globalApp = nullptr;
 
 void chr::App::Initialize()
 {
+#if defined( DEDICATED_ONLY )
+	// make sure output isn't held back when it's piped into a log
+	setvbuf( stdout, nullptr, _IOLBF, BUFSIZ );
+#else
 	int status = SDL_Init( SDL_INIT_EVERYTHING );
 	if ( status != 0 )
 		Sys_Error( "Failed to initialized SDL2: %s\n", SDL_GetError() );
+#endif
 
 	Qcommon_Init( argc_, argv_ );
 }
 
 [[noreturn]] void chr::App::Run()
 {
-	unsigned int time, newTime;
-	unsigned int oldTime = GetNumMilliseconds();
 	while ( true )
 	{
-		chr::globalApp->PollEvents();
+		Qcommon_WaitForFrame();
 
-		do
-		{
-			newTime = GetNumMilliseconds();
-			time    = newTime - oldTime;
-		} while ( time < 1 );
+		chr::globalApp->PollEvents();
 
 #if defined( Q_PLATFORM_X86 )
 		_controlfp( _PC_24, _MCW_PC );
 #endif
-		Qcommon_Frame( time );
-
-		oldTime = newTime;
+		Qcommon_Frame();
 	}
 }
 
+#if defined( DEDICATED_ONLY )
+
+/* ======================================================================
+ * Dedicated servers have no window or input to deal with, and commands
+ * typed into the terminal are picked up by Qcommon_Frame.
+ * ======================================================================*/
+
+unsigned int chr::App::GetNumMilliseconds()
+{
+	static const auto start = std::chrono::steady_clock::now();
+
+	lastMs_ = ( unsigned int ) std::chrono::duration_cast< std::chrono::milliseconds >( std::chrono::steady_clock::now() - start ).count();
+	return lastMs_;
+}
+
+void chr::App::PollEvents() {}
+
+#else
+
 unsigned int sys_frame_time = 0;// todo: kill
 
 void chr::App::SendKeyEvents()
@@ -130,24 +150,26 @@ void chr::App::PollEvents()
 	}
 }
 
+void chr::App::ShowCursor( bool show )
+{
+	SDL_ShowCursor( show );
+}
+
+#endif
+
 /**
  * This pushes the given string to the native terminal/console.
  */
 void chr::App::PushConsoleOutput( const char *text )
 {
-#if defined( _WIN32 ) && defined( _MSC_VER )
+#if defined( _WIN32 ) && defined( _MSC_VER ) && !defined( DEDICATED_ONLY )
 	OutputDebugString( text );
 #else
 	printf( "%s", text );
 #endif
 }
 
-void chr::App::ShowCursor( bool show )
-{
-	SDL_ShowCursor( show );
-}
-
-#if defined( _WIN32 )
+#if defined( _WIN32 ) && !defined( DEDICATED_ONLY )
 int WINAPI WinMain( HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow )
 {
 	int    argc = __argc;
@@ -90,6 +90,7 @@ void SCR_LoadPCX( char *filename, byte **pic, byte **palette, int *width, int *h
 	if ( pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1 || pcx->bits_per_pixel != 8 || pcx->xmax >= 640 || pcx->ymax >= 480 )
 	{
 		Com_Printf( "Bad pcx file %s\n", filename );
+		FS_FreeFile( pcx );
 		return;
 	}
 
@@ -166,7 +167,7 @@ void SCR_StopCinematic( void )
 	}
 	if ( cl.cinematic_file )
 	{
-		fclose( cl.cinematic_file );
+		FS_CloseStream( cl.cinematic_file );
 		cl.cinematic_file = NULL;
 	}
 	if ( cin.hnodes1 )
@@ -199,6 +200,19 @@ void SCR_FinishCinematic( void )
 
 //==========================================================================
 
+/*
+==================
+SCR_ReadCinematic
+
+Reads the given number of bytes from the cinematic, or drops out if it ends early
+==================
+*/
+static void SCR_ReadCinematic( void *buffer, size_t length )
+{
+	if ( FS_ReadStream( cl.cinematic_file, buffer, length ) != length )
+		Com_Error( ERR_DROP, "Unexpected end of cinematic" );
+}
+
 /*
 ==================
 SmallestNode1
@@ -256,7 +270,7 @@ void Huff1TableInit( void )
 		memset( cin.h_used, 0, sizeof( cin.h_used ) );
 
 		// read a row of counts
-		FS_Read( counts, sizeof( counts ), cl.cinematic_file );
+		SCR_ReadCinematic( counts, sizeof( counts ) );
 		for ( j = 0; j < 256; j++ )
 			cin.h_count[ j ] = counts[ j ];
 
@@ -421,7 +435,6 @@ SCR_ReadNextFrame
 */
 byte *SCR_ReadNextFrame( void )
 {
-	int          r;
 	int          command;
 	byte         samples[ 22050 / 14 * 4 ];
 	byte         compressed[ 0x20000 ];
@@ -431,11 +444,7 @@ byte *SCR_ReadNextFrame( void )
 	int          start, end, count;
 
 	// read the next frame
-	r = fread( &command, 4, 1, cl.cinematic_file );
-	if ( r == 0 )// we'll give it one more chance
-		r = fread( &command, 4, 1, cl.cinematic_file );
-
-	if ( r != 1 )
+	if ( FS_ReadStream( cl.cinematic_file, &command, 4 ) != 4 )
 		return NULL;
 	command = LittleLong( command );
 	if ( command == 2 )
@@ -443,23 +452,23 @@ byte *SCR_ReadNextFrame( void )
 
 	if ( command == 1 )
 	{// read palette
-		FS_Read( cl.cinematicpalette, sizeof( cl.cinematicpalette ), cl.cinematic_file );
+		SCR_ReadCinematic( cl.cinematicpalette, sizeof( cl.cinematicpalette ) );
 		cl.cinematicpalette_active = 0;// dubious....  exposes an edge case
 	}
 
 	// decompress the next frame
-	FS_Read( &size, 4, cl.cinematic_file );
+	SCR_ReadCinematic( &size, 4 );
 	size = LittleLong( size );
 	if ( size > sizeof( compressed ) || size < 1 )
 		Com_Error( ERR_DROP, "Bad compressed frame size" );
-	FS_Read( compressed, size, cl.cinematic_file );
+	SCR_ReadCinematic( compressed, size );
 
 	// read sound
 	start = cl.cinematicframe * cin.s_rate / 14;
 	end   = ( cl.cinematicframe + 1 ) * cin.s_rate / 14;
 	count = end - start;
 
-	FS_Read( samples, count * cin.s_width * cin.s_channels, cl.cinematic_file );
+	SCR_ReadCinematic( samples, count * cin.s_width * cin.s_channels );
 
 	S_RawSamples( count, cin.s_rate, cin.s_width, cin.s_channels, samples );
 
@@ -605,7 +614,7 @@ void SCR_PlayCinematic( char *arg )
 	}
 
 	Com_sprintf (name, sizeof(name), "video/%s", arg);
-	FS_FOpenFile (name, &cl.cinematic_file);
+	cl.cinematic_file = FS_OpenStream (name, NULL);
 	if (!cl.cinematic_file)
 	{
 //		Com_Error (ERR_DROP, "Cinematic %s not found.\n", name);
@@ -618,16 +627,16 @@ void SCR_PlayCinematic( char *arg )
 
 	cls.state = ca_active;
 
-	FS_Read (&width, 4, cl.cinematic_file);
-	FS_Read (&height, 4, cl.cinematic_file);
+	SCR_ReadCinematic (&width, 4);
+	SCR_ReadCinematic (&height, 4);
 	cin.width = LittleLong(width);
 	cin.height = LittleLong(height);
 
-	FS_Read (&cin.s_rate, 4, cl.cinematic_file);
+	SCR_ReadCinematic (&cin.s_rate, 4);
 	cin.s_rate = LittleLong(cin.s_rate);
-	FS_Read (&cin.s_width, 4, cl.cinematic_file);
+	SCR_ReadCinematic (&cin.s_width, 4);
 	cin.s_width = LittleLong(cin.s_width);
-	FS_Read (&cin.s_channels, 4, cl.cinematic_file);
+	SCR_ReadCinematic (&cin.s_channels, 4);
 	cin.s_channels = LittleLong(cin.s_channels);
 
 	Huff1TableInit ();
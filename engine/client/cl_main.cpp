@@ -1701,6 +1701,23 @@ void CL_SendCommand()
 	CL_CheckForResend();
 }
 
+/**
+ * How long to leave between client frames, in microseconds, or 0 if there's
+ * no client to run.
+ */
+uint64_t CL_GetFrameInterval()
+{
+	if ( dedicated->value )
+		return 0;
+
+	// timedemos run as fast as they can
+	if ( cl_timedemo->value )
+		return 1;
+
+	float rate = std::clamp( cl_maxfps->value, 10.0f, 1000.0f );
+	return ( uint64_t ) ( 1000000.0f / rate );
+}
+
 void CL_Frame( unsigned int msec )
 {
 	static unsigned int extratime;
@@ -1709,14 +1726,14 @@ void CL_Frame( unsigned int msec )
 	if ( dedicated->value )
 		return;
 
+	PROFILE_ZONE( "CL_Frame" );
+
 	extratime += msec;
 
 	if ( !cl_timedemo->value )
 	{
 		if ( cls.state == ca_connected && extratime < 100 )
 			return;// don't flood packets out while connecting
-		if ( extratime < 1000 / cl_maxfps->value )
-			return;// framerate is too high
 	}
 
 	// let the mouse activate or deactivate
@@ -1755,11 +1772,7 @@ void CL_Frame( unsigned int msec )
 		CL_PrepRefresh();
 
 	// update the screen
-	if ( host_speeds->value )
-		time_before_ref = chr::globalApp->GetNumMilliseconds();
 	SCR_UpdateScreen();
-	if ( host_speeds->value )
-		time_after_ref = chr::globalApp->GetNumMilliseconds();
 
 	// update audio
 	S_Update( cl.refdef.vieworg, cl.v_forward, cl.v_right, cl.v_up );
@@ -784,7 +784,7 @@ static const char *sb_nums[ 2 ][ 11 ] =
 
 #define ICON_WIDTH  24
 #define ICON_HEIGHT 24
-#define CHAR_WIDTH  16
+#define FIELD_CHAR_WIDTH 16
 #define ICON_SPACE  8
 
 
@@ -871,7 +871,7 @@ void SCR_DrawField( int x, int y, int color, int width, int value )
 		width = 5;
 
 	SCR_AddDirtyPoint( x, y );
-	SCR_AddDirtyPoint( x + width * CHAR_WIDTH + 2, y + 23 );
+	SCR_AddDirtyPoint( x + width * FIELD_CHAR_WIDTH + 2, y + 23 );
 
 	Com_sprintf( num, sizeof( num ), "%i", value );
 	size_t l = strlen( num );
@@ -880,7 +880,7 @@ void SCR_DrawField( int x, int y, int color, int width, int value )
 		l = width;
 	}
 
-	x += 2 + CHAR_WIDTH * ( width - ( int ) l );
+	x += 2 + FIELD_CHAR_WIDTH * ( width - ( int ) l );
 
 	ptr = num;
 	while ( *ptr && l )
@@ -895,7 +895,7 @@ void SCR_DrawField( int x, int y, int color, int width, int value )
 		}
 
 		Draw_Pic( x, y, sb_nums[ color ][ frame ] );
-		x += CHAR_WIDTH;
+		x += FIELD_CHAR_WIDTH;
 		ptr++;
 		l--;
 	}
@@ -266,6 +266,8 @@ void CL_PrepRefresh( void )
 	strcpy( mapname, cl.configstrings[ CS_MODELS + 1 ] + 5 );// skip "maps/"
 	mapname[ strlen( mapname ) - 4 ] = 0;                    // cut off ".bsp"
 
+	FS_BeginLoadManifest( mapname );
+
 	// register models, pics, and skins
 	Com_Printf( "Map: %s\r", mapname );
 	SCR_UpdateScreen();
@@ -283,6 +285,13 @@ void CL_PrepRefresh( void )
 	num_cl_weaponmodels = 1;
 	strcpy( cl_weaponmodels[ 0 ], "weapon.md2" );
 
+	// get the models reading in the background while we work through them
+	for ( i = 1; i < MAX_MODELS && cl.configstrings[ CS_MODELS + i ][ 0 ]; i++ )
+	{
+		if ( cl.configstrings[ CS_MODELS + i ][ 0 ] != '#' )
+			Mod_Prefetch( cl.configstrings[ CS_MODELS + i ] );
+	}
+
 	for ( i = 1; i < MAX_MODELS && cl.configstrings[ CS_MODELS + i ][ 0 ]; i++ )
 	{
 		strcpy( name, cl.configstrings[ CS_MODELS + i ] );
@@ -533,6 +542,10 @@ void V_RenderView()
 	}
 
 	R_RenderFrame( &cl.refdef );
+
+	// the first frame is in, so whatever the map needed has been loaded
+	FS_EndLoadManifest();
+
 	if ( cl_stats->value )
 		Com_Printf( "ent:%i  lt:%i  part:%i\n", r_numentities, r_numdlights, r_numparticles );
 	if ( log_stats->value && ( log_stats_file != 0 ) )
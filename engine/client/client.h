@@ -142,7 +142,7 @@ typedef struct
 	//
 	// non-gameserver infornamtion
 	// FIXME: move this cinematic stuff into the cin_t structure
-	FILE         *cinematic_file;
+	fsstream_t   *cinematic_file;
 	int           cinematictime;// cls.realtime for first cinematic frame
 	int           cinematicframe;
 	unsigned char cinematicpalette[ 768 ];
@@ -350,6 +350,19 @@ void S_EndRegistration( void )
 		}
 	}
 
+	// get everything that isn't already in memory reading in the background
+	for ( i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++ )
+	{
+		if ( !sfx->name[ 0 ] || sfx->name[ 0 ] == '*' || sfx->cache )
+			continue;
+
+		const char *name = sfx->truename ? sfx->truename : sfx->name;
+		if ( name[ 0 ] == '#' )
+			FS_Prefetch( &name[ 1 ] );
+		else
+			FS_Prefetch( va( "sound/%s", name ) );
+	}
+
 	// load everything in
 	for ( i = 0, sfx = known_sfx; i < num_sfx; i++, sfx++ )
 	{
@@ -1005,6 +1018,8 @@ Called once each time through the main loop
 */
 void S_Update( vec3_t origin, vec3_t forward, vec3_t right, vec3_t up )
 {
+	PROFILE_ZONE( "S_Update" );
+
 	int        i;
 	int        total;
 	channel_t *ch;
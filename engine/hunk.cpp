@@ -20,25 +20,150 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "../qcommon/qcommon.h"
 
-static int hunkcount;
+// the real thing is defined here, rather than the version that passes along where it's called from
+#undef Hunk_Begin
 
-static byte *membase;
+#if defined( _WIN32 )
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <unistd.h>
+#endif
 
-static size_t hunkmaxsize;
-static size_t cursize;
+/*
+==============================================================================
 
-void *Hunk_Begin( size_t maxsize )
+Hunks reserve address space for the worst case up front, and only commit
+pages as Hunk_Alloc works its way through them. Whatever's left over past
+the last allocation is handed back by Hunk_End.
+
+Each hunk is preceded by a header, so the base handed out is also where
+the first allocation lands.
+
+==============================================================================
+*/
+
+static constexpr size_t HUNK_HEADER_SIZE  = 64;
+static constexpr size_t HUNK_COMMIT_CHUNK = 64 * 1024; // commit in steps of this, to keep the syscalls down
+
+typedef struct hunkheader_s
+{
+	struct hunkheader_s *prev, *next;// live hunks, for hunk_stats
+	size_t               maxsize;    // as asked for
+	size_t               reserved;   // address space held, including the header
+	size_t               committed;  // likewise
+	size_t               used;       // handed out by Hunk_Alloc
+	const char          *file;       // where it was begun, if known
+	int                  line;
+	uint32_t             serial;     // for telling what's new since a snapshot
+} hunkheader_t;
+
+static_assert( sizeof( hunkheader_t ) <= HUNK_HEADER_SIZE );
+
+static hunkheader_t *hunk;// the one currently being built
+static hunkheader_t *hunkchain;
+static int           hunkcount;
+
+static size_t hunkcommitted;    // across all live hunks
+static size_t hunkpeakcommitted;// most that's been committed at once
+static size_t hunkpeakused;     // largest single hunk
+
+static uint32_t hunkserial;
+static uint32_t hunksnapshot;
+
+static size_t Hunk_PageSize()
+{
+	static size_t pagesize;
+	if ( pagesize == 0 )
+	{
+#if defined( _WIN32 )
+		SYSTEM_INFO info;
+		GetSystemInfo( &info );
+		pagesize = info.dwPageSize;
+#else
+		pagesize = ( size_t ) sysconf( _SC_PAGESIZE );
+#endif
+	}
+
+	return pagesize;
+}
+
+static size_t Hunk_RoundUp( size_t size, size_t granularity )
+{
+	return ( size + granularity - 1 ) & ~( granularity - 1 );
+}
+
+static bool Hunk_Commit( hunkheader_t *h, size_t size )
+{
+	size = std::min( Hunk_RoundUp( size, HUNK_COMMIT_CHUNK ), h->reserved );
+	if ( size <= h->committed )
+		return true;
+
+	byte *start = ( byte * ) h + h->committed;
+#if defined( _WIN32 )
+	if ( VirtualAlloc( start, size - h->committed, MEM_COMMIT, PAGE_READWRITE ) == nullptr )
+		return false;
+#else
+	if ( mprotect( start, size - h->committed, PROT_READ | PROT_WRITE ) != 0 )
+		return false;
+#endif
+
+	hunkcommitted += size - h->committed;
+	hunkpeakcommitted = std::max( hunkpeakcommitted, hunkcommitted );
+
+	h->committed = size;
+	return true;
+}
+
+void *Hunk_BeginSite( size_t maxsize, const char *file, int line )
 {
 	// reserve a huge chunk of memory, but don't commit any yet
-	cursize     = 0;
-	hunkmaxsize = maxsize;
-	membase     = ( byte     *) calloc( maxsize, sizeof( byte ) );
+	size_t reserved = Hunk_RoundUp( HUNK_HEADER_SIZE + maxsize, Hunk_PageSize() );
+#if defined( _WIN32 )
+	void *membase = VirtualAlloc( nullptr, reserved, MEM_RESERVE, PAGE_NOACCESS );
 	if ( membase == nullptr )
-	{
 		Sys_Error( "VirtualAlloc reserve failed" );
-	}
+#else
+	void *membase = mmap( nullptr, reserved, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0 );
+	if ( membase == MAP_FAILED )
+		Sys_Error( "Hunk_Begin: failed to reserve %zu bytes", reserved );
+#endif
+
+	// the header has to be writable before Hunk_Commit can track anything
+	size_t committed = std::min( HUNK_COMMIT_CHUNK, reserved );
+#if defined( _WIN32 )
+	if ( VirtualAlloc( membase, committed, MEM_COMMIT, PAGE_READWRITE ) == nullptr )
+#else
+	if ( mprotect( membase, committed, PROT_READ | PROT_WRITE ) != 0 )
+#endif
+		Sys_Error( "Hunk_Begin: failed to commit header" );
+
+	hunkcommitted += committed;
+	hunkpeakcommitted = std::max( hunkpeakcommitted, hunkcommitted );
 
-	return ( void * ) membase;
+	hunkheader_t *h = ( hunkheader_t * ) membase;
+	h->reserved     = reserved;
+	h->committed    = committed;
+	h->maxsize      = maxsize;
+	h->used         = 0;
+	h->file         = file;
+	h->line         = line;
+	h->serial       = ++hunkserial;
+	h->prev         = nullptr;
+	h->next         = hunkchain;
+	if ( hunkchain != nullptr )
+		hunkchain->prev = h;
+	hunkchain = h;
+
+	hunk = h;
+	hunkcount++;
+
+	return ( byte * ) h + HUNK_HEADER_SIZE;
+}
+
+void *Hunk_Begin( size_t maxsize )
+{
+	return Hunk_BeginSite( maxsize, nullptr, 0 );
 }
 
 void *Hunk_Alloc( size_t size )
@@ -46,29 +171,123 @@ void *Hunk_Alloc( size_t size )
 	// round to cacheline
 	size = ( size + 31 ) & ~31;
 
-	cursize += size;
-	if ( cursize > hunkmaxsize )
+	hunk->used += size;
+	if ( hunk->used > hunk->maxsize )
 	{
 		Sys_Error( "Hunk_Alloc overflow" );
 	}
 
-	return ( void * ) ( membase + cursize - size );
+	// pages come back zeroed, so there's no need to clear anything
+	if ( !Hunk_Commit( hunk, HUNK_HEADER_SIZE + hunk->used ) )
+		Sys_Error( "Hunk_Alloc: failed to commit %zu bytes", hunk->used );
+
+	return ( void * ) ( ( byte * ) hunk + HUNK_HEADER_SIZE + hunk->used - size );
 }
 
 size_t Hunk_End()
 {
 	// free the remaining unused virtual memory
-	hunkcount++;
-	//Com_Printf ("hunkcount: %i\n", hunkcount);
-	return cursize;
+	size_t keep = Hunk_RoundUp( HUNK_HEADER_SIZE + hunk->used, Hunk_PageSize() );
+	if ( keep < hunk->committed )
+	{
+#if defined( _WIN32 )
+		VirtualFree( ( byte * ) hunk + keep, hunk->committed - keep, MEM_DECOMMIT );
+#endif
+		hunkcommitted -= hunk->committed - keep;
+		hunk->committed = keep;
+	}
+
+#if !defined( _WIN32 )
+	// windows can only let go of a reservation as a whole, so the rest is just left decommitted there
+	if ( keep < hunk->reserved )
+	{
+		munmap( ( byte * ) hunk + keep, hunk->reserved - keep );
+		hunk->reserved = keep;
+	}
+#endif
+
+	hunkpeakused = std::max( hunkpeakused, hunk->used );
+
+	size_t used = hunk->used;
+	hunk        = nullptr;
+	return used;
 }
 
 void Hunk_Free( void *base )
 {
-	if ( base )
+	if ( base == nullptr )
+		return;
+
+	hunkheader_t *h = ( hunkheader_t * ) ( ( byte * ) base - HUNK_HEADER_SIZE );
+	if ( h->prev != nullptr )
+		h->prev->next = h->next;
+	else
+		hunkchain = h->next;
+	if ( h->next != nullptr )
+		h->next->prev = h->prev;
+
+	hunkcommitted -= h->committed;
+
+#if defined( _WIN32 )
+	VirtualFree( h, 0, MEM_RELEASE );
+#else
+	munmap( h, h->reserved );
+#endif
+
+	hunkcount--;
+}
+
+static void Hunk_Print( const hunkheader_t *h )
+{
+	Com_Printf( "%p: %10.2fKB used, %10.2fKB committed, %10.2fKB reserved%s",
+	            ( const byte * ) h + HUNK_HEADER_SIZE,
+	            h->used / 1024.0,
+	            h->committed / 1024.0,
+	            h->reserved / 1024.0,
+	            ( h == hunk ) ? " (building)" : "" );
+	if ( h->file != nullptr )
+		Com_Printf( " from %s:%i", COM_SkipPath( ( char * ) h->file ), h->line );
+	Com_Printf( "\n" );
+}
+
+/*
+================
+Hunk_Stats_f
+================
+*/
+void Hunk_Stats_f()
+{
+	for ( const hunkheader_t *h = hunkchain; h != nullptr; h = h->next )
+		Hunk_Print( h );
+
+	Com_Printf( "%i hunks, %.2fKB committed (%.2fKB at most), largest hunk used %.2fKB\n",
+	            hunkcount, hunkcommitted / 1024.0, hunkpeakcommitted / 1024.0, hunkpeakused / 1024.0 );
+}
+
+/**
+ * Marks where mem_report diff should start counting from.
+ */
+void Hunk_Snapshot()
+{
+	hunksnapshot = hunkserial;
+}
+
+/**
+ * Lists the hunks begun since the last snapshot that are still around.
+ */
+void Hunk_ReportSinceSnapshot()
+{
+	size_t numHunks = 0, numBytes = 0;
+	for ( const hunkheader_t *h = hunkchain; h != nullptr; h = h->next )
 	{
-		free( base );
+		if ( h->serial <= hunksnapshot )
+			continue;
+
+		Hunk_Print( h );
+
+		numHunks++;
+		numBytes += h->committed;
 	}
 
-	hunkcount--;
+	Com_Printf( "%zu hunks since the snapshot, %.2fKB committed\n", numHunks, numBytes / 1024.0 );
 }
@@ -31,6 +31,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/ioctl.h>
 #include <sys/uio.h>
 #include <cerrno>
+#include <algorithm>
 
 #ifdef NeXT
 #	include <libc.h>
@@ -267,6 +268,234 @@ void NET_SendLoopPacket( netsrc_t sock, int length, void *data, netadr_t to )
 
 //=============================================================================
 
+/*
+=============================================================================
+
+BATCHED SOCKET IO
+
+On Linux, recvmmsg and sendmmsg move a whole frame's worth of datagrams in
+a handful of syscalls rather than one each. Received packets are drained
+into a ring and handed out by NET_GetPacket one at a time, while outgoing
+ones are queued up until NET_FlushPackets. Setting net_batch to 0, or not
+having the calls at all, falls back to a syscall per packet.
+
+=============================================================================
+*/
+
+#define NET_MAX_BATCH 64
+
+#if defined( __linux__ )
+#	define NET_HAVE_MMSG
+#endif
+
+typedef struct
+{
+	byte               data[ NET_MAX_BATCH ][ MAX_MSGLEN ];
+	struct sockaddr_in addrs[ NET_MAX_BATCH ];
+	int                lengths[ NET_MAX_BATCH ];
+	int                head, count;
+} netqueue_t;
+
+typedef struct
+{
+	uint64_t packets;
+	uint64_t syscalls;
+	uint64_t empty;// syscalls that came back with nothing
+} netcounter_t;
+
+static netqueue_t recvqueues[ 2 ];
+static netqueue_t sendqueues[ 2 ];
+
+static netcounter_t net_recvstats;
+static netcounter_t net_sendstats;
+
+static cvar_t *net_batch;
+#if defined( NET_HAVE_MMSG )
+static bool net_mmsgsupported = true;// cleared if the kernel turns out not to have them
+#endif
+
+static int NET_GetBatchSize()
+{
+#if defined( NET_HAVE_MMSG )
+	if ( net_mmsgsupported && net_batch != nullptr && net_batch->value >= 2.0f )
+		return std::min( ( int ) net_batch->value, NET_MAX_BATCH );
+#endif
+
+	return 0;
+}
+
+static bool NET_ReceiveBatch( netsrc_t sock, int net_socket )
+{
+#if defined( NET_HAVE_MMSG )
+	netqueue_t *queue = &recvqueues[ sock ];
+	int         batch = NET_GetBatchSize();
+
+	struct mmsghdr msgs[ NET_MAX_BATCH ];
+	struct iovec   iovs[ NET_MAX_BATCH ];
+	memset( msgs, 0, sizeof( msgs[ 0 ] ) * batch );
+	for ( int i = 0; i < batch; ++i )
+	{
+		iovs[ i ].iov_base            = queue->data[ i ];
+		iovs[ i ].iov_len             = MAX_MSGLEN;
+		msgs[ i ].msg_hdr.msg_iov     = &iovs[ i ];
+		msgs[ i ].msg_hdr.msg_iovlen  = 1;
+		msgs[ i ].msg_hdr.msg_name    = &queue->addrs[ i ];
+		msgs[ i ].msg_hdr.msg_namelen = sizeof( queue->addrs[ i ] );
+	}
+
+	queue->head  = 0;
+	queue->count = 0;
+
+	int ret = recvmmsg( net_socket, msgs, batch, MSG_DONTWAIT, nullptr );
+	net_recvstats.syscalls++;
+	if ( ret <= 0 )
+	{
+		net_recvstats.empty++;
+		if ( ret == -1 )
+		{
+			int err = errno;
+			if ( err == ENOSYS )
+			{
+				Com_Printf( "NET_GetPacket: recvmmsg isn't available, sending and receiving a packet at a time\n" );
+				net_mmsgsupported = false;
+			}
+			else if ( err != EWOULDBLOCK && err != ECONNREFUSED )
+				Com_Printf( "NET_GetPacket: %s\n", NET_ErrorString() );
+		}
+		return false;
+	}
+
+	for ( int i = 0; i < ret; ++i )
+		queue->lengths[ i ] = ( msgs[ i ].msg_hdr.msg_flags & MSG_TRUNC ) ? MAX_MSGLEN : ( int ) msgs[ i ].msg_len;
+
+	queue->count = ret;
+	net_recvstats.packets += ret;
+	return true;
+#else
+	return false;
+#endif
+}
+
+static void NET_SendTo( int net_socket, const void *data, int length, const struct sockaddr_in *addr )
+{
+	ssize_t ret = sendto( net_socket, data, length, 0, ( const struct sockaddr * ) addr, sizeof( *addr ) );
+	net_sendstats.syscalls++;
+	if ( ret == -1 )
+	{
+		netadr_t to;
+		SockadrToNetadr( ( struct sockaddr_in * ) addr, &to );
+		Com_Printf( "NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(), NET_AdrToString( to ) );
+		return;
+	}
+
+	net_sendstats.packets++;
+}
+
+/*
+====================
+NET_FlushPackets
+
+Sends everything queued up on the given socket since the last flush
+====================
+*/
+void NET_FlushPackets( netsrc_t sock )
+{
+	netqueue_t *queue = &sendqueues[ sock ];
+	if ( queue->count == 0 )
+		return;
+
+	PROFILE_ZONE( "NET_FlushPackets" );
+
+	// anything printed below might be redirected back out over the network, so the queue has to be free again first
+	int count    = queue->count;
+	queue->count = 0;
+
+	int net_socket = ip_sockets[ sock ];
+	if ( !net_socket )
+		return;
+
+	int sent = 0;
+#if defined( NET_HAVE_MMSG )
+	struct mmsghdr msgs[ NET_MAX_BATCH ];
+	struct iovec   iovs[ NET_MAX_BATCH ];
+	memset( msgs, 0, sizeof( msgs[ 0 ] ) * count );
+	for ( int i = 0; i < count; ++i )
+	{
+		iovs[ i ].iov_base            = queue->data[ i ];
+		iovs[ i ].iov_len             = queue->lengths[ i ];
+		msgs[ i ].msg_hdr.msg_iov     = &iovs[ i ];
+		msgs[ i ].msg_hdr.msg_iovlen  = 1;
+		msgs[ i ].msg_hdr.msg_name    = &queue->addrs[ i ];
+		msgs[ i ].msg_hdr.msg_namelen = sizeof( queue->addrs[ i ] );
+	}
+
+	int failed = 0, lasterr = 0;
+	while ( sent < count && net_mmsgsupported )
+	{
+		int ret = sendmmsg( net_socket, msgs + sent, count - sent, 0 );
+		net_sendstats.syscalls++;
+		if ( ret == -1 )
+		{
+			lasterr = errno;
+			if ( lasterr == ENOSYS )
+			{
+				net_mmsgsupported = false;
+				break;
+			}
+
+			// skip over the one that failed, as sendto would have
+			failed++;
+			sent++;
+			continue;
+		}
+
+		net_sendstats.packets += ret;
+		sent += ret;
+	}
+
+	if ( failed > 0 )
+		Com_Printf( "NET_FlushPackets: %s, %i packet(s) dropped\n", strerror( lasterr ), failed );
+	if ( !net_mmsgsupported && lasterr == ENOSYS )
+		Com_Printf( "NET_FlushPackets: sendmmsg isn't available, sending and receiving a packet at a time\n" );
+#endif
+
+	// whatever couldn't go out together goes out one at a time
+	for ( ; sent < count; ++sent )
+		NET_SendTo( net_socket, queue->data[ sent ], queue->lengths[ sent ], &queue->addrs[ sent ] );
+}
+
+static void NET_QueuePacket( netsrc_t sock, int length, const void *data, const struct sockaddr_in *addr )
+{
+	netqueue_t *queue = &sendqueues[ sock ];
+	if ( queue->count >= NET_GetBatchSize() )
+		NET_FlushPackets( sock );
+
+	int i = queue->count++;
+	memcpy( queue->data[ i ], data, length );
+	queue->lengths[ i ] = length;
+	queue->addrs[ i ]   = *addr;
+}
+
+static void NET_Stats_f()
+{
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "clear" ) )
+	{
+		net_recvstats = {};
+		net_sendstats = {};
+		return;
+	}
+
+	Com_Printf( "batching: %s\n", NET_GetBatchSize() > 0 ? va( "up to %i packets", NET_GetBatchSize() ) : "off" );
+	Com_Printf( "received %llu packets in %llu syscalls, %llu of which were empty (%.2f per syscall)\n",
+	            ( unsigned long long ) net_recvstats.packets, ( unsigned long long ) net_recvstats.syscalls, ( unsigned long long ) net_recvstats.empty,
+	            net_recvstats.syscalls ? ( double ) net_recvstats.packets / net_recvstats.syscalls : 0.0 );
+	Com_Printf( "sent %llu packets in %llu syscalls (%.2f per syscall)\n",
+	            ( unsigned long long ) net_sendstats.packets, ( unsigned long long ) net_sendstats.syscalls,
+	            net_sendstats.syscalls ? ( double ) net_sendstats.packets / net_sendstats.syscalls : 0.0 );
+}
+
+//=============================================================================
+
 bool NET_GetPacket( netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message )
 {
 	struct sockaddr_in from;
@@ -287,13 +516,38 @@ bool NET_GetPacket( netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message )
 		if ( !net_socket )
 			continue;
 
+		// anything left over in the ring is handed out first, even if batching was just switched off
+		netqueue_t *queue = &recvqueues[ sock ];
+		if ( protocol == 0 && ( queue->head < queue->count || NET_GetBatchSize() > 0 ) )
+		{
+			while ( queue->head < queue->count || NET_ReceiveBatch( sock, net_socket ) )
+			{
+				int i = queue->head++;
+				SockadrToNetadr( &queue->addrs[ i ], net_from );
+
+				if ( ( size_t ) queue->lengths[ i ] >= std::min< size_t >( net_message->maxsize, MAX_MSGLEN ) )
+				{
+					Com_Printf( "Oversize packet from %s\n", NET_AdrToString( *net_from ) );
+					continue;
+				}
+
+				memcpy( net_message->data, queue->data[ i ], queue->lengths[ i ] );
+				net_message->cursize = queue->lengths[ i ];
+				return true;
+			}
+			continue;
+		}
+
 		socklen_t fromlen = sizeof( from );
 		ssize_t   ret     = recvfrom( net_socket, net_message->data, net_message->maxsize, 0, ( struct sockaddr       *) &from, &fromlen );
+		net_recvstats.syscalls++;
 
 		SockadrToNetadr( &from, net_from );
 
 		if ( ret == -1 )
 		{
+			net_recvstats.empty++;
+
 			err = errno;
 
 			if ( err == EWOULDBLOCK || err == ECONNREFUSED )
@@ -303,6 +557,8 @@ bool NET_GetPacket( netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message )
 			continue;
 		}
 
+		net_recvstats.packets++;
+
 		if ( ret == ( ssize_t ) net_message->maxsize )
 		{
 			Com_Printf( "Oversize packet from %s\n", NET_AdrToString( *net_from ) );
@@ -320,7 +576,6 @@ bool NET_GetPacket( netsrc_t sock, netadr_t *net_from, sizebuf_t *net_message )
 
 void NET_SendPacket( netsrc_t sock, int length, void *data, netadr_t to )
 {
-	int                ret;
 	struct sockaddr_in addr;
 	int                net_socket;
 
@@ -359,12 +614,13 @@ void NET_SendPacket( netsrc_t sock, int length, void *data, netadr_t to )
 
 	NetadrToSockadr( &to, &addr );
 
-	ret = sendto( net_socket, data, length, 0, ( struct sockaddr * ) &addr, sizeof( addr ) );
-	if ( ret == -1 )
+	if ( net_socket == ip_sockets[ sock ] && length <= MAX_MSGLEN && NET_GetBatchSize() > 0 )
 	{
-		Com_Printf( "NET_SendPacket ERROR: %s to %s\n", NET_ErrorString(),
-		            NET_AdrToString( to ) );
+		NET_QueuePacket( sock, length, data, &addr );
+		return;
 	}
+
+	NET_SendTo( net_socket, data, length, &addr );
 }
 
 
@@ -414,6 +670,10 @@ void NET_Config( bool multiplayer )
 	{// shut down any existing sockets
 		for ( i = 0; i < 2; i++ )
 		{
+			// let anything still queued, like the final message to clients, go out first
+			NET_FlushPackets( ( netsrc_t ) i );
+			recvqueues[ i ].head = recvqueues[ i ].count = 0;
+
 			if ( ip_sockets[ i ] )
 			{
 				close( ip_sockets[ i ] );
@@ -444,6 +704,9 @@ NET_Init
 */
 void NET_Init( void )
 {
+	net_batch = Cvar_Get( "net_batch", "32", 0 );
+
+	Cmd_AddCommand( "net_stats", NET_Stats_f );
 }
 
 
@@ -526,14 +789,14 @@ char *NET_ErrorString( void )
 	return strerror( code );
 }
 
-// sleeps msec or until net socket is ready
-void NET_Sleep( int msec )
+// sleeps msec or until net socket is ready, returns false if there was nothing to wait on
+bool NET_Sleep( int msec )
 {
 	struct timeval timeout;
 	fd_set         fdset;
 
 	if ( !ip_sockets[ NS_SERVER ] || ( dedicated && ( dedicated->value <= 0.0f ) ) )
-		return;// we're not a server, just run full speed
+		return false;// we're not a server, just run full speed
 
 	FD_ZERO( &fdset );
 
@@ -541,4 +804,5 @@ void NET_Sleep( int msec )
 	timeout.tv_sec  = msec / 1000;
 	timeout.tv_usec = ( msec % 1000 ) * 1000;
 	select( ip_sockets[ NS_SERVER ] + 1, &fdset, nullptr, nullptr, &timeout );
+	return true;
 }
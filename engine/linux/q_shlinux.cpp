@@ -22,6 +22,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include <sys/mman.h>
 #include <cstdio>
 #include <dirent.h>
+#include <poll.h>
+#include <unistd.h>
 
 #include "../linux/glob.h"
 
@@ -145,3 +147,62 @@ void Sys_FindClose( void )
 
 
 //============================================
+
+/*
+================
+Sys_ConsoleInput
+
+Returns the next line typed into the terminal, if there is one
+================
+*/
+char *Sys_ConsoleInput()
+{
+	static char   buffer[ 1024 ];
+	static size_t length, consumed;
+	static bool   active = true;
+
+	if ( !dedicated || dedicated->value <= 0.0f )
+		return nullptr;
+
+	while ( true )
+	{
+		// hand back whatever's already been read a line at a time
+		char *end = ( char * ) memchr( buffer + consumed, '\n', length - consumed );
+		if ( end != nullptr )
+		{
+			char *line = buffer + consumed;
+			consumed   = end + 1 - buffer;
+
+			*end = '\0';
+			if ( end > line && end[ -1 ] == '\r' )
+				end[ -1 ] = '\0';
+
+			return line;
+		}
+
+		memmove( buffer, buffer + consumed, length - consumed );
+		length -= consumed;
+		consumed = 0;
+		if ( length == sizeof( buffer ) )
+			length = 0;// nobody's typing that much into one line, so drop it
+
+		if ( !active )
+			return nullptr;
+
+		pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+		if ( poll( &fd, 1, 0 ) <= 0 )
+			return nullptr;
+
+		ssize_t numRead = read( STDIN_FILENO, buffer + length, sizeof( buffer ) - length );
+		if ( numRead <= 0 )
+		{
+			// stdin's gone (e.g. started in the background), so stop checking
+			if ( numRead == 0 )
+				active = false;
+
+			return nullptr;
+		}
+
+		length += numRead;
+	}
+}
@@ -268,3 +268,4 @@ void Mod_BeginRegistration( const char *model );
 void Mod_EndRegistration( void );
 
 struct model_s *Mod_RegisterModel( const char *name );
+void            Mod_Prefetch( const char *name );
@@ -441,23 +441,19 @@ static void LoadPCX( const char *filename, byte **pic, byte **palette, int *widt
 	//
 	pcx = ( pcx_t * ) raw;
 
-	pcx->xmin           = LittleShort( pcx->xmin );
-	pcx->ymin           = LittleShort( pcx->ymin );
-	pcx->xmax           = LittleShort( pcx->xmax );
-	pcx->ymax           = LittleShort( pcx->ymax );
-	pcx->hres           = LittleShort( pcx->hres );
-	pcx->vres           = LittleShort( pcx->vres );
-	pcx->bytes_per_line = LittleShort( pcx->bytes_per_line );
-	pcx->palette_type   = LittleShort( pcx->palette_type );
+	// the buffer may be shared, so the header's swapped into locals rather than in place
+	int xmax = LittleShort( pcx->xmax );
+	int ymax = LittleShort( pcx->ymax );
 
 	raw = &pcx->data;
 
-	if ( pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1 || pcx->bits_per_pixel != 8 || pcx->xmax >= 640 || pcx->ymax >= 480 )
+	if ( pcx->manufacturer != 0x0a || pcx->version != 5 || pcx->encoding != 1 || pcx->bits_per_pixel != 8 || xmax >= 640 || ymax >= 480 )
 	{
+		FS_FreeFile( pcx );
 		return;
 	}
 
-	out = new byte[ ( pcx->ymax + 1 ) * ( pcx->xmax + 1 ) ];
+	out = new byte[ ( ymax + 1 ) * ( xmax + 1 ) ];
 
 	*pic = out;
 	pix  = out;
@@ -469,13 +465,13 @@ static void LoadPCX( const char *filename, byte **pic, byte **palette, int *widt
 	}
 
 	if ( width )
-		*width = pcx->xmax + 1;
+		*width = xmax + 1;
 	if ( height )
-		*height = pcx->ymax + 1;
+		*height = ymax + 1;
 
-	for ( y = 0; y <= pcx->ymax; y++, pix += pcx->xmax + 1 )
+	for ( y = 0; y <= ymax; y++, pix += xmax + 1 )
 	{
-		for ( x = 0; x <= pcx->xmax; )
+		for ( x = 0; x <= xmax; )
 		{
 			dataByte = *raw++;
 
@@ -839,25 +835,26 @@ image_t *GL_LoadPic( const std::string &name, byte *pic, int width, int height,
 	return image;
 }
 
+struct ImageLoader
+{
+	int depth;
+	void ( *Load8bpp )( const char *filename, byte **pic, byte **palette, int *width, int *height );
+	void ( *Load32bpp )( const char *filename, byte **pic, int *width, int *height );
+};
+
+static const std::map< const std::string, const ImageLoader > imageLoaders = {
+        { "tga", { 32, nullptr, LoadImage32 } },
+        { "png", { 32, nullptr, LoadImage32 } },
+        { "bmp", { 32, nullptr, LoadImage32 } },
+        { "pcx", { 8, LoadPCX, nullptr } },
+};
+
 /*
-** Attempt to load an image in without an extension.
-** Returns actual path after successful load, otherwise returns an empty string.
+** Returns each path Image_Load tries for the given name, in the order it tries them.
 */
-static std::string Image_Load( const std::string &name, byte **pic, byte **palette, int *width, int *height, int *depth )
+static std::vector< std::pair< std::string, const ImageLoader * > > Image_GetLoadPaths( const std::string &name )
 {
-	struct ImageLoader
-	{
-		int depth;
-		void ( *Load8bpp )( const char *filename, byte **pic, byte **palette, int *width, int *height );
-		void ( *Load32bpp )( const char *filename, byte **pic, int *width, int *height );
-	};
-
-	static const std::map< const std::string, const ImageLoader > imageLoaders = {
-	        { "tga", { 32, nullptr, LoadImage32 } },
-	        { "png", { 32, nullptr, LoadImage32 } },
-	        { "bmp", { 32, nullptr, LoadImage32 } },
-	        { "pcx", { 8, LoadPCX, nullptr } },
-	};
+	std::vector< std::pair< std::string, const ImageLoader * > > paths;
 
 	std::string loadName;
 
@@ -870,22 +867,7 @@ static std::string Image_Load( const std::string &name, byte **pic, byte **palet
 		auto loader = imageLoaders.find( extension );
 		if ( loader != imageLoaders.end() )
 		{
-			*pic     = nullptr;
-			*palette = nullptr;
-			if ( loader->second.depth == 8 )
-			{
-				loader->second.Load8bpp( name.c_str(), pic, palette, width, height );
-			}
-			else
-			{
-				loader->second.Load32bpp( name.c_str(), pic, width, height );
-			}
-
-			if ( *pic != nullptr )
-			{
-				*depth = loader->second.depth;
-				return name;
-			}
+			paths.emplace_back( name, &loader->second );
 		}
 
 		loadName = name.substr( 0, l );
@@ -899,17 +881,31 @@ static std::string Image_Load( const std::string &name, byte **pic, byte **palet
 			continue;
 		}
 
-		std::string nName = loadName + "." + loader.first;
+		paths.emplace_back( loadName + "." + loader.first, &loader.second );
+	}
+
+	return paths;
+}
+
+/*
+** Attempt to load an image in without an extension.
+** Returns actual path after successful load, otherwise returns an empty string.
+*/
+static std::string Image_Load( const std::string &name, byte **pic, byte **palette, int *width, int *height, int *depth )
+{
+	for ( const auto &i : Image_GetLoadPaths( name ) )
+	{
+		const ImageLoader *loader = i.second;
 
 		*pic     = nullptr;
 		*palette = nullptr;
-		if ( loader.second.depth == 8 )
+		if ( loader->depth == 8 )
 		{
-			loader.second.Load8bpp( nName.c_str(), pic, palette, width, height );
+			loader->Load8bpp( i.first.c_str(), pic, palette, width, height );
 		}
 		else
 		{
-			loader.second.Load32bpp( nName.c_str(), pic, width, height );
+			loader->Load32bpp( i.first.c_str(), pic, width, height );
 		}
 
 		if ( *pic == nullptr )
@@ -917,8 +913,8 @@ static std::string Image_Load( const std::string &name, byte **pic, byte **palet
 			continue;
 		}
 
-		*depth = loader.second.depth;
-		return nName;
+		*depth = loader->depth;
+		return i.first;
 	}
 
 	return "";
@@ -1003,6 +999,31 @@ image_t *GL_FindImage( const std::string &name, imagetype_t type )
 	return image;
 }
 
+/*
+** Get the given image read in the background, if it's not already loaded
+*/
+void GL_PrefetchImage( const std::string &name )
+{
+	int      i;
+	image_t *image;
+	for ( i = 0, image = gltextures; i < numgltextures; i++, image++ )
+	{
+		if ( name == image->name )
+		{
+			return;
+		}
+	}
+
+	// whichever Image_Load is going to find first
+	for ( const auto &i : Image_GetLoadPaths( name ) )
+	{
+		if ( FS_Prefetch( i.first.c_str() ) )
+		{
+			return;
+		}
+	}
+}
+
 struct image_s *R_RegisterSkin( const char *name )
 {
 	return GL_FindImage( name, it_skin );
@@ -1160,8 +1181,8 @@ static void Image_LoadTextureInfo()
 	char *script;
 	// Allocate and load it into a buffer to ensure null-termination
 	{
-		char *buf;
-		int   length = FS_LoadFile( "textures/textureinfo.dat", ( void   **) &buf );
+		const void *buf;
+		ssize_t     length = FS_MapFile( "textures/textureinfo.dat", &buf );
 		if ( length == -1 )
 		{
 			Com_Error( ERR_FATAL, "Invalid or missing textureinfo.dat file!\n" );
@@ -1172,7 +1193,7 @@ static void Image_LoadTextureInfo()
 		memcpy( script, buf, length );
 		script[ length ] = '\0';
 
-		FS_FreeFile( buf );
+		FS_UnmapFile( buf );
 	}
 
 	int surfaceFlag = 0;
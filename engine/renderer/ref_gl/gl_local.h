@@ -199,6 +199,7 @@ struct image_s *R_RegisterSkin( const char *name );
 image_t *GL_LoadPic( const std::string &name, byte *pic, int width, int height,
                      imagetype_t type, int bits );
 image_t *GL_FindImage( const std::string &name, imagetype_t type );
+void     GL_PrefetchImage( const std::string &name );
 void     GL_TextureMode( char *string );
 void     GL_ImageList_f( void );
 int      Image_GetSurfaceFlagsForName( const std::string &path );
@@ -28,10 +28,10 @@
 model_t *loadmodel;
 int      modfilelen;
 
-void Mod_LoadSpriteModel( model_t *mod, void *buffer );
-void Mod_LoadBrushModel( model_t *mod, void *buffer );
-void Mod_LoadMDAModel( model_t *mod, void *buffer, const std::string &tag );
-void Mod_LoadAliasModel( model_t *mod, void *buffer );
+void Mod_LoadSpriteModel( model_t *mod, const void *buffer );
+void Mod_LoadBrushModel( model_t *mod, const void *buffer );
+void Mod_LoadMDAModel( model_t *mod, const void *buffer, const std::string &tag );
+void Mod_LoadAliasModel( model_t *mod, const void *buffer );
 
 static byte mod_novis[ MAX_MAP_LEAFS / 8 ];
 
@@ -165,9 +165,9 @@ Loads in a model for the given name
 */
 model_t *Mod_ForName( const char *name, bool crash )
 {
-	model_t  *mod;
-	unsigned *buf;
-	int       i;
+	model_t    *mod;
+	const void *buf;
+	int         i;
 
 	if ( !name[ 0 ] ) Com_Error( ERR_DROP, "Mod_ForName: NULL name" );
 
@@ -231,7 +231,7 @@ model_t *Mod_ForName( const char *name, bool crash )
 	//
 	// load the file
 	//
-	modfilelen = FS_LoadFile( mod->name, ( void ** ) &buf );
+	modfilelen = FS_MapFile( mod->name, &buf );
 	if ( !buf )
 	{
 		if ( crash )
@@ -248,7 +248,7 @@ model_t *Mod_ForName( const char *name, bool crash )
 
 	// call the apropriate loader
 
-	switch ( LittleLong( *( unsigned * ) buf ) )
+	switch ( LittleLong( *( const unsigned * ) buf ) )
 	{
 		case IDMDAHEADER:
 			Mod_LoadMDAModel( mod, buf, tag );
@@ -275,7 +275,7 @@ model_t *Mod_ForName( const char *name, bool crash )
 			break;
 	}
 
-	FS_FreeFile( buf );
+	FS_UnmapFile( buf );
 
 	return mod;
 }
@@ -288,7 +288,7 @@ model_t *Mod_ForName( const char *name, bool crash )
 ===============================================================================
 */
 
-byte *mod_base;
+const byte *mod_base;
 
 /*
 =================
@@ -338,11 +338,11 @@ Mod_LoadVertexes
 */
 void Mod_LoadVertexes( lump_t *l )
 {
-	dvertex_t *in;
+	const dvertex_t *in;
 	mvertex_t *out;
 	int        i, count;
 
-	in = ( dvertex_t * ) ( mod_base + l->fileofs );
+	in = ( const dvertex_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -385,11 +385,11 @@ Mod_LoadSubmodels
 */
 void Mod_LoadSubmodels( lump_t *l )
 {
-	dmodel_t *in;
+	const dmodel_t *in;
 	mmodel_t *out;
 	int       i, j, count;
 
-	in = ( dmodel_t * ) ( mod_base + l->fileofs );
+	in = ( const dmodel_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -421,11 +421,11 @@ Mod_LoadEdges
 */
 void Mod_LoadEdges( lump_t *l )
 {
-	dedge_t *in;
+	const dedge_t *in;
 	medge_t *out;
 	int      i, count;
 
-	in = ( dedge_t * ) ( mod_base + l->fileofs );
+	in = ( const dedge_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -449,13 +449,13 @@ Mod_LoadTexinfo
 */
 void Mod_LoadTexinfo( lump_t *l )
 {
-	texinfo_t  *in;
+	const texinfo_t  *in;
 	mtexinfo_t *out, *step;
 	int         i, j, count;
 	char        name[ MAX_QPATH ];
 	int         next;
 
-	in = ( texinfo_t * ) ( mod_base + l->fileofs );
+	in = ( const texinfo_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -465,6 +465,13 @@ void Mod_LoadTexinfo( lump_t *l )
 	loadmodel->texinfo    = out;
 	loadmodel->numtexinfo = count;
 
+	// get the textures reading in the background while we work through them
+	for ( i = 0; i < count; i++ )
+	{
+		Com_sprintf( name, sizeof( name ), "textures/%s.tga", in[ i ].texture );
+		GL_PrefetchImage( name );
+	}
+
 	for ( i = 0; i < count; i++, in++, out++ )
 	{
 		for ( j = 0; j < 8; j++ ) out->vecs[ 0 ][ j ] = LittleFloat( in->vecs[ 0 ][ j ] );
@@ -560,13 +567,13 @@ Mod_LoadFaces
 */
 void Mod_LoadFaces( lump_t *l )
 {
-	dface_t    *in;
+	const dface_t    *in;
 	msurface_t *out;
 	int         i, count, surfnum;
 	int         planenum, side;
 	int         ti;
 
-	in = ( dface_t * ) ( mod_base + l->fileofs );
+	in = ( const dface_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -654,10 +661,10 @@ Mod_LoadNodes
 void Mod_LoadNodes( lump_t *l )
 {
 	int      i, j, count, p;
-	dnode_t *in;
+	const dnode_t *in;
 	mnode_t *out;
 
-	in = ( dnode_t * ) ( mod_base + l->fileofs );
+	in = ( const dnode_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -702,12 +709,12 @@ Mod_LoadLeafs
 */
 void Mod_LoadLeafs( lump_t *l )
 {
-	dleaf_t *in;
+	const dleaf_t *in;
 	mleaf_t *out;
 	int      i, j, count, p;
 	//	glpoly_t	*poly;
 
-	in = ( dleaf_t * ) ( mod_base + l->fileofs );
+	in = ( const dleaf_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -756,10 +763,10 @@ Mod_LoadMarksurfaces
 void Mod_LoadMarksurfaces( lump_t *l )
 {
 	int          i, j, count;
-	short       *in;
+	const short       *in;
 	msurface_t **out;
 
-	in = ( short * ) ( mod_base + l->fileofs );
+	in = ( const short * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -785,10 +792,11 @@ Mod_LoadSurfedges
 */
 void Mod_LoadSurfedges( lump_t *l )
 {
-	int  i, count;
-	int *in, *out;
+	int        i, count;
+	const int *in;
+	int       *out;
 
-	in = ( int * ) ( mod_base + l->fileofs );
+	in = ( const int * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -814,11 +822,11 @@ void Mod_LoadPlanes( lump_t *l )
 {
 	int       i, j;
 	cplane_t *out;
-	dplane_t *in;
+	const dplane_t *in;
 	int       count;
 	int       bits;
 
-	in = ( dplane_t * ) ( mod_base + l->fileofs );
+	in = ( const dplane_t * ) ( mod_base + l->fileofs );
 	if ( l->filelen % sizeof( *in ) )
 		Com_Error( ERR_DROP, "MOD_LoadBmodel: funny lump size in %s",
 		           loadmodel->name );
@@ -848,18 +856,19 @@ void Mod_LoadPlanes( lump_t *l )
 Mod_LoadBrushModel
 =================
 */
-void Mod_LoadBrushModel( model_t *mod, void *buffer )
+void Mod_LoadBrushModel( model_t *mod, const void *buffer )
 {
-	dheader_t *header;
-	mmodel_t  *bm;
+	dheader_t header;
+	mmodel_t *bm;
 
 	loadmodel->type = mod_brush;
 	if ( loadmodel != mod_known )
 		Com_Error( ERR_DROP, "Loaded a brush model after the world" );
 
-	header = ( dheader_t * ) buffer;
+	// the buffer is read-only, so swap a copy of the header
+	header = *( const dheader_t * ) buffer;
 
-	unsigned int version = LittleLong( header->version );
+	unsigned int version = LittleLong( header.version );
 	if ( version != BSPVERSION )
 		Com_Error(
 		        ERR_DROP,
@@ -870,25 +879,25 @@ void Mod_LoadBrushModel( model_t *mod, void *buffer )
 		        BSPVERSION );
 
 	// swap all the lumps
-	mod_base = ( byte * ) header;
+	mod_base = ( const byte * ) buffer;
 
 	for ( unsigned int i = 0; i < sizeof( dheader_t ) / 4; i++ )
-		( ( int * ) header )[ i ] = LittleLong( ( ( int * ) header )[ i ] );
+		( ( int * ) &header )[ i ] = LittleLong( ( ( int * ) &header )[ i ] );
 
 	// load into heap
 
-	Mod_LoadVertexes( &header->lumps[ LUMP_VERTEXES ] );
-	Mod_LoadEdges( &header->lumps[ LUMP_EDGES ] );
-	Mod_LoadSurfedges( &header->lumps[ LUMP_SURFEDGES ] );
-	Mod_LoadLighting( &header->lumps[ LUMP_LIGHTING ] );
-	Mod_LoadPlanes( &header->lumps[ LUMP_PLANES ] );
-	Mod_LoadTexinfo( &header->lumps[ LUMP_TEXINFO ] );
-	Mod_LoadFaces( &header->lumps[ LUMP_FACES ] );
-	Mod_LoadMarksurfaces( &header->lumps[ LUMP_LEAFFACES ] );
-	Mod_LoadVisibility( &header->lumps[ LUMP_VISIBILITY ] );
-	Mod_LoadLeafs( &header->lumps[ LUMP_LEAFS ] );
-	Mod_LoadNodes( &header->lumps[ LUMP_NODES ] );
-	Mod_LoadSubmodels( &header->lumps[ LUMP_MODELS ] );
+	Mod_LoadVertexes( &header.lumps[ LUMP_VERTEXES ] );
+	Mod_LoadEdges( &header.lumps[ LUMP_EDGES ] );
+	Mod_LoadSurfedges( &header.lumps[ LUMP_SURFEDGES ] );
+	Mod_LoadLighting( &header.lumps[ LUMP_LIGHTING ] );
+	Mod_LoadPlanes( &header.lumps[ LUMP_PLANES ] );
+	Mod_LoadTexinfo( &header.lumps[ LUMP_TEXINFO ] );
+	Mod_LoadFaces( &header.lumps[ LUMP_FACES ] );
+	Mod_LoadMarksurfaces( &header.lumps[ LUMP_LEAFFACES ] );
+	Mod_LoadVisibility( &header.lumps[ LUMP_VISIBILITY ] );
+	Mod_LoadLeafs( &header.lumps[ LUMP_LEAFS ] );
+	Mod_LoadNodes( &header.lumps[ LUMP_NODES ] );
+	Mod_LoadSubmodels( &header.lumps[ LUMP_MODELS ] );
 	mod->numframes = 2;// regular and alternate animation
 
 	//
@@ -932,10 +941,10 @@ ALIAS MODELS
  * should be rendered in the scene along with some
  * additional data we need.
  */
-void Mod_LoadMDAModel( model_t *mod, void *buffer, const std::string &tag )
+void Mod_LoadMDAModel( model_t *mod, const void *buffer, const std::string &tag )
 {
 	chr::MDAModel *mda = new chr::MDAModel();
-	if ( mda->Parse( ( char * ) buffer ) )
+	if ( mda->Parse( std::string( ( const char * ) buffer, modfilelen ) ) )
 	{
 		mod->type = mod_mda;
 
@@ -949,7 +958,7 @@ void Mod_LoadMDAModel( model_t *mod, void *buffer, const std::string &tag )
 	}
 }
 
-void Mod_LoadAliasModel( model_t *mod, void *buffer )
+void Mod_LoadAliasModel( model_t *mod, const void *buffer )
 {
 	auto *aliasModel = new chr::AliasModel();
 	if ( aliasModel->LoadFromBuffer( buffer ) )
@@ -968,15 +977,19 @@ void Mod_LoadAliasModel( model_t *mod, void *buffer )
 
 		mod->numframes = aliasModel->GetNumFrames();
 
-		// Load in all the skins we need
+		// Load in all the skins we need, getting them all reading in the background first
 		const auto &skins = aliasModel->GetSkins();
+		std::vector< std::string > skinPaths( skins.size() );
 		for ( size_t i = 0; i < skins.size(); ++i )
 		{
 			char skinPath[ MAX_QPATH ];
 			snprintf( skinPath, sizeof( skinPath ), "%s", mod->name );
 			strcpy( strrchr( skinPath, '/' ) + 1, skins[ i ].c_str() );
-			mod->skins[ i ] = GL_FindImage( skinPath, it_skin );
+			skinPaths[ i ] = skinPath;
+			GL_PrefetchImage( skinPaths[ i ] );
 		}
+		for ( size_t i = 0; i < skins.size(); ++i )
+			mod->skins[ i ] = GL_FindImage( skinPaths[ i ], it_skin );
 	}
 	else
 	{
@@ -998,12 +1011,13 @@ SPRITE MODELS
 Mod_LoadSpriteModel
 =================
 */
-void Mod_LoadSpriteModel( model_t *mod, void *buffer )
+void Mod_LoadSpriteModel( model_t *mod, const void *buffer )
 {
-	dsprite_t *sprin, *sprout;
-	int        i;
+	const dsprite_t *sprin;
+	dsprite_t       *sprout;
+	int              i;
 
-	sprin  = ( dsprite_t * ) buffer;
+	sprin  = ( const dsprite_t * ) buffer;
 	sprout = static_cast< dsprite_t * >( Hunk_Alloc( modfilelen ) );
 
 	sprout->ident     = LittleLong( sprin->ident );
@@ -1084,6 +1098,39 @@ model_s *Mod_RegisterModel( const char *name )
 	return mod;
 }
 
+/**
+ * Get the given model reading in the background ahead of it being
+ * registered, if it's not already loaded.
+ */
+void Mod_Prefetch( const char *name )
+{
+	// inline models come from the world
+	if ( name[ 0 ] == '*' )
+	{
+		return;
+	}
+
+	std::string filename = name;
+
+	const size_t pos = filename.find_last_of( '!' );
+	if ( pos != std::string::npos )
+	{
+		filename.erase( pos );
+	}
+
+	int      i;
+	model_t *mod;
+	for ( i = 0, mod = mod_known; i < mod_numknown; i++, mod++ )
+	{
+		if ( filename == mod->name )
+		{
+			return;
+		}
+	}
+
+	FS_Prefetch( filename.c_str() );
+}
+
 /*
 @@@@@@@@@@@@@@@@@@@@@
 R_EndRegistration
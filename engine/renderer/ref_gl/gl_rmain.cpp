@@ -872,6 +872,8 @@ R_RenderFrame
 */
 void R_RenderFrame( refdef_t *fd )
 {
+	PROFILE_ZONE( "R_RenderFrame" );
+
 	R_RenderView( fd );
 	R_SetLightLevel();
 	R_SetGL2D();
@@ -156,6 +156,20 @@ typedef struct
 } challenge_t;
 
 
+typedef struct
+{
+	uint64_t packets;       // everything read off the server socket
+	uint64_t connectionless;// of which weren't for a client
+	uint64_t lookups;       // times a client was looked up by address
+	uint64_t lookupMisses;  // of which didn't turn anyone up
+
+	uint64_t parallelFrames;  // server frames where the client frames were built in parallel
+	uint64_t serialFrames;    // ...and where that wasn't safe, so they were built one at a time
+	uint64_t mismatchedFrames;// client frames that came out differently, with sv_parallelframes 2
+	uint64_t clientViews;     // client frames built in parallel...
+	uint64_t viewGroups;      // ...and how many distinct views they were culled from
+} server_stats_t;
+
 typedef struct
 {
 	bool initialized;// sv_init has completed
@@ -179,6 +193,8 @@ typedef struct
 	FILE     *demofile;
 	sizebuf_t demo_multicast;
 	byte      demo_multicast_buf[ MAX_MSGLEN ];
+
+	server_stats_t stats;// for sv_stats
 } server_static_t;
 
 //=============================================================================
@@ -197,6 +213,7 @@ extern cvar_t *sv_noreload;     // don't reload level state when reentering
 extern cvar_t *sv_airaccelerate;// don't reload level state when reentering
                                 // development tool
 extern cvar_t *sv_enforcetime;
+extern cvar_t *sv_parallelframes;
 
 extern client_t *sv_client;
 extern edict_t  *sv_player;
@@ -209,6 +226,10 @@ extern edict_t  *sv_player;
 void SV_FinalMessage( const char *message, bool reconnect );
 void SV_DropClient( client_t *drop );
 
+void      SV_LinkClientAddress( client_t *cl );
+void      SV_UnlinkClientAddress( client_t *cl );
+client_t *SV_FindClient( netadr_t adr, int qport );
+
 int SV_ModelIndex( const char *name );
 int SV_SoundIndex( const char *name );
 int SV_ImageIndex( const char *name );
@@ -281,6 +302,8 @@ void SV_Status_f( void );
 void SV_WriteFrameToClient( client_t *client, sizebuf_t *msg );
 void SV_RecordDemoMessage( void );
 void SV_BuildClientFrame( client_t *client );
+bool SV_BuildClientMessages( client_t **clients, int numClients, sizebuf_t **messages );
+void SV_CompareClientMessages( client_t **clients, int numClients, sizebuf_t **messages, const int *surpressCounts, int firstEntity );
 
 
 void SV_Error( char *error, ... );
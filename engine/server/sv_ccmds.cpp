@@ -998,6 +998,43 @@ void SV_ServerCommand_f( void )
 
 //===========================================================
 
+/*
+================
+SV_Stats_f
+================
+*/
+static void SV_Stats_f( void )
+{
+	if ( !svs.clients )
+	{
+		Com_Printf( "No server running.\n" );
+		return;
+	}
+
+	if ( Cmd_Argc() > 1 && !Q_stricmp( Cmd_Argv( 1 ), "clear" ) )
+	{
+		svs.stats = {};
+		return;
+	}
+
+	int numClients = 0;
+	for ( int i = 0; i < maxclients->value; i++ )
+	{
+		if ( svs.clients[ i ].state != cs_free )
+			numClients++;
+	}
+
+	Com_Printf( "%i of %i client slots in use\n", numClients, ( int ) maxclients->value );
+	Com_Printf( "%llu packets read, %llu of them connectionless\n",
+	            ( unsigned long long ) svs.stats.packets, ( unsigned long long ) svs.stats.connectionless );
+	Com_Printf( "%llu client lookups, %llu of them from unknown addresses\n",
+	            ( unsigned long long ) svs.stats.lookups, ( unsigned long long ) svs.stats.lookupMisses );
+	Com_Printf( "%llu frames built in parallel, %llu one client at a time, %llu client frames that differed\n",
+	            ( unsigned long long ) svs.stats.parallelFrames, ( unsigned long long ) svs.stats.serialFrames, ( unsigned long long ) svs.stats.mismatchedFrames );
+	Com_Printf( "%llu client views culled as %llu shared ones\n",
+	            ( unsigned long long ) svs.stats.clientViews, ( unsigned long long ) svs.stats.viewGroups );
+}
+
 /*
 ==================
 SV_InitOperatorCommands
@@ -1008,6 +1045,7 @@ void SV_InitOperatorCommands( void )
 	Cmd_AddCommand( "heartbeat", SV_Heartbeat_f );
 	Cmd_AddCommand( "kick", SV_Kick_f );
 	Cmd_AddCommand( "status", SV_Status_f );
+	Cmd_AddCommand( "sv_stats", SV_Stats_f );
 	Cmd_AddCommand( "serverinfo", SV_Serverinfo_f );
 	Cmd_AddCommand( "dumpuser", SV_DumpUser_f );
 
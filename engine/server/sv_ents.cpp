@@ -20,6 +20,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "server.h"
 
+#include <algorithm>
+#include <bit>
+#include <vector>
+
 /*
 =============================================================================
 
@@ -446,22 +450,21 @@ Build a client frame structure
 =============================================================================
 */
 
-byte fatpvs[ 65536 / 8 ];// 32767 is MAX_MAP_LEAFS
+#define FATPVS_WORDS ( MAX_MAP_LEAFS / 64 )
 
 /*
 ============
-SV_FatPVS
+SV_FatClusters
 
-The client will interpolate the view position,
-so we can't use a single PVS point
-===========
+Fills in the distinct clusters within a few units of the view, sorted,
+and returns how many there are
+============
 */
-void SV_FatPVS( vec3_t org )
+static int SV_FatClusters( const vec3_t org, int *clusters )
 {
 	int    leafs[ 64 ];
 	int    i, j, count;
-	int    longs;
-	byte  *src;
+	int    numClusters;
 	vec3_t mins, maxs;
 
 	for ( i = 0; i < 3; i++ )
@@ -473,58 +476,127 @@ void SV_FatPVS( vec3_t org )
 	count = CM_BoxLeafnums( mins, maxs, leafs, 64, NULL );
 	if ( count < 1 )
 		Com_Error( ERR_FATAL, "SV_FatPVS: count < 1" );
-	longs = ( CM_NumClusters() + 31 ) >> 5;
 
-	// convert leafs to clusters
+	// convert leafs to clusters, skipping any we already have
+	numClusters = 0;
 	for ( i = 0; i < count; i++ )
-		leafs[ i ] = CM_LeafCluster( leafs[ i ] );
-
-	memcpy( fatpvs, CM_ClusterPVS( leafs[ 0 ] ), longs << 2 );
-	// or in all the other leaf bits
-	for ( i = 1; i < count; i++ )
 	{
-		for ( j = 0; j < i; j++ )
-			if ( leafs[ i ] == leafs[ j ] )
+		int cluster = CM_LeafCluster( leafs[ i ] );
+		for ( j = 0; j < numClusters; j++ )
+			if ( clusters[ j ] == cluster )
 				break;
-		if ( j != i )
-			continue;// already have the cluster we want
-		src = CM_ClusterPVS( leafs[ i ] );
-		for ( j = 0; j < longs; j++ )
-			( ( long * ) fatpvs )[ j ] |= ( ( long * ) src )[ j ];
+		if ( j == numClusters )
+			clusters[ numClusters++ ] = cluster;
 	}
+
+	std::sort( clusters, clusters + numClusters );
+	return numClusters;
 }
 
+/*
+============
+SV_DecompressFatPVS
+
+Ors together the PVS of each of the given clusters
+============
+*/
+static void SV_DecompressFatPVS( const int *clusters, int numClusters, uint64_t *fatpvs )
+{
+	CM_DecompressClusterPVS( clusters[ 0 ], fatpvs );
+	for ( int i = 1; i < numClusters; i++ )
+		CM_MergeClusterPVS( clusters[ i ], fatpvs );
+}
+
+/*
+============
+SV_FatPVS
+
+The client will interpolate the view position,
+so we can't use a single PVS point
+===========
+*/
+static void SV_FatPVS( vec3_t org, uint64_t *fatpvs )
+{
+	int clusters[ 64 ];
+	int numClusters = SV_FatClusters( org, clusters );
+	SV_DecompressFatPVS( clusters, numClusters, fatpvs );
+}
+
+/**
+ * Whether the entity is something that's ever sent, regardless of who's
+ * looking.
+ */
+static bool SV_IsSendable( const edict_t *ent )
+{
+	// ignore ents without visible models
+	if ( ent->svflags & SVF_NOCLIENT )
+		return false;
+
+	// ignore ents without visible models unless they have an effect
+	if ( !ent->s.modelindex && !ent->s.effects && !ent->s.sound && !ent->s.event )
+		return false;
+
+	return true;
+}
+
+static bool SV_IsInConnectedArea( int clientarea, const edict_t *ent )
+{
+	// check area
+	if ( !CM_AreasConnected( clientarea, ent->areanum ) )
+	{// doors can legally straddle two areas, so
+		// we may need to check another one
+		if ( !ent->areanum2 || !CM_AreasConnected( clientarea, ent->areanum2 ) )
+			return false;// blocked by a door
+	}
+
+	return true;
+}
+
+static bool SV_IsWithinEarshot( const vec3_t org, const edict_t *ent )
+{
+	if ( !ent->s.modelindex )
+	{// don't send sounds if they will be attenuated away
+		vec3_t delta;
+		float  len;
+
+		VectorSubtract( org, ent->s.origin, delta );
+		len = VectorLength( delta );
+		if ( len > 400 )
+			return false;
+	}
+
+	return true;
+}
+
+/**
+ * Everything needed to work out what a client can see, gathered up on the
+ * main thread as it needs the map.
+ */
+typedef struct
+{
+	vec3_t org;
+	int    clientarea, clientcluster;
+} clientview_t;
 
 /*
 =============
-SV_BuildClientFrame
+SV_SetupClientFrame
 
-Decides which entities are going to be visible to the client, and
-copies off the playerstat and areabits.
+Starts off the client's frame for this server frame, copying off the
+playerstate and areabits. Returns false if the client isn't in the game
+yet, in which case the last frame is left as it was.
 =============
 */
-void SV_BuildClientFrame( client_t *client )
+static bool SV_SetupClientFrame( client_t *client, clientview_t *view )
 {
-	int             e, i;
-	vec3_t          org;
-	edict_t        *ent;
 	edict_t        *clent;
 	client_frame_t *frame;
-	entity_state_t *state;
-	int             l;
-	int             clientarea, clientcluster;
+	int             i;
 	int             leafnum;
-	int             c_fullsend;
-	byte           *clientphs;
-	byte           *bitvector;
 
 	clent = client->edict;
 	if ( !clent->client )
-		return;// not in game yet
-
-#if 0
-	numprojs = 0; // no projectiles yet
-#endif
+		return false;// not in game yet
 
 	// this is the frame we are creating
 	frame = &client->frames[ sv.framenum & UPDATE_MASK ];
@@ -533,50 +605,63 @@ void SV_BuildClientFrame( client_t *client )
 
 	// find the client's PVS
 	for ( i = 0; i < 3; i++ )
-		org[ i ] = clent->client->ps.pmove.origin[ i ] * 0.125 + clent->client->ps.viewoffset[ i ];
+		view->org[ i ] = clent->client->ps.pmove.origin[ i ] * 0.125 + clent->client->ps.viewoffset[ i ];
 
-	leafnum       = CM_PointLeafnum( org );
-	clientarea    = CM_LeafArea( leafnum );
-	clientcluster = CM_LeafCluster( leafnum );
+	leafnum             = CM_PointLeafnum( view->org );
+	view->clientarea    = CM_LeafArea( leafnum );
+	view->clientcluster = CM_LeafCluster( leafnum );
 
 	// calculate the visible areas
-	frame->areabytes = CM_WriteAreaBits( frame->areabits, clientarea );
+	frame->areabytes = CM_WriteAreaBits( frame->areabits, view->clientarea );
 
 	// grab the current player_state_t
 	frame->ps = clent->client->ps;
 
+	return true;
+}
 
-	SV_FatPVS( org );
-	clientphs = CM_ClusterPHS( clientcluster );
+/*
+=============
+SV_CullEntities
 
-	// build up the list of visible entities
-	frame->num_entities = 0;
-	frame->first_entity = svs.next_client_entities;
+Decides which entities are going to be visible to the client, writing
+their numbers out to visible. Only reads from the world, so any number
+of clients can be culled at once.
+=============
+*/
+static int SV_CullEntities( const client_t *client, const clientview_t *view, uint16_t *visible )
+{
+	int      e, i;
+	int      l;
+	int      numVisible;
+	edict_t *ent;
+	edict_t *clent;
+	byte    *bitvector;
+	uint64_t fatpvsrow[ FATPVS_WORDS ];
+	uint64_t clientphsrow[ FATPVS_WORDS ];
+	byte    *fatpvs    = ( byte * ) fatpvsrow;
+	byte    *clientphs = ( byte * ) clientphsrow;
+	vec3_t   org;
+
+	clent = client->edict;
+	VectorCopy( view->org, org );
 
-	c_fullsend = 0;
+	SV_FatPVS( org, fatpvsrow );
+	CM_DecompressClusterPHS( view->clientcluster, clientphsrow );
+
+	numVisible = 0;
 
 	for ( e = 1; e < ge->num_edicts; e++ )
 	{
 		ent = EDICT_NUM( e );
-
-		// ignore ents without visible models
-		if ( ent->svflags & SVF_NOCLIENT )
-			continue;
-
-		// ignore ents without visible models unless they have an effect
-		if ( !ent->s.modelindex && !ent->s.effects && !ent->s.sound && !ent->s.event )
+		if ( !SV_IsSendable( ent ) )
 			continue;
 
 		// ignore if not touching a PV leaf
 		if ( ent != clent )
 		{
-			// check area
-			if ( !CM_AreasConnected( clientarea, ent->areanum ) )
-			{// doors can legally straddle two areas, so
-				// we may need to check another one
-				if ( !ent->areanum2 || !CM_AreasConnected( clientarea, ent->areanum2 ) )
-					continue;// blocked by a door
-			}
+			if ( !SV_IsInConnectedArea( view->clientarea, ent ) )
+				continue;
 
 			// beams just check one point for PHS
 			if ( ent->s.renderfx & RF_BEAM )
@@ -600,7 +685,6 @@ void SV_BuildClientFrame( client_t *client )
 				{// too many leafs for individual check, go by headnode
 					if ( !CM_HeadnodeVisible( ent->headnode, bitvector ) )
 						continue;
-					c_fullsend++;
 				}
 				else
 				{// check individual leafs
@@ -614,39 +698,507 @@ void SV_BuildClientFrame( client_t *client )
 						continue;// not visible
 				}
 
-				if ( !ent->s.modelindex )
-				{// don't send sounds if they will be attenuated away
-					vec3_t delta;
-					float  len;
-
-					VectorSubtract( org, ent->s.origin, delta );
-					len = VectorLength( delta );
-					if ( len > 400 )
-						continue;
-				}
+				if ( !SV_IsWithinEarshot( org, ent ) )
+					continue;
 			}
 		}
 
-#if 0
-		if (SV_AddProjectileUpdate(ent))
-			continue; // added as a special projectile
-#endif
+		visible[ numVisible++ ] = e;
+	}
 
-		// add it to the circular client_entities array
-		state = &svs.client_entities[ svs.next_client_entities % svs.num_client_entities ];
-		if ( ent->s.number != e )
+	return numVisible;
+}
+
+/*
+=============
+SV_FixEntityNumbers
+
+Has to happen on the main thread, as it writes back to the entities
+=============
+*/
+static void SV_FixEntityNumbers( const uint16_t *visible, int numVisible )
+{
+	for ( int i = 0; i < numVisible; i++ )
+	{
+		edict_t *ent = EDICT_NUM( visible[ i ] );
+		if ( ent->s.number != visible[ i ] )
 		{
 			Com_DPrintf( "FIXING ENT->S.NUMBER!!!\n" );
-			ent->s.number = e;
+			ent->s.number = visible[ i ];
 		}
-		*state = ent->s;
+	}
+}
+
+/*
+=============
+SV_CopyEntities
+
+Copies the visible entities into the frame's slice of the circular
+client_entities array, which has to have been reserved already
+=============
+*/
+static void SV_CopyEntities( client_t *client, const client_frame_t *frame, const uint16_t *visible )
+{
+	for ( int i = 0; i < frame->num_entities; i++ )
+	{
+		edict_t        *ent   = EDICT_NUM( visible[ i ] );
+		entity_state_t *state = &svs.client_entities[ ( frame->first_entity + i ) % svs.num_client_entities ];
+		*state                = ent->s;
 
 		// don't mark players missiles as solid
 		if ( ent->owner == client->edict )
 			state->solid = 0;
+	}
+}
+
+/*
+=============
+SV_BuildClientFrame
+
+Decides which entities are going to be visible to the client, and
+copies off the playerstat and areabits.
+=============
+*/
+void SV_BuildClientFrame( client_t *client )
+{
+	static uint16_t visible[ MAX_EDICTS ];
+	client_frame_t *frame;
+	clientview_t    view;
+
+	if ( !SV_SetupClientFrame( client, &view ) )
+		return;
+
+	frame = &client->frames[ sv.framenum & UPDATE_MASK ];
+
+	// build up the list of visible entities
+	frame->num_entities = SV_CullEntities( client, &view, visible );
+	frame->first_entity = svs.next_client_entities;
+	svs.next_client_entities += frame->num_entities;
+
+	SV_FixEntityNumbers( visible, frame->num_entities );
+	SV_CopyEntities( client, frame, visible );
+}
+
+/*
+=============================================================================
+
+Build many client frames at once
+
+Culling and encoding each client's frame only reads the world, so it's
+spread across the job system. The frames are handed their slices of
+client_entities in the same order they would be one at a time, which
+keeps the messages byte for byte the same as the serial path; setting
+sv_parallelframes to 2 builds them both ways and compares.
+
+Rather than every client going through every edict, the ones that could
+be sent at all are gathered up once per frame, along with an index from
+each cluster to the entities touching it. Clients looking out from the
+same clusters share a view, and the entities in its fat PVS (or PHS for
+beams) are worked out once as a bitset. All that's left per client is
+checking areas and how far away sounds are.
+
+=============================================================================
+*/
+
+/**
+ * Clients looking out from the same set of clusters see the same PVS,
+ * so only need it worked out once.
+ */
+typedef struct
+{
+	uint64_t                hash;
+	int                     clusters[ 64 ];// distinct clusters around the view, sorted
+	int                     numClusters;
+	int                     clientcluster;// for the PHS
+	std::vector< uint64_t > fatpvs;
+	std::vector< uint64_t > candidates;// sendable entities in view, by index in sv_sendable
+} clientview_group_t;
+
+typedef struct
+{
+	client_t    *client;
+	clientview_t view;
+	bool         inGame;
+	int          group;
+	int          numVisible;
+	uint16_t     visible[ MAX_EDICTS ];
+	sizebuf_t    msg;
+	byte         msgBuf[ MAX_MSGLEN ];
+} clientbuild_t;
+
+static std::vector< clientbuild_t >      sv_clientBuilds;
+static std::vector< clientview_group_t > sv_viewGroups;
+static int                               sv_numViewGroups;
+
+static std::vector< uint16_t > sv_sendable;        // edicts that could be sent to anyone this frame
+static std::vector< int >      sv_sendableIndex;   // edict number to index in sv_sendable, or -1
+static std::vector< int >      sv_clusterFirst;    // per cluster, where its entities start in sv_clusterEntities
+static std::vector< int >      sv_clusterNext;     // scratch while filling in sv_clusterEntities
+static std::vector< uint16_t > sv_clusterEntities; // indices in sv_sendable, grouped by cluster
+static std::vector< uint16_t > sv_headnodeEntities;// too big to go by cluster, so checked by headnode instead
+static std::vector< uint16_t > sv_beamEntities;    // only checked against the PHS
+
+/*
+=============
+SV_GatherSendableEntities
+
+Builds the list of everything that could be sent this frame, and the
+index from clusters back to them
+=============
+*/
+static void SV_GatherSendableEntities( void )
+{
+	PROFILE_ZONE( "SV_GatherSendableEntities" );
+
+	int numClusters = CM_NumClusters();
+
+	sv_sendable.clear();
+	sv_headnodeEntities.clear();
+	sv_beamEntities.clear();
+	sv_sendableIndex.assign( ge->num_edicts, -1 );
+	sv_clusterFirst.assign( numClusters + 1, 0 );
+
+	for ( int e = 1; e < ge->num_edicts; e++ )
+	{
+		const edict_t *ent = EDICT_NUM( e );
+		if ( !SV_IsSendable( ent ) )
+			continue;
+
+		uint16_t index        = ( uint16_t ) sv_sendable.size();
+		sv_sendableIndex[ e ] = index;
+		sv_sendable.push_back( e );
+
+		if ( ent->s.renderfx & RF_BEAM )
+			sv_beamEntities.push_back( index );
+		else if ( ent->num_clusters == -1 )
+			sv_headnodeEntities.push_back( index );
+		else
+		{
+			for ( int i = 0; i < ent->num_clusters; i++ )
+				sv_clusterFirst[ ent->clusternums[ i ] + 1 ]++;
+		}
+	}
+
+	// counts to offsets, then fill them in
+	for ( int i = 0; i < numClusters; i++ )
+		sv_clusterFirst[ i + 1 ] += sv_clusterFirst[ i ];
+
+	sv_clusterEntities.resize( sv_clusterFirst[ numClusters ] );
+
+	sv_clusterNext.assign( sv_clusterFirst.begin(), sv_clusterFirst.end() - 1 );
+	for ( size_t index = 0; index < sv_sendable.size(); index++ )
+	{
+		const edict_t *ent = EDICT_NUM( sv_sendable[ index ] );
+		if ( ( ent->s.renderfx & RF_BEAM ) || ent->num_clusters == -1 )
+			continue;
+
+		for ( int i = 0; i < ent->num_clusters; i++ )
+			sv_clusterEntities[ sv_clusterNext[ ent->clusternums[ i ] ]++ ] = ( uint16_t ) index;
+	}
+}
+
+/**
+ * Finds the view group for the clusters around a client, adding one if
+ * nobody else is looking out from there.
+ */
+static int SV_FindViewGroup( const int *clusters, int numClusters, int clientcluster )
+{
+	uint64_t hash = 14695981039346656037ULL;
+	for ( int i = 0; i < numClusters; i++ )
+		hash = ( hash ^ ( uint32_t ) clusters[ i ] ) * 1099511628211ULL;
+	hash = ( hash ^ ( uint32_t ) clientcluster ) * 1099511628211ULL;
+
+	for ( int i = 0; i < sv_numViewGroups; i++ )
+	{
+		const clientview_group_t *group = &sv_viewGroups[ i ];
+		if ( group->hash == hash && group->numClusters == numClusters && group->clientcluster == clientcluster &&
+		     std::equal( clusters, clusters + numClusters, group->clusters ) )
+			return i;
+	}
+
+	if ( sv_viewGroups.size() <= ( size_t ) sv_numViewGroups )
+		sv_viewGroups.resize( sv_numViewGroups + 1 );
+
+	clientview_group_t *group = &sv_viewGroups[ sv_numViewGroups ];
+	group->hash               = hash;
+	group->numClusters        = numClusters;
+	group->clientcluster      = clientcluster;
+	std::copy( clusters, clusters + numClusters, group->clusters );
+
+	return sv_numViewGroups++;
+}
+
+/*
+=============
+SV_BuildViewGroup
+
+Works out which of the sendable entities fall within a group's view,
+before areas are taken into account
+=============
+*/
+static void SV_BuildViewGroup( clientview_group_t *group )
+{
+	int      numClusters = CM_NumClusters();
+	int      numWords    = CM_ClusterRowWords();
+	uint64_t clientphsrow[ FATPVS_WORDS ];
+	byte    *clientphs = ( byte * ) clientphsrow;
+
+	group->fatpvs.resize( numWords );
+	SV_DecompressFatPVS( group->clusters, group->numClusters, group->fatpvs.data() );
+	const byte *fatpvs = ( const byte * ) group->fatpvs.data();
+
+	group->candidates.assign( ( sv_sendable.size() + 63 ) / 64, 0 );
+	uint64_t *candidates = group->candidates.data();
+
+	// everything touching a cluster in the fat PVS, skipping over whole
+	// words of clusters that aren't
+	for ( int word = 0; word < numWords; word++ )
+	{
+		if ( group->fatpvs[ word ] == 0 )
+			continue;
+
+		int last = std::min( ( word + 1 ) << 6, numClusters );
+		for ( int cluster = word << 6; cluster < last; cluster++ )
+		{
+			if ( !( fatpvs[ cluster >> 3 ] & ( 1 << ( cluster & 7 ) ) ) )
+				continue;
+
+			for ( int i = sv_clusterFirst[ cluster ]; i < sv_clusterFirst[ cluster + 1 ]; i++ )
+			{
+				uint16_t index = sv_clusterEntities[ i ];
+				candidates[ index >> 6 ] |= 1ULL << ( index & 63 );
+			}
+		}
+	}
+
+	// too many leafs for individual check, go by headnode
+	for ( uint16_t index : sv_headnodeEntities )
+	{
+		if ( CM_HeadnodeVisible( EDICT_NUM( sv_sendable[ index ] )->headnode, ( byte * ) fatpvs ) )
+			candidates[ index >> 6 ] |= 1ULL << ( index & 63 );
+	}
+
+	// beams just check one point for PHS
+	if ( !sv_beamEntities.empty() )
+	{
+		CM_DecompressClusterPHS( group->clientcluster, clientphsrow );
+		for ( uint16_t index : sv_beamEntities )
+		{
+			int l = EDICT_NUM( sv_sendable[ index ] )->clusternums[ 0 ];
+			if ( clientphs[ l >> 3 ] & ( 1 << ( l & 7 ) ) )
+				candidates[ index >> 6 ] |= 1ULL << ( index & 63 );
+		}
+	}
+}
+
+/*
+=============
+SV_CullGroupEntities
+
+As SV_CullEntities, but starting from what the client's view group can
+see rather than every edict
+=============
+*/
+static int SV_CullGroupEntities( const client_t *client, const clientview_t *view, const clientview_group_t *group, uint16_t *visible )
+{
+	int      numVisible = 0;
+	edict_t *clent      = client->edict;
+	int      own        = sv_sendableIndex[ NUM_FOR_EDICT( clent ) ];
+
+	for ( size_t word = 0; word < group->candidates.size(); word++ )
+	{
+		uint64_t bits = group->candidates[ word ];
+
+		// the client's own entity goes out regardless
+		if ( own >= 0 && ( size_t ) ( own >> 6 ) == word )
+			bits |= 1ULL << ( own & 63 );
+
+		while ( bits != 0 )
+		{
+			int index = ( int ) ( word << 6 ) + std::countr_zero( bits );
+			bits &= bits - 1;
+
+			int      e   = sv_sendable[ index ];
+			edict_t *ent = EDICT_NUM( e );
+			if ( ent != clent )
+			{
+				if ( !SV_IsInConnectedArea( view->clientarea, ent ) )
+					continue;
+				if ( !( ent->s.renderfx & RF_BEAM ) && !SV_IsWithinEarshot( view->org, ent ) )
+					continue;
+			}
+
+			visible[ numVisible++ ] = e;
+		}
+	}
+
+	return numVisible;
+}
+
+/**
+ * Returns true if writing the new frames could trample over entities
+ * that're still to be read back, either as a delta base or as a stale
+ * frame for a client that isn't in the game yet. One at a time that's
+ * well-defined, if wrong, so leave it to the serial path.
+ */
+static bool SV_FramesOverlap( int numClients, int end )
+{
+	for ( int i = 0; i < numClients; i++ )
+	{
+		const clientbuild_t *build  = &sv_clientBuilds[ i ];
+		const client_t      *client = build->client;
+
+		if ( !build->inGame )
+			return true;
+
+		if ( client->lastframe <= 0 || sv.framenum - client->lastframe >= ( UPDATE_BACKUP - 3 ) )
+			continue;// won't be delta'd
+
+		const client_frame_t *oldframe = &client->frames[ client->lastframe & UPDATE_MASK ];
+		if ( end - oldframe->first_entity > svs.num_client_entities )
+			return true;
+	}
+
+	return false;
+}
+
+/*
+=============
+SV_BuildClientMessages
+
+Builds and writes out the frames for each of the given clients, in order,
+returning their messages in messages. Returns false if they couldn't be
+built in parallel, in which case nothing has been touched that the
+serial path won't redo the same way.
+=============
+*/
+bool SV_BuildClientMessages( client_t **clients, int numClients, sizebuf_t **messages )
+{
+	PROFILE_ZONE( "SV_BuildClientMessages" );
+
+	if ( sv_clientBuilds.size() < ( size_t ) numClients )
+		sv_clientBuilds.resize( numClients );
+
+	// anything that needs the map, or writes to the world, stays on the main thread
+	SV_GatherSendableEntities();
+
+	sv_numViewGroups = 0;
+	for ( int i = 0; i < numClients; i++ )
+	{
+		clientbuild_t *build = &sv_clientBuilds[ i ];
+		build->client        = clients[ i ];
+		build->inGame        = SV_SetupClientFrame( build->client, &build->view );
+		build->numVisible    = 0;
+		if ( !build->inGame )
+			continue;
+
+		int clusters[ 64 ];
+		int numClusters = SV_FatClusters( build->view.org, clusters );
+		build->group    = SV_FindViewGroup( clusters, numClusters, build->view.clientcluster );
+
+		svs.stats.clientViews++;
+	}
+
+	svs.stats.viewGroups += sv_numViewGroups;
+
+	Job_ParallelFor( 0, sv_numViewGroups, []( size_t i )
+	{
+		SV_BuildViewGroup( &sv_viewGroups[ i ] );
+	} );
+
+	Job_ParallelFor( 0, numClients, []( size_t i )
+	{
+		clientbuild_t *build = &sv_clientBuilds[ i ];
+		if ( build->inGame )
+			build->numVisible = SV_CullGroupEntities( build->client, &build->view, &sv_viewGroups[ build->group ], build->visible );
+	} );
+
+	// hand out the slices in the same order they'd be taken one at a time
+	int start = svs.next_client_entities;
+	int end   = start;
+	for ( int i = 0; i < numClients; i++ )
+		end += sv_clientBuilds[ i ].numVisible;
+
+	if ( end - start > svs.num_client_entities || SV_FramesOverlap( numClients, end ) )
+	{
+		svs.stats.serialFrames++;
+		return false;
+	}
+
+	for ( int i = 0; i < numClients; i++ )
+	{
+		clientbuild_t  *build = &sv_clientBuilds[ i ];
+		client_frame_t *frame = &build->client->frames[ sv.framenum & UPDATE_MASK ];
+
+		frame->num_entities = build->numVisible;
+		frame->first_entity = svs.next_client_entities;
+		svs.next_client_entities += build->numVisible;
+
+		SV_FixEntityNumbers( build->visible, build->numVisible );
+	}
+
+	Job_ParallelFor( 0, numClients, []( size_t i )
+	{
+		clientbuild_t *build = &sv_clientBuilds[ i ];
+		client_frame_t *frame = &build->client->frames[ sv.framenum & UPDATE_MASK ];
+
+		SV_CopyEntities( build->client, frame, build->visible );
+
+		SZ_Init( &build->msg, build->msgBuf, sizeof( build->msgBuf ) );
+		build->msg.allowoverflow = true;
+
+		// send over all the relevant entity_state_t
+		// and the player_state_t
+		SV_WriteFrameToClient( build->client, &build->msg );
+	} );
+
+	for ( int i = 0; i < numClients; i++ )
+		messages[ i ] = &sv_clientBuilds[ i ].msg;
+
+	svs.stats.parallelFrames++;
+	return true;
+}
+
+/*
+=============
+SV_CompareClientMessages
+
+Rebuilds the frames written by SV_BuildClientMessages one at a time, and
+checks they came out the same. The serial ones are what's sent on.
+=============
+*/
+void SV_CompareClientMessages( client_t **clients, int numClients, sizebuf_t **messages, const int *surpressCounts, int firstEntity )
+{
+	byte      buf[ MAX_MSGLEN ];
+	sizebuf_t msg;
+
+	svs.next_client_entities = firstEntity;
+
+	for ( int i = 0; i < numClients; i++ )
+	{
+		client_t *client      = clients[ i ];
+		client->surpressCount = surpressCounts[ i ];
+
+		SV_BuildClientFrame( client );
+
+		SZ_Init( &msg, buf, sizeof( buf ) );
+		msg.allowoverflow = true;
+		SV_WriteFrameToClient( client, &msg );
+
+		if ( msg.cursize != messages[ i ]->cursize || memcmp( msg.data, messages[ i ]->data, msg.cursize ) != 0 )
+		{
+			size_t offset = 0;
+			while ( offset < std::min( msg.cursize, messages[ i ]->cursize ) && msg.data[ offset ] == messages[ i ]->data[ offset ] )
+				offset++;
+
+			Com_Printf( "WARNING: parallel frame for %s differs from serial at byte %zu (%zu vs %zu bytes)\n",
+			            client->name, offset, messages[ i ]->cursize, msg.cursize );
+			svs.stats.mismatchedFrames++;
+		}
 
-		svs.next_client_entities++;
-		frame->num_entities++;
+		SZ_Clear( messages[ i ] );
+		SZ_Write( messages[ i ], msg.data, msg.cursize );
+		messages[ i ]->overflowed = msg.overflowed;
 	}
 }
 
@@ -381,8 +381,10 @@ void SV_InitGameProgs( void )
 	import.SetAreaPortalState = CM_SetAreaPortalState;
 	import.AreasConnected     = CM_AreasConnected;
 
-	import.LoadFile = FS_LoadFile;
-	import.FreeFile = FS_FreeFile;
+	import.LoadFile  = FS_LoadFile;
+	import.FreeFile  = FS_FreeFile;
+	import.MapFile   = FS_MapFile;
+	import.UnmapFile = FS_UnmapFile;
 
 	game_export_t *GetGameAPI( game_import_t * import );
 	ge = ( game_export_t * ) GetGameAPI( &import );
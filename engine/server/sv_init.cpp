@@ -228,6 +228,8 @@ void SV_SpawnServer( char *server, char *spawnpoint, server_state_t serverstate,
 	}
 	else
 	{
+		FS_BeginLoadManifest( server );
+
 		Com_sprintf( sv.configstrings[ CS_MODELS + 1 ], sizeof( sv.configstrings[ CS_MODELS + 1 ] ),
 		             "maps/%s.bsp", server );
 		sv.models[ 1 ] = CM_LoadMap( sv.configstrings[ CS_MODELS + 1 ], false, &checksum );
@@ -276,6 +278,10 @@ void SV_SpawnServer( char *server, char *spawnpoint, server_state_t serverstate,
 	// set serverinfo variable
 	Cvar_FullSet( "mapname", sv.name, CVAR_SERVERINFO | CVAR_NOSET );
 
+	// nothing's going to be rendered, so this is as loaded as it gets
+	if ( dedicated->value )
+		FS_EndLoadManifest();
+
 	Com_Printf( "-------------------------------------\n" );
 }
 
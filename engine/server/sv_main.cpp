@@ -21,6 +21,8 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "server.h"
 #include "app.h"
 
+#include <unordered_map>
+
 netadr_t master_adr[ MAX_MASTERS ];// address of group servers
 
 client_t *sv_client;// current client
@@ -29,6 +31,8 @@ cvar_t *sv_paused;
 cvar_t *sv_timedemo;
 
 cvar_t *sv_enforcetime;
+cvar_t *sv_tickrate;// times a second packets are read and the world checked on
+cvar_t *sv_parallelframes;// 1 builds client frames across the job system, 2 also checks them against doing it serially
 
 cvar_t *timeout;   // seconds without any message
 cvar_t *zombietime;// seconds to sink messages after disconnect
@@ -86,11 +90,84 @@ void SV_DropClient( client_t *drop )
 		drop->download = NULL;
 	}
 
+	// stays linked by address until it's freed, so anything still on its way is soaked up
 	drop->state     = cs_zombie;// become free in a few seconds
 	drop->name[ 0 ] = 0;
 }
 
 
+/*
+==============================================================================
+
+CLIENT ADDRESS LOOKUP
+
+Every client that isn't free is indexed by its address and qport, so
+incoming packets can find who they're from without going through every
+slot. The port is left out on purpose, as it's what gets fixed up for
+clients behind address translating routers.
+
+==============================================================================
+*/
+
+static std::unordered_multimap< uint64_t, client_t * > sv_clientAddresses;
+
+/**
+ * Packs everything NET_CompareBaseAdr looks at, along with the qport, into
+ * a key. IPX addresses don't fit, so are folded down and may collide.
+ */
+static uint64_t SV_ClientAddressKey( const netadr_t &adr, int qport )
+{
+	uint32_t base = 0;
+	if ( adr.type == NA_IP )
+		base = ( uint32_t ) adr.ip[ 0 ] | ( ( uint32_t ) adr.ip[ 1 ] << 8 ) | ( ( uint32_t ) adr.ip[ 2 ] << 16 ) | ( ( uint32_t ) adr.ip[ 3 ] << 24 );
+	else if ( adr.type == NA_IPX )
+	{
+		base = 2166136261u;
+		for ( byte b : adr.ipx )
+			base = ( base ^ b ) * 16777619u;
+	}
+
+	return ( ( uint64_t ) adr.type << 48 ) | ( ( uint64_t ) ( qport & 0xffff ) << 32 ) | base;
+}
+
+void SV_LinkClientAddress( client_t *cl )
+{
+	sv_clientAddresses.emplace( SV_ClientAddressKey( cl->netchan.remote_address, cl->netchan.qport ), cl );
+}
+
+void SV_UnlinkClientAddress( client_t *cl )
+{
+	auto range = sv_clientAddresses.equal_range( SV_ClientAddressKey( cl->netchan.remote_address, cl->netchan.qport ) );
+	for ( auto i = range.first; i != range.second; ++i )
+	{
+		if ( i->second == cl )
+		{
+			sv_clientAddresses.erase( i );
+			return;
+		}
+	}
+}
+
+/**
+ * Returns the client a sequenced packet from the given address is meant
+ * for, or null if it's not from anyone we know.
+ */
+client_t *SV_FindClient( netadr_t adr, int qport )
+{
+	svs.stats.lookups++;
+
+	auto range = sv_clientAddresses.equal_range( SV_ClientAddressKey( adr, qport ) );
+	for ( auto i = range.first; i != range.second; ++i )
+	{
+		client_t *cl = i->second;
+		if ( cl->netchan.qport == qport && NET_CompareBaseAdr( adr, cl->netchan.remote_address ) )
+			return cl;
+	}
+
+	svs.stats.lookupMisses++;
+	return nullptr;
+}
+
 /*
 ==============================================================================
 
@@ -369,6 +446,10 @@ void SVC_DirectConnect( void )
 	}
 
 gotnewcl:
+	// a reconnect may be coming in on a different qport
+	if ( newcl->state != cs_free )
+		SV_UnlinkClientAddress( newcl );
+
 	// build a new connection
 	// accept the new client
 	// this is the only place a client_t is ever initialized
@@ -401,6 +482,7 @@ gotnewcl:
 	Netchan_Setup( NS_SERVER, &newcl->netchan, adr, qport );
 
 	newcl->state = cs_connected;
+	SV_LinkClientAddress( newcl );
 
 	SZ_Init( &newcl->datagram, newcl->datagram_buf, sizeof( newcl->datagram_buf ) );
 	newcl->datagram.allowoverflow = true;
@@ -593,15 +675,17 @@ SV_ReadPackets
 */
 void SV_ReadPackets( void )
 {
-	int       i;
 	client_t *cl;
 	int       qport;
 
 	while ( NET_GetPacket( NS_SERVER, &net_from, &net_message ) )
 	{
+		svs.stats.packets++;
+
 		// check for connectionless packet (0xffffffff) first
 		if ( *( int * ) net_message.data == -1 )
 		{
+			svs.stats.connectionless++;
 			SV_ConnectionlessPacket();
 			continue;
 		}
@@ -614,33 +698,25 @@ void SV_ReadPackets( void )
 		qport = MSG_ReadShort( &net_message ) & 0xffff;
 
 		// check for packets from connected clients
-		for ( i = 0, cl = svs.clients; i < maxclients->value; i++, cl++ )
+		cl = SV_FindClient( net_from, qport );
+		if ( cl == nullptr )
+			continue;
+
+		// the port isn't part of the lookup, so this doesn't need relinking
+		if ( cl->netchan.remote_address.port != net_from.port )
 		{
-			if ( cl->state == cs_free )
-				continue;
-			if ( !NET_CompareBaseAdr( net_from, cl->netchan.remote_address ) )
-				continue;
-			if ( cl->netchan.qport != qport )
-				continue;
-			if ( cl->netchan.remote_address.port != net_from.port )
-			{
-				Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
-				cl->netchan.remote_address.port = net_from.port;
-			}
+			Com_Printf( "SV_ReadPackets: fixing up a translated port\n" );
+			cl->netchan.remote_address.port = net_from.port;
+		}
 
-			if ( Netchan_Process( &cl->netchan, &net_message ) )
-			{// this is a valid, sequenced packet, so process it
-				if ( cl->state != cs_zombie )
-				{
-					cl->lastmessage = svs.realtime;// don't timeout
-					SV_ExecuteClientMessage( cl );
-				}
+		if ( Netchan_Process( &cl->netchan, &net_message ) )
+		{// this is a valid, sequenced packet, so process it
+			if ( cl->state != cs_zombie )
+			{
+				cl->lastmessage = svs.realtime;// don't timeout
+				SV_ExecuteClientMessage( cl );
 			}
-			break;
 		}
-
-		if ( i != maxclients->value )
-			continue;
 	}
 }
 
@@ -675,6 +751,7 @@ void SV_CheckTimeouts( void )
 
 		if ( cl->state == cs_zombie && cl->lastmessage < zombiepoint )
 		{
+			SV_UnlinkClientAddress( cl );
 			cl->state = cs_free;// can now be reused
 			continue;
 		}
@@ -682,6 +759,7 @@ void SV_CheckTimeouts( void )
 		{
 			SV_BroadcastPrintf( PRINT_HIGH, "%s timed out\n", cl->name );
 			SV_DropClient( cl );
+			SV_UnlinkClientAddress( cl );
 			cl->state = cs_free;// don't bother with zombie state
 		}
 	}
@@ -710,8 +788,7 @@ void SV_PrepWorldFrame( void )
 
 void SV_RunGameFrame( void )
 {
-	if ( host_speeds->value )
-		time_before_game = chr::globalApp->GetNumMilliseconds();
+	PROFILE_ZONE( "SV_RunGameFrame" );
 
 	// we always need to bump framenum, even if we
 	// don't run the world, otherwise the delta
@@ -733,9 +810,27 @@ void SV_RunGameFrame( void )
 			svs.realtime = sv.time;
 		}
 	}
+}
+
+/*
+==================
+SV_GetFrameInterval
+
+How long to leave between server frames, in microseconds, or 0 if there's
+no server running
+==================
+*/
+uint64_t SV_GetFrameInterval()
+{
+	if ( !svs.initialized )
+		return 0;
+
+	// timedemos run as fast as they can
+	if ( sv_timedemo->value )
+		return 1;
 
-	if ( host_speeds->value )
-		time_after_game = chr::globalApp->GetNumMilliseconds();
+	float rate = std::clamp( sv_tickrate->value, 10.0f, 1000.0f );
+	return ( uint64_t ) ( 1000000.0f / rate );
 }
 
 /*
@@ -746,7 +841,7 @@ SV_Frame
 */
 void SV_Frame( unsigned int msec )
 {
-	time_before_game = time_after_game = 0;
+	PROFILE_ZONE( "SV_Frame" );
 
 	// if server is not active, do nothing
 	if ( !svs.initialized )
@@ -773,7 +868,6 @@ void SV_Frame( unsigned int msec )
 				Com_Printf( "sv lowclamp\n" );
 			svs.realtime = sv.time - 100;
 		}
-		NET_Sleep( sv.time - svs.realtime );
 		return;
 	}
 
@@ -949,6 +1043,8 @@ void SV_Init( void )
 	sv_paused              = Cvar_Get( "paused", "0", 0 );
 	sv_timedemo            = Cvar_Get( "timedemo", "0", 0 );
 	sv_enforcetime         = Cvar_Get( "sv_enforcetime", "0", 0 );
+	sv_tickrate            = Cvar_Get( "sv_tickrate", "100", 0 );
+	sv_parallelframes      = Cvar_Get( "sv_parallelframes", "1", 0 );
 	allow_download         = Cvar_Get( "allow_download", "1", CVAR_ARCHIVE );
 	allow_download_players = Cvar_Get( "allow_download_players", "0", CVAR_ARCHIVE );
 	allow_download_models  = Cvar_Get( "allow_download_models", "1", CVAR_ARCHIVE );
@@ -1001,6 +1097,9 @@ void SV_FinalMessage( const char *message, bool reconnect )
 	for ( i = 0, cl = svs.clients; i < maxclients->value; i++, cl++ )
 		if ( cl->state >= cs_connected )
 			Netchan_Transmit( &cl->netchan, net_message.cursize, net_message.data );
+
+	// the server may not be around for the next frame to send these
+	NET_FlushPackets( NS_SERVER );
 }
 
 
@@ -1018,6 +1117,7 @@ void SV_Shutdown( const char *finalmsg, bool reconnect )
 		SV_FinalMessage( finalmsg, reconnect );
 
 	Master_Shutdown();
+	NET_FlushPackets( NS_SERVER );
 	SV_ShutdownGameProgs();
 
 	// free current level
@@ -1027,6 +1127,7 @@ void SV_Shutdown( const char *finalmsg, bool reconnect )
 	Com_SetServerState( sv.state );
 
 	// free server static data
+	sv_clientAddresses.clear();
 	if ( svs.clients )
 		Z_Free( svs.clients );
 	if ( svs.client_entities )
@@ -385,23 +385,13 @@ FRAME UPDATES
 
 /*
 =======================
-SV_SendClientDatagram
+SV_TransmitClientDatagram
+
+Sends off a client's frame, along with anything else queued up for them
 =======================
 */
-bool SV_SendClientDatagram( client_t *client )
+static void SV_TransmitClientDatagram( client_t *client, sizebuf_t *msg )
 {
-	byte      msg_buf[ MAX_MSGLEN ];
-	sizebuf_t msg;
-
-	SV_BuildClientFrame( client );
-
-	SZ_Init( &msg, msg_buf, sizeof( msg_buf ) );
-	msg.allowoverflow = true;
-
-	// send over all the relevant entity_state_t
-	// and the player_state_t
-	SV_WriteFrameToClient( client, &msg );
-
 	// copy the accumulated multicast datagram
 	// for this client out to the message
 	// it is necessary for this to be after the WriteEntities
@@ -409,20 +399,42 @@ bool SV_SendClientDatagram( client_t *client )
 	if ( client->datagram.overflowed )
 		Com_Printf( "WARNING: datagram overflowed for %s\n", client->name );
 	else
-		SZ_Write( &msg, client->datagram.data, client->datagram.cursize );
+		SZ_Write( msg, client->datagram.data, client->datagram.cursize );
 	SZ_Clear( &client->datagram );
 
-	if ( msg.overflowed )
+	if ( msg->overflowed )
 	{// must have room left for the packet header
 		Com_Printf( "WARNING: msg overflowed for %s\n", client->name );
-		SZ_Clear( &msg );
+		SZ_Clear( msg );
 	}
 
 	// send the datagram
-	Netchan_Transmit( &client->netchan, msg.cursize, msg.data );
+	Netchan_Transmit( &client->netchan, msg->cursize, msg->data );
 
 	// record the size for rate estimation
-	client->message_size[ sv.framenum % RATE_MESSAGES ] = msg.cursize;
+	client->message_size[ sv.framenum % RATE_MESSAGES ] = msg->cursize;
+}
+
+/*
+=======================
+SV_SendClientDatagram
+=======================
+*/
+bool SV_SendClientDatagram( client_t *client )
+{
+	byte      msg_buf[ MAX_MSGLEN ];
+	sizebuf_t msg;
+
+	SV_BuildClientFrame( client );
+
+	SZ_Init( &msg, msg_buf, sizeof( msg_buf ) );
+	msg.allowoverflow = true;
+
+	// send over all the relevant entity_state_t
+	// and the player_state_t
+	SV_WriteFrameToClient( client, &msg );
+
+	SV_TransmitClientDatagram( client, &msg );
 
 	return true;
 }
@@ -478,6 +490,59 @@ bool SV_RateDrop( client_t *c )
 	return false;
 }
 
+/*
+=======================
+SV_BuildFramesInParallel
+
+Builds the frames for everyone in the game all at once, so long as nobody
+is going to be dropped part way through and change the world for those
+after them. Returns true if the rate drops have been decided along the way.
+=======================
+*/
+static bool SV_BuildFramesInParallel( sizebuf_t **built, bool *rateDropped )
+{
+	client_t *building[ MAX_CLIENTS ];
+	int       surpressCounts[ MAX_CLIENTS ];
+	int       slots[ MAX_CLIENTS ];
+	int       numBuilding = 0;
+	int       i;
+	client_t *c;
+
+	if ( !sv_parallelframes->value || sv.state != ss_game )
+		return false;
+
+	for ( i = 0, c = svs.clients; i < maxclients->value; i++, c++ )
+	{
+		if ( c->state && c->netchan.message.overflowed )
+			return false;
+	}
+
+	// rate drops only touch the client itself, so can be decided up front
+	for ( i = 0, c = svs.clients; i < maxclients->value; i++, c++ )
+	{
+		rateDropped[ i ] = ( c->state == cs_spawned ) && SV_RateDrop( c );
+		if ( c->state != cs_spawned || rateDropped[ i ] )
+			continue;
+
+		surpressCounts[ numBuilding ] = c->surpressCount;
+		slots[ numBuilding ]          = i;
+		building[ numBuilding++ ]     = c;
+	}
+
+	int        firstEntity = svs.next_client_entities;
+	sizebuf_t *messages[ MAX_CLIENTS ];
+	if ( numBuilding == 0 || !SV_BuildClientMessages( building, numBuilding, messages ) )
+		return true;
+
+	if ( sv_parallelframes->value >= 2 )
+		SV_CompareClientMessages( building, numBuilding, messages, surpressCounts, firstEntity );
+
+	for ( i = 0; i < numBuilding; i++ )
+		built[ slots[ i ] ] = messages[ i ];
+
+	return true;
+}
+
 /*
 =======================
 SV_SendClientMessages
@@ -524,6 +589,11 @@ void SV_SendClientMessages( void )
 		}
 	}
 
+	// frames for everyone in the game can be built all at once
+	sizebuf_t *built[ MAX_CLIENTS ] = {};
+	bool       rateDropped[ MAX_CLIENTS ];
+	bool       ratesDecided = SV_BuildFramesInParallel( built, rateDropped );
+
 	// send a message to each connected client
 	for ( i = 0, c = svs.clients; i < maxclients->value; i++, c++ )
 	{
@@ -544,10 +614,13 @@ void SV_SendClientMessages( void )
 		else if ( c->state == cs_spawned )
 		{
 			// don't overrun bandwidth
-			if ( SV_RateDrop( c ) )
+			if ( ratesDecided ? rateDropped[ i ] : SV_RateDrop( c ) )
 				continue;
 
-			SV_SendClientDatagram( c );
+			if ( built[ i ] != nullptr )
+				SV_TransmitClientDatagram( c, built[ i ] );
+			else
+				SV_SendClientDatagram( c );
 		}
 		else
 		{
@@ -24,12 +24,18 @@
 ========================================================================
 */
 
-#include <SDL2/SDL_messagebox.h>
+#if !defined( DEDICATED_ONLY )
+#	include <SDL2/SDL_messagebox.h>
+#endif
 
 #include "qcommon/qcommon.h"
 
 void chr::Sys_MessageBox( const char *error, MessageBoxType boxType )
 {
+#if defined( DEDICATED_ONLY )
+	// there's nobody to click on anything, so it just goes to the terminal
+	fprintf( ( boxType == MessageBoxType::MB_INFO ) ? stdout : stderr, "%s\n", error );
+#else
 	uint32_t flags = 0;
 	switch ( boxType )
 	{
@@ -45,6 +51,7 @@ void chr::Sys_MessageBox( const char *error, MessageBoxType boxType )
 	}
 
 	SDL_ShowSimpleMessageBox( flags, ENGINE_NAME, error, nullptr );
+#endif
 }
 
 void Sys_Error( const char *error, ... )
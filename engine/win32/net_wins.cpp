@@ -726,8 +726,20 @@ void NET_Config( bool multiplayer )
 	}
 }
 
-// sleeps msec or until net socket is ready
-void NET_Sleep( int msec )
+/*
+====================
+NET_FlushPackets
+
+Packets are sent as soon as they're handed over here, so there's never
+anything to flush
+====================
+*/
+void NET_FlushPackets( netsrc_t sock )
+{
+}
+
+// sleeps msec or until net socket is ready, returns false if there was nothing to wait on
+bool NET_Sleep( int msec )
 {
 	struct timeval timeout;
 	fd_set         fdset;
@@ -735,7 +747,7 @@ void NET_Sleep( int msec )
 	int            i;
 
 	if ( !dedicated || !dedicated->value )
-		return;// we're not a server, just run full speed
+		return false;// we're not a server, just run full speed
 
 	FD_ZERO( &fdset );
 	i = 0;
@@ -750,9 +762,12 @@ void NET_Sleep( int msec )
 		if ( ipx_sockets[ NS_SERVER ] > i )
 			i = ipx_sockets[ NS_SERVER ];
 	}
+	if ( i == 0 )
+		return false;
 	timeout.tv_sec  = msec / 1000;
 	timeout.tv_usec = ( msec % 1000 ) * 1000;
 	select( i + 1, &fdset, NULL, NULL, &timeout );
+	return true;
 }
 
 //===================================================================
@@ -21,6 +21,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 #include "../qcommon/qcommon.h"
 #include "winquake.h"
 
+#include <conio.h>
 #include <direct.h>
 #include <io.h>
 
@@ -130,3 +131,48 @@ void Sys_FindClose( void )
 
 
 //============================================
+
+/*
+================
+Sys_ConsoleInput
+
+Returns the next line typed into the console, if there is one
+================
+*/
+char *Sys_ConsoleInput()
+{
+	static char   text[ 256 ];
+	static size_t length;
+
+	if ( !dedicated || dedicated->value <= 0.0f )
+		return nullptr;
+
+	while ( _kbhit() )
+	{
+		int c = _getch();
+		if ( c == '\r' || c == '\n' )
+		{
+			_cputs( "\r\n" );
+
+			text[ length ] = '\0';
+			length         = 0;
+			return text;
+		}
+		else if ( c == '\b' )
+		{
+			if ( length > 0 )
+			{
+				length--;
+				_cputs( "\b \b" );
+			}
+		}
+		else if ( c >= ' ' && length < sizeof( text ) - 1 )
+		{
+			text[ length++ ] = ( char ) c;
+			_putch( c );
+		}
+	}
+
+	return nullptr;
+}
+
@@ -25,19 +25,22 @@
 
 bool chr::game::CinematicScript::ParseFile( const std::string &filename )
 {
-	void *buffer = nullptr;
-	gi.LoadFile( filename.c_str(), &buffer );
+	const void *buffer = nullptr;
+	ssize_t     length = gi.MapFile( filename.c_str(), &buffer );
 	if ( buffer == nullptr )
 	{
 		Com_Printf( "Unable to load cinematic file: %s\n", filename.c_str() );
 		return false;
 	}
 
+	// the stream keeps its own copy, so we can let go of the file straight away
+	std::istringstream streamBuffer( std::string( ( const char * ) buffer, length ) );
+	gi.UnmapFile( buffer );
+
 	bool status = true;
 
-	std::string        line;
-	unsigned int       lineNumber = 0;
-	std::istringstream streamBuffer( ( const char * ) buffer );
+	std::string  line;
+	unsigned int lineNumber = 0;
 	while ( std::getline( streamBuffer, line ) )
 	{
 		lineNumber++;
@@ -149,8 +152,6 @@ bool chr::game::CinematicScript::ParseFile( const std::string &filename )
 	}
 #endif
 
-	gi.FreeFile( buffer );
-
 	return status;
 }
 
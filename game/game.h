@@ -177,6 +177,8 @@ typedef struct
 	// File System
 	ssize_t ( *LoadFile )( const char *path, void **buffer );
 	void ( *FreeFile )( void *buffer );
+	ssize_t ( *MapFile )( const char *path, const void **buffer );
+	void ( *UnmapFile )( const void *buffer );
 } game_import_t;
 
 //
@@ -666,28 +666,6 @@ void Swap_Init( void )
 }
 
 
-/*
-============
-va
-
-does a varargs printf into a temp buffer, so I don't need to have
-varargs versions of all text functions.
-FIXME: make this buffer size safe someday
-============
-*/
-char *va( const char *format, ... )
-{
-	va_list     argptr;
-	static char string[ 1024 ];
-
-	va_start( argptr, format );
-	vsprintf( string, format, argptr );
-	va_end( argptr );
-
-	return string;
-}
-
-
 static char com_token[ MAX_TOKEN_CHARS ];
 
 /*
@@ -293,6 +293,11 @@ void  *Hunk_Alloc( size_t size );
 void   Hunk_Free( void *buf );
 size_t Hunk_End();
 
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+void *Hunk_BeginSite( size_t maxsize, const char *file, int line );
+#	define Hunk_Begin( maxsize ) Hunk_BeginSite( ( maxsize ), __FILE__, __LINE__ )
+#endif
+
 // directory searching
 #define SFF_ARCH   0x01
 #define SFF_HIDDEN 0x02
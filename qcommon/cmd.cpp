@@ -20,6 +20,7 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // cmd.c -- Quake script command processing module
 
 #include "qcommon.h"
+#include "name_table.h"
 
 void Cmd_ForwardToServer (void);
 
@@ -34,6 +35,8 @@ typedef struct cmdalias_s
 
 cmdalias_t	*cmd_alias;
 
+static chr::NameTable< cmdalias_t > cmd_aliastable;	// for finding them by name
+
 bool	cmd_wait;
 
 #define	ALIAS_LOOP_COUNT	16
@@ -117,7 +120,7 @@ void Cbuf_InsertText (const char *text)
 	templen = cmd_text.cursize;
 	if (templen)
 	{
-		temp = static_cast<char*>( Z_Malloc (templen) );
+		temp = static_cast<char*>( Z_ScratchAlloc (templen) );
 		memcpy (temp, cmd_text.data, templen);
 		SZ_Clear (&cmd_text);
 	}
@@ -129,10 +132,7 @@ void Cbuf_InsertText (const char *text)
 	
 // add the copied off data
 	if (templen)
-	{
 		SZ_Write (&cmd_text, temp, templen);
-		Z_Free (temp);
-	}
 }
 
 
@@ -434,8 +434,8 @@ void Cmd_Alias_f (void)
 	if (Cmd_Argc() == 1)
 	{
 		Com_Printf ("Current alias commands:\n");
-		for (a = cmd_alias ; a ; a=a->next)
-			Com_Printf ("%s : %s\n", a->name, a->value);
+		for (cmdalias_t *alias : cmd_aliastable.GetSorted ())
+			Com_Printf ("%s : %s\n", alias->name, alias->value);
 		return;
 	}
 
@@ -447,22 +447,17 @@ void Cmd_Alias_f (void)
 	}
 
 	// if the alias already exists, reuse it
-	for (a = cmd_alias ; a ; a=a->next)
-	{
-		if (!strcmp(s, a->name))
-		{
-			Z_Free (a->value);
-			break;
-		}
-	}
-
-	if (!a)
+	a = cmd_aliastable.Find (s);
+	if (a)
+		Z_Free (a->value);
+	else
 	{
 		a = static_cast<cmdalias_t*>( Z_Malloc (sizeof(cmdalias_t)) );
 		a->next = cmd_alias;
 		cmd_alias = a;
+		strcpy (a->name, s);
+		cmd_aliastable.Insert (a);
 	}
-	strcpy (a->name, s);	
 
 // copy the rest of the command line
 	cmd[0] = 0;		// start out with a null string
@@ -493,9 +488,13 @@ typedef struct cmd_function_s
 	xcommand_t				function;
 } cmd_function_t;
 
+static chr::NameTable< cmd_function_t > cmd_table;	// for finding them by name
+
 
 static	int			cmd_argc;
 static	char		*cmd_argv[MAX_STRING_TOKENS];
+static	char		cmd_tokenized[MAX_STRING_CHARS+MAX_STRING_TOKENS];	// will have 0 bytes inserted
+static	size_t		cmd_tokenizedsize;
 static	const char		*cmd_null_string = "";
 static	char		cmd_args[MAX_STRING_CHARS];
 
@@ -546,7 +545,7 @@ static const char *Cmd_MacroExpandString (const char *text)
 	int		i, j, count, len;
 	bool	inquote;
 	const char	*scan;
-	static	char	expanded[MAX_STRING_CHARS];
+	char	*expanded;
 	char	temporary[MAX_STRING_CHARS];
 	const char	*token, *start;
 
@@ -561,6 +560,7 @@ static const char *Cmd_MacroExpandString (const char *text)
 	}
 
 	count = 0;
+	expanded = NULL;	// only needed once there's something to expand
 
 	for (i=0 ; i<len ; i++)
 	{
@@ -590,6 +590,8 @@ static const char *Cmd_MacroExpandString (const char *text)
 		strcpy (temporary+i, token);
 		strcpy (temporary+i+j, start);
 
+		if (!expanded)
+			expanded = static_cast<char*>( Z_ScratchAlloc (MAX_STRING_CHARS) );
 		strcpy (expanded, temporary);
 		scan = expanded;
 		i--;
@@ -621,14 +623,11 @@ $Cvars will be expanded unless they are in a quoted token
 */
 void Cmd_TokenizeString (const char *text, bool macroExpand)
 {
-	int		i;
 	const char	*com_token;
 
 // clear the args from the last string
-	for (i=0 ; i<cmd_argc ; i++)
-		Z_Free (cmd_argv[i]);
-		
 	cmd_argc = 0;
+	cmd_tokenizedsize = 0;
 	cmd_args[0] = 0;
 	
 	// macro expand the text
@@ -676,8 +675,13 @@ void Cmd_TokenizeString (const char *text, bool macroExpand)
 
 		if (cmd_argc < MAX_STRING_TOKENS)
 		{
-			cmd_argv[cmd_argc] = static_cast<char*>( Z_Malloc (strlen(com_token)+1) );
-			strcpy (cmd_argv[cmd_argc], com_token);
+			size_t l = strlen(com_token) + 1;
+			if (cmd_tokenizedsize + l > sizeof(cmd_tokenized))
+				return;
+
+			cmd_argv[cmd_argc] = cmd_tokenized + cmd_tokenizedsize;
+			memcpy (cmd_argv[cmd_argc], com_token, l);
+			cmd_tokenizedsize += l;
 			cmd_argc++;
 		}
 	}
@@ -702,13 +706,10 @@ void	Cmd_AddCommand (const char *cmd_name, xcommand_t function)
 	}
 	
 // fail if the command already exists
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	if (cmd_table.Find (cmd_name))
 	{
-		if (!strcmp (cmd_name, cmd->name))
-		{
-			Com_Printf ("Cmd_AddCommand: %s already defined\n", cmd_name);
-			return;
-		}
+		Com_Printf ("Cmd_AddCommand: %s already defined\n", cmd_name);
+		return;
 	}
 
 	cmd = static_cast<cmd_function_t *>( Z_Malloc (sizeof(cmd_function_t)) );
@@ -716,6 +717,7 @@ void	Cmd_AddCommand (const char *cmd_name, xcommand_t function)
 	cmd->function = function;
 	cmd->next = cmd_functions;
 	cmd_functions = cmd;
+	cmd_table.Insert (cmd);
 }
 
 /*
@@ -736,9 +738,10 @@ void	Cmd_RemoveCommand (const char *cmd_name)
 			Com_Printf ("Cmd_RemoveCommand: %s not added\n", cmd_name);
 			return;
 		}
-		if (!strcmp (cmd_name, cmd->name))
+		if (!Q_strcasecmp (cmd_name, cmd->name))
 		{
 			*back = cmd->next;
+			cmd_table.Remove (cmd);
 			Z_Free (cmd);
 			return;
 		}
@@ -753,15 +756,7 @@ Cmd_Exists
 */
 bool	Cmd_Exists (char *cmd_name)
 {
-	cmd_function_t	*cmd;
-
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
-	{
-		if (!strcmp (cmd_name,cmd->name))
-			return true;
-	}
-
-	return false;
+	return cmd_table.Find (cmd_name) != NULL;
 }
 
 
@@ -774,29 +769,22 @@ Cmd_CompleteCommand
 const char *Cmd_CompleteCommand (const char *partial)
 {
 	cmd_function_t	*cmd;
-	int				len;
 	cmdalias_t		*a;
 	
-	len = strlen(partial);
-	
-	if (!len)
+	if (!*partial)
 		return NULL;
 		
 // check for exact match
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
-		if (!strcmp (partial,cmd->name))
-			return cmd->name;
-	for (a=cmd_alias ; a ; a=a->next)
-		if (!strcmp (partial, a->name))
-			return a->name;
+	if ((cmd = cmd_table.Find (partial)))
+		return cmd->name;
+	if ((a = cmd_aliastable.Find (partial)))
+		return a->name;
 
 // check for partial match
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
-		if (!strncmp (partial,cmd->name, len))
-			return cmd->name;
-	for (a=cmd_alias ; a ; a=a->next)
-		if (!strncmp (partial, a->name, len))
-			return a->name;
+	if ((cmd = cmd_table.FindPrefix (partial)))
+		return cmd->name;
+	if ((a = cmd_aliastable.FindPrefix (partial)))
+		return a->name;
 
 	return NULL;
 }
@@ -822,33 +810,29 @@ void	Cmd_ExecuteString (const char *text)
 		return;		// no tokens
 
 	// check functions
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next)
+	cmd = cmd_table.Find (cmd_argv[0]);
+	if (cmd)
 	{
-		if (!Q_strcasecmp (cmd_argv[0],cmd->name))
-		{
-			if (!cmd->function)
-			{	// forward to server command
-				Cmd_ExecuteString (va("cmd %s", text));
-			}
-			else
-				cmd->function ();
-			return;
+		if (!cmd->function)
+		{	// forward to server command
+			Cmd_ExecuteString (va("cmd %s", text));
 		}
+		else
+			cmd->function ();
+		return;
 	}
 
 	// check alias
-	for (a=cmd_alias ; a ; a=a->next)
+	a = cmd_aliastable.Find (cmd_argv[0]);
+	if (a)
 	{
-		if (!Q_strcasecmp (cmd_argv[0], a->name))
+		if (++alias_count == ALIAS_LOOP_COUNT)
 		{
-			if (++alias_count == ALIAS_LOOP_COUNT)
-			{
-				Com_Printf ("ALIAS_LOOP_COUNT\n");
-				return;
-			}
-			Cbuf_InsertText (a->value);
+			Com_Printf ("ALIAS_LOOP_COUNT\n");
 			return;
 		}
+		Cbuf_InsertText (a->value);
+		return;
 	}
 	
 	// check cvars
@@ -866,13 +850,9 @@ Cmd_List_f
 */
 void Cmd_List_f (void)
 {
-	cmd_function_t	*cmd;
-	int				i;
-
-	i = 0;
-	for (cmd=cmd_functions ; cmd ; cmd=cmd->next, i++)
+	for (cmd_function_t *cmd : cmd_table.GetSorted ())
 		Com_Printf ("%s\n", cmd->name);
-	Com_Printf ("%i commands\n", i);
+	Com_Printf ("%i commands\n", (int)cmd_table.GetSorted ().size ());
 }
 
 /*
@@ -21,6 +21,10 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 
 #include "qcommon.h"
 
+#include <atomic>
+#include <mutex>
+#include <vector>
+
 typedef struct
 {
 	cplane_t	*plane;
@@ -113,6 +117,7 @@ cvar_t		*map_noareas;
 
 void	CM_InitBoxHull (void);
 void	FloodAreaConnections (void);
+static void	CM_BuildVisCache (void);
 
 
 int		c_pointcontents;
@@ -127,7 +132,7 @@ int		c_traces, c_brush_traces;
 ===============================================================================
 */
 
-byte	*cmod_base;
+const byte	*cmod_base;
 
 /*
 =================
@@ -136,11 +141,11 @@ CMod_LoadSubmodels
 */
 void CMod_LoadSubmodels (lump_t *l)
 {
-	dmodel_t	*in;
+	const dmodel_t	*in;
 	cmodel_t	*out;
 	int			i, j, count;
 
-	in = (dmodel_t *)(cmod_base + l->fileofs);
+	in = (const dmodel_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -174,11 +179,11 @@ CMod_LoadSurfaces
 */
 void CMod_LoadSurfaces (lump_t *l)
 {
-	texinfo_t	*in;
+	const texinfo_t	*in;
 	mapsurface_t	*out;
 	int			i, count;
 
-	in = (texinfo_t *)(cmod_base + l->fileofs);
+	in = (const texinfo_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -208,12 +213,12 @@ CMod_LoadNodes
 */
 void CMod_LoadNodes (lump_t *l)
 {
-	dnode_t		*in;
+	const dnode_t		*in;
 	int			child;
 	cnode_t		*out;
 	int			i, j, count;
 	
-	in = (dnode_t *)(cmod_base + l->fileofs);
+	in = (const dnode_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -247,11 +252,11 @@ CMod_LoadBrushes
 */
 void CMod_LoadBrushes (lump_t *l)
 {
-	dbrush_t	*in;
+	const dbrush_t	*in;
 	cbrush_t	*out;
 	int			i, count;
 	
-	in = (dbrush_t *)(cmod_base + l->fileofs);
+	in = (const dbrush_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -281,10 +286,10 @@ void CMod_LoadLeafs (lump_t *l)
 {
 	int			i;
 	cleaf_t		*out;
-	dleaf_t 	*in;
+	const dleaf_t 	*in;
 	int			count;
 	
-	in = (dleaf_t *)(cmod_base + l->fileofs);
+	in = (const dleaf_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -336,11 +341,11 @@ void CMod_LoadPlanes (lump_t *l)
 {
 	int			i, j;
 	cplane_t	*out;
-	dplane_t 	*in;
+	const dplane_t 	*in;
 	int			count;
 	int			bits;
 	
-	in = (dplane_t *)(cmod_base + l->fileofs);
+	in = (const dplane_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -379,10 +384,10 @@ void CMod_LoadLeafBrushes (lump_t *l)
 {
 	int			i;
 	unsigned short	*out;
-	unsigned short 	*in;
+	const unsigned short 	*in;
 	int			count;
 	
-	in = (unsigned short *)(cmod_base + l->fileofs);
+	in = (const unsigned short *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -409,11 +414,11 @@ void CMod_LoadBrushSides (lump_t *l)
 {
 	int			i, j;
 	cbrushside_t	*out;
-	dbrushside_t 	*in;
+	const dbrushside_t 	*in;
 	int			count;
 	int			num;
 
-	in = (dbrushside_t *)(cmod_base + l->fileofs);
+	in = (const dbrushside_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -445,10 +450,10 @@ void CMod_LoadAreas (lump_t *l)
 {
 	int			i;
 	carea_t		*out;
-	darea_t 	*in;
+	const darea_t 	*in;
 	int			count;
 
-	in = (darea_t *)(cmod_base + l->fileofs);
+	in = (const darea_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -477,10 +482,10 @@ void CMod_LoadAreaPortals (lump_t *l)
 {
 	int			i;
 	dareaportal_t		*out;
-	dareaportal_t 	*in;
+	const dareaportal_t 	*in;
 	int			count;
 
-	in = (dareaportal_t *)(cmod_base + l->fileofs);
+	in = (const dareaportal_t *)(cmod_base + l->fileofs);
 	if (l->filelen % sizeof(*in))
 		Com_Error (ERR_DROP, "MOD_LoadBmodel: funny lump size");
 	count = l->filelen / sizeof(*in);
@@ -547,9 +552,9 @@ Loads in the map and all submodels
 */
 cmodel_t *CM_LoadMap ( const char *name, bool clientload, uint32_t *checksum)
 {
-	unsigned		*buf;
+	const void		*buf;
 	dheader_t		header;
-	int				length;
+	ssize_t			length;
 	static uint32_t	last_checksum;
 
 	map_noareas = Cvar_Get ("map_noareas", "0", 0);
@@ -581,20 +586,21 @@ cmodel_t *CM_LoadMap ( const char *name, bool clientload, uint32_t *checksum)
 		numclusters = 1;
 		numareas = 1;
 		*checksum = 0;
+		CM_BuildVisCache ();
 		return &map_cmodels[0];			// cinematic servers won't have anything at all
 	}
 
 	//
 	// load the file
 	//
-	length = FS_LoadFile (name, (void **)&buf);
+	length = FS_MapFile (name, &buf);
 	if (!buf)
 		Com_Error (ERR_DROP, "Couldn't load %s", name);
 
 	last_checksum = ( uint32_t ) LittleLong( ( int32_t ) Com_BlockChecksum( buf, length ) );
 	*checksum = last_checksum;
 
-	header = *(dheader_t *)buf;
+	header = *(const dheader_t *)buf;
 	for (unsigned int i=0 ; i<sizeof(dheader_t)/4 ; i++)
 		((int *)&header)[i] = LittleLong ( ((int *)&header)[i]);
 
@@ -602,7 +608,7 @@ cmodel_t *CM_LoadMap ( const char *name, bool clientload, uint32_t *checksum)
 		Com_Error (ERR_DROP, "CMod_LoadBrushModel: %s has wrong version number (%i should be %i)"
 		, name, header.version, BSPVERSION);
 
-	cmod_base = (byte *)buf;
+	cmod_base = (const byte *)buf;
 
 	// load into heap
 	CMod_LoadSurfaces (&header.lumps[LUMP_TEXINFO]);
@@ -618,13 +624,15 @@ cmodel_t *CM_LoadMap ( const char *name, bool clientload, uint32_t *checksum)
 	CMod_LoadVisibility (&header.lumps[LUMP_VISIBILITY]);
 	CMod_LoadEntityString (&header.lumps[LUMP_ENTITIES]);
 
-	FS_FreeFile (buf);
+	FS_UnmapFile (buf);
 
 	CM_InitBoxHull ();
 
 	memset (portalopen, 0, sizeof(portalopen));
 	FloodAreaConnections ();
 
+	CM_BuildVisCache ();
+
 	strcpy (map_name, name);
 
 	return &map_cmodels[0];
@@ -838,10 +846,11 @@ CM_BoxLeafnums
 Fills in a list of all the leafs touched
 =============
 */
-int		leaf_count, leaf_maxcount;
-int		*leaf_list;
-float	*leaf_mins, *leaf_maxs;
-int		leaf_topnode;
+// per thread, so the server can work out what clients can see in parallel
+static thread_local int		leaf_count, leaf_maxcount;
+static thread_local int		*leaf_list;
+static thread_local float	*leaf_mins, *leaf_maxs;
+static thread_local int		leaf_topnode;
 
 void CM_BoxLeafnums_r (int nodenum)
 {
@@ -1350,6 +1359,8 @@ trace_t		CM_BoxTrace (vec3_t start, vec3_t end,
 						  vec3_t mins, vec3_t maxs,
 						  int headnode, int brushmask)
 {
+	PROFILE_ZONE ("CM_BoxTrace");
+
 	checkcount++;		// for multi-check avoidance
 
 	c_traces++;			// for statistics, may be zeroed
@@ -1565,25 +1576,299 @@ void CM_DecompressVis (byte *in, byte *out)
 	} while (out_p - out < row);
 }
 
-byte	pvsrow[MAX_MAP_LEAFS/8];
-byte	phsrow[MAX_MAP_LEAFS/8];
+/*
+===============================================================================
 
-byte	*CM_ClusterPVS (int cluster)
+DECOMPRESSED VIS CACHE
+
+Rows are decompressed once and kept around, padded out to whole 64 bit
+words so they can be merged and tested a word at a time. If every row
+fits within map_viscache they're all built when the map is loaded, and
+can be read from any thread without locking. Otherwise as many as fit
+are kept, with the least recently used ones making way for new ones.
+
+===============================================================================
+*/
+
+#define	VIS_MIN_SLOTS	64	// if fewer than this would fit, don't bother
+
+static int						visrowwords;	// 64 bit words per row
+static bool						visallcached;	// every row is built, so no locking is needed
+static std::vector<uint64_t>	visrows;		// visrowwords per slot
+static std::vector<int>			visslot;		// per row (cluster * 2 + DVIS_PVS or DVIS_PHS), the slot holding it or -1
+static std::vector<int>			visslotrow;		// per slot, the row it holds or -1
+static std::vector<int>			visprev, visnext;	// per slot, least recently used order
+static int						vishead, vistail;	// most and least recently used
+static std::mutex				vislock;		// only when not everything is cached
+
+static std::atomic<uint64_t>	vishits, vismisses;
+
+static cvar_t	*map_viscache;
+
+static uint64_t	pvsrow[MAX_MAP_LEAFS/64];
+static uint64_t	phsrow[MAX_MAP_LEAFS/64];
+
+/*
+===================
+CM_DecompressRow
+
+Fills in a whole row, padding and all
+===================
+*/
+static void CM_DecompressRow (int row, uint64_t *out)
 {
-	if (cluster == -1)
-		memset (pvsrow, 0, (numclusters+7)>>3);
+	int		cluster = row >> 1;
+
+	memset (out, 0, visrowwords * sizeof(uint64_t));
+	CM_DecompressVis (map_visibility + map_vis->bitofs[cluster][row & 1], (byte *)out);
+}
+
+static void CM_UnlinkSlot (int slot)
+{
+	if (visprev[slot] != -1)
+		visnext[visprev[slot]] = visnext[slot];
+	else
+		vishead = visnext[slot];
+	if (visnext[slot] != -1)
+		visprev[visnext[slot]] = visprev[slot];
 	else
-		CM_DecompressVis (map_visibility + map_vis->bitofs[cluster][DVIS_PVS], pvsrow);
-	return pvsrow;
+		vistail = visprev[slot];
 }
 
-byte	*CM_ClusterPHS (int cluster)
+static void CM_LinkSlot (int slot)
+{
+	visprev[slot] = -1;
+	visnext[slot] = vishead;
+	if (vishead != -1)
+		visprev[vishead] = slot;
+	else
+		vistail = slot;
+	vishead = slot;
+}
+
+/*
+===================
+CM_BuildVisCache
+
+Called once the map's vis has been loaded
+===================
+*/
+static void CM_BuildVisCache (void)
+{
+	size_t	rowbytes, numrows, numslots, cap;
+
+	visrows.clear ();
+	visrows.shrink_to_fit ();	// don't hang on to a big map's rows
+	visslot.clear ();
+	visslotrow.clear ();
+	visprev.clear ();
+	visnext.clear ();
+	vishead = vistail = -1;
+	visallcached = false;
+	visrowwords = (numclusters+63)>>6;
+
+	if (!map_viscache)
+		map_viscache = Cvar_Get ("map_viscache", "32", 0);
+
+	if (map_viscache->value <= 0)
+		return;
+
+	rowbytes = visrowwords * sizeof(uint64_t);
+	numrows = numclusters * 2;
+	cap = (size_t)(map_viscache->value * 1024 * 1024);
+
+	numslots = std::min (numrows, cap / rowbytes);
+	if (numslots < numrows && numslots < VIS_MIN_SLOTS)
+	{
+		Com_DPrintf ("map_viscache is too small to hold any vis for this map\n");
+		return;
+	}
+
+	visrows.resize (numslots * visrowwords);
+	visslot.assign (numrows, -1);
+	visslotrow.assign (numslots, -1);
+
+	if (numslots == numrows)
+	{
+		for (size_t row=0 ; row<numrows ; row++)
+		{
+			CM_DecompressRow ((int)row, &visrows[row * visrowwords]);
+			visslot[row] = (int)row;
+			visslotrow[row] = (int)row;
+		}
+		visallcached = true;
+		return;
+	}
+
+	visprev.resize (numslots);
+	visnext.resize (numslots);
+	for (size_t slot=0 ; slot<numslots ; slot++)
+		CM_LinkSlot ((int)slot);
+}
+
+/*
+===================
+CM_CachedRow
+
+Returns the row, decompressing it into the least recently used slot if
+it isn't there already. Unless everything's cached, vislock needs to be
+held for as long as the row is used.
+===================
+*/
+static const uint64_t *CM_CachedRow (int row)
+{
+	int		slot;
+
+	slot = visslot[row];
+	if (slot != -1)
+	{
+		vishits.fetch_add (1, std::memory_order_relaxed);
+		if (!visallcached && slot != vishead)
+		{
+			CM_UnlinkSlot (slot);
+			CM_LinkSlot (slot);
+		}
+		return &visrows[slot * visrowwords];
+	}
+
+	vismisses.fetch_add (1, std::memory_order_relaxed);
+
+	// take over the least recently used slot
+	slot = vistail;
+	if (visslotrow[slot] != -1)
+		visslot[visslotrow[slot]] = -1;
+	visslotrow[slot] = row;
+	visslot[row] = slot;
+
+	CM_UnlinkSlot (slot);
+	CM_LinkSlot (slot);
+
+	CM_DecompressRow (row, &visrows[slot * visrowwords]);
+	return &visrows[slot * visrowwords];
+}
+
+static void CM_CopyRow (const uint64_t *in, uint64_t *out, bool merge)
 {
+	int		i;
+
+	if (!merge)
+	{
+		memcpy (out, in, visrowwords * sizeof(uint64_t));
+		return;
+	}
+
+	for (i=0 ; i<visrowwords ; i++)
+		out[i] |= in[i];
+}
+
+/*
+===================
+CM_ReadRow
+
+Copies out a row, or merges it into what's already there
+===================
+*/
+static void CM_ReadRow (int cluster, int type, uint64_t *out, bool merge)
+{
+	uint64_t	row[MAX_MAP_LEAFS/64];
+
 	if (cluster == -1)
-		memset (phsrow, 0, (numclusters+7)>>3);
+	{
+		if (!merge)
+			memset (out, 0, visrowwords * sizeof(uint64_t));
+		return;
+	}
+
+	if (visallcached)
+	{
+		CM_CopyRow (CM_CachedRow (cluster * 2 + type), out, merge);
+		return;
+	}
+
+	if (!visslot.empty ())
+	{
+		std::lock_guard<std::mutex>	lock (vislock);
+		CM_CopyRow (CM_CachedRow (cluster * 2 + type), out, merge);
+		return;
+	}
+
+	// not caching anything
+	vismisses.fetch_add (1, std::memory_order_relaxed);
+	CM_DecompressRow (cluster * 2 + type, row);
+	CM_CopyRow (row, out, merge);
+}
+
+int		CM_ClusterRowWords (void)
+{
+	return visrowwords;
+}
+
+void	CM_DecompressClusterPVS (int cluster, uint64_t *out)
+{
+	CM_ReadRow (cluster, DVIS_PVS, out, false);
+}
+
+void	CM_DecompressClusterPHS (int cluster, uint64_t *out)
+{
+	CM_ReadRow (cluster, DVIS_PHS, out, false);
+}
+
+void	CM_MergeClusterPVS (int cluster, uint64_t *out)
+{
+	CM_ReadRow (cluster, DVIS_PVS, out, true);
+}
+
+byte	*CM_ClusterPVS (int cluster)
+{
+	// rows can be handed out directly while they're all there to stay
+	if (visallcached && cluster != -1)
+		return (byte *)CM_CachedRow (cluster * 2 + DVIS_PVS);
+
+	CM_DecompressClusterPVS (cluster, pvsrow);
+	return (byte *)pvsrow;
+}
+
+byte	*CM_ClusterPHS (int cluster)
+{
+	if (visallcached && cluster != -1)
+		return (byte *)CM_CachedRow (cluster * 2 + DVIS_PHS);
+
+	CM_DecompressClusterPHS (cluster, phsrow);
+	return (byte *)phsrow;
+}
+
+/*
+===================
+CM_VisStats_f
+===================
+*/
+void CM_VisStats_f (void)
+{
+	uint64_t	hits, misses;
+	size_t		numslots;
+
+	if (Cmd_Argc () > 1 && !strcmp (Cmd_Argv (1), "clear"))
+	{
+		vishits = 0;
+		vismisses = 0;
+		return;
+	}
+
+	numslots = visslotrow.size ();
+	if (visallcached)
+		Com_Printf ("all %i vis rows cached", numclusters * 2);
+	else if (numslots)
+		Com_Printf ("%zu of %i vis rows cached", numslots, numclusters * 2);
 	else
-		CM_DecompressVis (map_visibility + map_vis->bitofs[cluster][DVIS_PHS], phsrow);
-	return phsrow;
+		Com_Printf ("vis isn't cached");
+	Com_Printf (", %.2fKB\n", (visrows.size () * sizeof(uint64_t)
+		+ (visslot.size () + visslotrow.size () + visprev.size () + visnext.size ()) * sizeof(int)) / 1024.0);
+
+	hits = vishits;
+	misses = vismisses;
+	Com_Printf ("%llu rows read from the cache, %llu decompressed (%.1f%% hit rate)\n",
+		(unsigned long long)hits, (unsigned long long)misses,
+		(hits + misses) ? hits * 100.0 / (hits + misses) : 0.0);
 }
 
 
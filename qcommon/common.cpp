@@ -19,7 +19,11 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 */
 // common.c -- misc functions used in client and server
 
+#include <algorithm>
+#include <chrono>
 #include <csetjmp>
+#include <mutex>
+#include <thread>
 
 #include "qcommon.h"
 #include "app.h"
@@ -48,11 +52,13 @@ static FILE *logfile;
 
 static int server_state;
 
-// host_speeds times
-unsigned int time_before_game;
-unsigned int time_after_game;
-unsigned int time_before_ref;
-unsigned int time_after_ref;
+// anything printed off the main thread is held here for the console until the next frame
+static const std::thread::id com_mainThread = std::this_thread::get_id();
+static std::mutex            com_deferredMutex;
+static std::string           com_deferredPrint;
+
+// where other threads' prints should be logged, as they can't check the cvars themselves
+static std::atomic< unsigned int > com_logFlags{ LOG_STDOUT };
 
 /*
 ============================================================================
@@ -95,29 +101,38 @@ to the apropriate place.
 =============
 */
 void Com_Printf( const char *fmt, ... ) {
+	// the message is done with by the time this returns, so it's handed straight back
+	size_t mark = Z_ScratchMark();
+
 	va_list argptr;
 	va_start( argptr, fmt );
-	int len = Q_vscprintf( fmt, argptr ) + 1;
-	char *msg = static_cast<char *>( Z_Malloc( len ) );
-	vsprintf( msg, fmt, argptr );
+	char *msg = Z_ScratchVPrintf( fmt, argptr );
 	va_end( argptr );
 
+	// the console and redirects aren't thread-safe, so workers have to wait their turn
+	if( std::this_thread::get_id() != com_mainThread ) {
+		Log_Print( msg, com_logFlags.load( std::memory_order_relaxed ) );
+
+		std::lock_guard< std::mutex > lock( com_deferredMutex );
+		com_deferredPrint += msg;
+		Z_ScratchRewind( mark );
+		return;
+	}
+
 	if( rd_target ) {
 		if( ( strlen( msg ) + strlen( rd_buffer ) ) > ( rd_buffersize - 1 ) ) {
 			rd_flush( rd_target, rd_buffer );
 			*rd_buffer = 0;
 		}
 		strcat( rd_buffer, msg );
-		Z_Free( msg );
+		Z_ScratchRewind( mark );
 		return;
 	}
 
 	Con_Print( msg );
 
-	// also echo to debugging console
-	chr::globalApp->PushConsoleOutput( msg );
-
-	// logfile
+	// also echo to debugging console, and the logfile, on another thread
+	unsigned int flags = LOG_STDOUT;
 	if( logfile_active && logfile_active->value ) {
 		char name[ MAX_QPATH ];
 
@@ -127,13 +142,54 @@ void Com_Printf( const char *fmt, ... ) {
 				logfile = fopen( name, "a" );
 			else
 				logfile = fopen( name, "w" );
+			Log_SetFile( logfile );
 		}
-		if( logfile ) fprintf( logfile, "%s", msg );
+		flags |= LOG_FILE;
 		if( logfile_active->value > 1 )
-			fflush( logfile );  // force it to save every time
+			flags |= LOG_FLUSH;  // force it to save every time
+	}
+	com_logFlags.store( flags, std::memory_order_relaxed );
+
+	Log_Print( msg, flags );
+
+	Z_ScratchRewind( mark );
+}
+
+/*
+=============
+Com_CloseLogFile
+
+Makes sure everything's been written out before closing the logfile
+=============
+*/
+static void Com_CloseLogFile() {
+	Log_Flush();
+
+	if( logfile ) {
+		Log_SetFile( nullptr );
+		fclose( logfile );
+		logfile = nullptr;
+	}
+}
+
+/*
+=============
+Com_FlushDeferredPrints
+
+Puts anything that was printed from another thread since the
+last time this was called into the console. It's already
+been logged.
+=============
+*/
+static void Com_FlushDeferredPrints() {
+	std::string msg;
+	{
+		std::lock_guard< std::mutex > lock( com_deferredMutex );
+		if( com_deferredPrint.empty() ) return;
+		msg.swap( com_deferredPrint );
 	}
 
-	Z_Free( msg );
+	Con_Print( msg.data() );
 }
 
 /*
@@ -147,16 +203,34 @@ void Com_DPrintf( const char *fmt, ... ) {
 	if( !developer || !developer->value )
 		return;  // don't confuse non-developers with techie stuff...
 
+	size_t mark = Z_ScratchMark();
+
 	va_list argptr;
 	va_start( argptr, fmt );
-	int len = Q_vscprintf( fmt, argptr ) + 1;
-	char *msg = static_cast<char *>( Z_Malloc( len ) );
-	vsprintf( msg, fmt, argptr );
+	char *msg = Z_ScratchVPrintf( fmt, argptr );
 	va_end( argptr );
 
 	Com_Printf( "%s", msg );
 
-	Z_Free( msg );
+	Z_ScratchRewind( mark );
+}
+
+/*
+============
+va
+
+does a varargs printf into a temp buffer, so I don't need to have
+varargs versions of all text functions. The buffer's good until the
+end of the frame.
+============
+*/
+char *va( const char *format, ... ) {
+	va_list argptr;
+	va_start( argptr, format );
+	char *string = Z_ScratchVPrintf( format, argptr );
+	va_end( argptr );
+
+	return string;
 }
 
 /*
@@ -172,18 +246,20 @@ void Com_Error( int code, const char *fmt, ... )
 #if !defined( NDEBUG )
 	// Let us catch fails as soon as we reach here
 	if ( code == ERR_FATAL )
+	{
+		Log_Flush();
 		abort();
+	}
 #endif
 
 	static bool recursive = false;
 	if ( recursive ) Sys_Error( "Recursive error!" );
 	recursive = true;
 
+	// scratch, so there's nothing to clean up on the way out via longjmp
 	va_list argptr;
 	va_start( argptr, fmt );
-	int   len = Q_vscprintf( fmt, argptr ) + 1;
-	char *msg = static_cast< char * >( Z_Malloc( len ) );
-	vsprintf( msg, fmt, argptr );
+	char *msg = Z_ScratchVPrintf( fmt, argptr );
 	va_end( argptr );
 
 	if ( code == ERR_DISCONNECT )
@@ -197,6 +273,7 @@ void Com_Error( int code, const char *fmt, ... )
 		Com_Printf( "********************\nERROR: %s\n********************\n", msg );
 		SV_Shutdown( va( "Server crashed: %s\n", msg ), false );
 		CL_Drop();
+		Log_Flush();
 		recursive = false;
 		longjmp( abortframe, -1 );
 	}
@@ -206,15 +283,9 @@ void Com_Error( int code, const char *fmt, ... )
 		CL_Shutdown();
 	}
 
-	if ( logfile )
-	{
-		fclose( logfile );
-		logfile = nullptr;
-	}
+	Com_CloseLogFile();
 
 	Sys_Error( "%s", msg );
-
-	Z_Free( msg );
 }
 
 /*
@@ -229,10 +300,7 @@ void Com_Quit( void ) {
 	SV_Shutdown( "Server quit\n", false );
 	CL_Shutdown();
 
-	if( logfile ) {
-		fclose( logfile );
-		logfile = NULL;
-	}
+	Com_CloseLogFile();
 
 	Sys_Quit();
 }
@@ -913,101 +981,6 @@ void Info_Print( char *s ) {
 	}
 }
 
-/*
-==============================================================================
-
-												ZONE MEMORY ALLOCATION
-
-just cleared malloc with counters now...
-
-==============================================================================
-*/
-
-/**
- * Allocates; aborts on fail.
- * Memory allocated is zeroed.
- */
-void *M_Alloc( size_t size )
-{
-	void *data = calloc( size, 1 );
-	if ( data == nullptr )
-		Com_Error( ERR_FATAL, "Failed to allocate %u bytes!\n", size );
-
-	return data;
-}
-
-void M_Free( void *ptr )
-{
-	free( ptr );
-}
-
-#define Z_MAGIC 0x1d1d
-
-typedef struct zhead_s {
-	struct zhead_s *prev, *next;
-	short magic;
-	short tag;  // for group free
-	size_t size;
-} zhead_t;
-
-static zhead_t z_chain;
-static int z_count;
-static size_t z_bytes;
-
-void Z_Free( void *ptr )
-{
-	zhead_t *z = ( ( zhead_t * ) ptr ) - 1;
-
-	if ( z->magic != Z_MAGIC ) Com_Error( ERR_FATAL, "Z_Free: bad magic" );
-
-	z->prev->next = z->next;
-	z->next->prev = z->prev;
-
-	z_count--;
-	z_bytes -= z->size;
-	M_Free( z );
-}
-
-void Z_Stats_f()
-{
-	Com_Printf( "%u bytes in %u blocks\n", z_bytes, z_count );
-}
-
-void Z_FreeTags( int tag )
-{
-	zhead_t *z, *next;
-	for ( z = z_chain.next; z != &z_chain; z = next )
-	{
-		next = z->next;
-		if ( z->tag == tag ) Z_Free( ( void * ) ( z + 1 ) );
-	}
-}
-
-void *Z_TagMalloc( size_t size, int16_t tag )
-{
-	zhead_t *z;
-
-	size += sizeof( zhead_t );
-	z = ( zhead_t * ) M_Alloc( size );
-	if ( !z )
-		Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %i bytes", size );
-
-	z_count++;
-	z_bytes += size;
-	z->magic = Z_MAGIC;
-	z->tag = tag;
-	z->size = size;
-
-	z->next = z_chain.next;
-	z->prev = &z_chain;
-	z_chain.next->prev = z;
-	z_chain.next = z;
-
-	return ( void * ) ( z + 1 );
-}
-
-void *Z_Malloc( size_t size ) { return Z_TagMalloc( size, 0 ); }
-
 //============================================================================
 
 static byte chktbl[ 1024 ] = {
@@ -1136,6 +1109,7 @@ float crand() { return ( float ) ( ( rand() & 32767 ) * ( 2.0 / 32767 ) - 1 ); }
 
 void Key_Init( void );
 void SCR_EndLoadingPlaque( void );
+static void Com_FrameStats_f();
 
 /*
 =============
@@ -1152,7 +1126,7 @@ void Qcommon_Init( int argc, char **argv ) {
 
 	if( setjmp( abortframe ) ) Sys_Error( "Error during initialization" );
 
-	z_chain.next = z_chain.prev = &z_chain;
+	Log_Init();
 
 	// prepare enough of the subsystems to handle
 	// cvar and command buffer management
@@ -1173,6 +1147,7 @@ void Qcommon_Init( int argc, char **argv ) {
 	Cbuf_AddEarlyCommands( false );
 	Cbuf_Execute();
 
+	Job_Init();
 	FS_InitFilesystem();
 
 	Cbuf_AddText( "exec default.cfg\n" );
@@ -1185,7 +1160,13 @@ void Qcommon_Init( int argc, char **argv ) {
 	// init commands and vars
 	//
 	Cmd_AddCommand( "z_stats", Z_Stats_f );
+	Cmd_AddCommand( "mem_report", Z_Report_f );
+	Cmd_AddCommand( "hunk_stats", Hunk_Stats_f );
+	Cmd_AddCommand( "job_stats", Job_Stats_f );
+	Cmd_AddCommand( "map_visstats", CM_VisStats_f );
 	Cmd_AddCommand( "error", Com_Error_f );
+	Cmd_AddCommand( "com_framestats", Com_FrameStats_f );
+	Prof_Init();
 
 	host_speeds = Cvar_Get( "host_speeds", "0", 0 );
 	log_stats = Cvar_Get( "log_stats", "0", 0 );
@@ -1227,10 +1208,249 @@ void Qcommon_Init( int argc, char **argv ) {
 	Com_Printf( "====== " ENGINE_NAME " Initialized ======\n\n" );
 }
 
-void Qcommon_Frame( unsigned int msec )
+/*
+============================================================================
+
+FRAME PACING
+
+The server and client each run at their own rate (sv_tickrate and
+cl_maxfps), and only get called once they're due. In between, the main
+loop sleeps for as long as it can trust the OS to wake it back up on time,
+and only spins for whatever's left before a frame that's actually due.
+Dedicated servers wait on the network instead, so packets are still picked
+up as soon as they arrive, and never spin.
+
+============================================================================
+*/
+
+static constexpr uint64_t     COM_IDLE_INTERVAL = 10000;// with nothing running, commands are still checked this often
+static constexpr uint64_t     COM_MIN_SPIN      = 100;
+static constexpr uint64_t     COM_MAX_SPIN      = 2000;
+static constexpr unsigned int COM_FRAME_HISTORY = 256;
+
+struct FrameClock
+{
+	const char  *name;
+	uint64_t     interval; // in microseconds, 0 if it's not running
+	uint64_t     next;     // when it's next due
+	uint64_t     last;     // when it was last called
+	uint64_t     lastDue;  // when it last ran because it was due
+	uint64_t     remainder;// not yet handed over as a whole millisecond
+	uint64_t     history[ COM_FRAME_HISTORY ];// time between each frame
+	unsigned int numFrames;
+	unsigned int numLate;  // ran more than half an interval after they were due
+	uint64_t     lateness; // total time spent overdue
+};
+
+static FrameClock com_serverClock = { "Server" };
+static FrameClock com_clientClock = { "Client" };
+
+static uint64_t com_spinMargin = 1000;// stop sleeping this long before a deadline, adapting to how late the OS wakes us
+static uint64_t com_timeSlept;
+static uint64_t com_timeSpun;
+
+static uint64_t Com_GetMicroseconds()
+{
+	return std::chrono::duration_cast< std::chrono::microseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
+
+static void Com_SetClockInterval( FrameClock &clock, uint64_t interval, uint64_t now )
+{
+	if ( interval == clock.interval )
+		return;
+
+	if ( clock.interval == 0 )
+	{
+		// starting up, so there's nothing to catch up on
+		clock.next = clock.last = clock.lastDue = now;
+		clock.remainder                         = 0;
+	}
+	else if ( interval != 0 )
+		clock.next = clock.lastDue + interval;
+
+	clock.interval = interval;
+}
+
+static bool Com_IsClockDue( const FrameClock &clock, uint64_t now )
+{
+	return clock.interval > 0 && now >= clock.next;
+}
+
+/**
+ * Returns how many whole milliseconds have passed since the clock was last
+ * called, carrying over the rest so nothing's lost to rounding.
+ */
+static unsigned int Com_AdvanceClock( FrameClock &clock, uint64_t now )
+{
+	if ( Com_IsClockDue( clock, now ) )
+	{
+		if ( now - clock.next > clock.interval / 2 )
+		{
+			clock.numLate++;
+			clock.lateness += now - clock.next;
+		}
+
+		clock.history[ clock.numFrames++ % COM_FRAME_HISTORY ] = now - clock.lastDue;
+		clock.lastDue                                          = now;
+
+		// if it's fallen a whole frame behind, don't try to make it up
+		clock.next += clock.interval;
+		if ( clock.next <= now )
+			clock.next = now + clock.interval;
+	}
+
+	uint64_t elapsed = now - clock.last + clock.remainder;
+	clock.last       = now;
+	clock.remainder  = elapsed % 1000;
+
+	unsigned int msec = ( unsigned int ) ( elapsed / 1000 );
+	if ( fixedtime->value >= 1.0f )
+		msec = fixedtime->value;
+	else if ( timescale->value >= 1.0f )
+	{
+		msec *= timescale->value;
+		if ( msec < 1 ) msec = 1;
+	}
+
+	return msec;
+}
+
+/*
+================
+Qcommon_WaitForFrame
+
+Blocks until the server or client are next due
+================
+*/
+void Qcommon_WaitForFrame()
+{
+	uint64_t now = Com_GetMicroseconds();
+	Com_SetClockInterval( com_serverClock, SV_GetFrameInterval(), now );
+	Com_SetClockInterval( com_clientClock, CL_GetFrameInterval(), now );
+
+	// only a frame that's due is worth spinning for, never the idle check
+	uint64_t deadline = now + COM_IDLE_INTERVAL;
+	bool     canSpin  = false;
+	for ( const FrameClock *clock : { &com_serverClock, &com_clientClock } )
+	{
+		if ( clock->interval > 0 && clock->next <= deadline )
+		{
+			deadline = clock->next;
+			canSpin  = true;
+		}
+	}
+
+	if ( dedicated->value )
+	{
+		// a packet showing up cuts this short, at which point the server's run regardless;
+		// otherwise round up, as waking a little late beats running early and spinning out the rest
+		if ( deadline > now )
+		{
+			uint64_t request = deadline - now;
+			if ( !NET_Sleep( ( int ) ( ( request + 999 ) / 1000 ) ) )
+				std::this_thread::sleep_for( std::chrono::microseconds( request ) );
+
+			com_timeSlept += Com_GetMicroseconds() - now;
+		}
+
+		return;
+	}
+
+	while ( now < deadline )
+	{
+		uint64_t remaining = deadline - now;
+		if ( !canSpin )
+		{
+			std::this_thread::sleep_for( std::chrono::microseconds( remaining ) );
+
+			com_timeSlept += Com_GetMicroseconds() - now;
+			return;
+		}
+
+		if ( remaining > com_spinMargin )
+		{
+			uint64_t request = remaining - com_spinMargin;
+			std::this_thread::sleep_for( std::chrono::microseconds( request ) );
+
+			uint64_t woke = Com_GetMicroseconds();
+			com_timeSlept += woke - now;
+
+			// keep the margin at around twice how late we tend to be woken
+			uint64_t overslept = ( woke - now > request ) ? ( woke - now - request ) : 0;
+			com_spinMargin     = std::clamp( ( com_spinMargin * 7 + overslept * 2 ) / 8, COM_MIN_SPIN, COM_MAX_SPIN );
+
+			now = woke;
+		}
+		else
+		{
+			std::this_thread::yield();
+
+			uint64_t spun = Com_GetMicroseconds();
+			com_timeSpun += spun - now;
+			now = spun;
+		}
+	}
+}
+
+static void Com_PrintClockStats( const FrameClock &clock )
+{
+	if ( clock.interval == 0 )
+	{
+		Com_Printf( "%s: not running\n", clock.name );
+		return;
+	}
+
+	unsigned int numSamples = std::min( clock.numFrames, COM_FRAME_HISTORY );
+	if ( numSamples == 0 )
+	{
+		Com_Printf( "%s: no frames yet\n", clock.name );
+		return;
+	}
+
+	uint64_t samples[ COM_FRAME_HISTORY ];
+	std::copy( clock.history, clock.history + numSamples, samples );
+	std::sort( samples, samples + numSamples );
+
+	double mean = 0.0;
+	for ( unsigned int i = 0; i < numSamples; ++i )
+		mean += samples[ i ];
+	mean /= numSamples;
+
+	double variance = 0.0;
+	for ( unsigned int i = 0; i < numSamples; ++i )
+		variance += ( samples[ i ] - mean ) * ( samples[ i ] - mean );
+	variance /= numSamples;
+
+	Com_Printf( "%s: targeting %.2fms (%.1fHz), over the last %u frames:\n", clock.name, clock.interval / 1000.0, 1000000.0 / clock.interval, numSamples );
+	Com_Printf( "  mean %.3fms, jitter %.3fms, min %.3fms, max %.3fms, 99th %.3fms\n",
+	            mean / 1000.0, sqrt( variance ) / 1000.0, samples[ 0 ] / 1000.0, samples[ numSamples - 1 ] / 1000.0, samples[ ( numSamples * 99 ) / 100 ] / 1000.0 );
+	Com_Printf( "  %u of %u frames late, by %.3fms on average\n",
+	            clock.numLate, clock.numFrames, clock.numLate ? ( clock.lateness / 1000.0 ) / clock.numLate : 0.0 );
+}
+
+/*
+================
+Com_FrameStats_f
+
+Reports how closely the server and client are keeping to their rates
+================
+*/
+static void Com_FrameStats_f()
+{
+	Com_PrintClockStats( com_serverClock );
+	Com_PrintClockStats( com_clientClock );
+
+	uint64_t waited = com_timeSlept + com_timeSpun;
+	Com_Printf( "Waiting: %.1f%% asleep, %.1f%% spinning, spinning for the last %.3fms\n",
+	            waited ? ( 100.0 * com_timeSlept ) / waited : 0.0, waited ? ( 100.0 * com_timeSpun ) / waited : 0.0, com_spinMargin / 1000.0 );
+}
+
+void Qcommon_Frame()
 {
 	if ( setjmp( abortframe ) ) return;// an ERR_DROP was thrown
 
+	Z_BeginFrame();
+
 	if ( log_stats->modified )
 	{
 		log_stats->modified = false;
@@ -1255,13 +1475,17 @@ void Qcommon_Frame( unsigned int msec )
 		}
 	}
 
-	if ( fixedtime->value >= 1.0f )
-		msec = fixedtime->value;
-	else if ( timescale->value >= 1.0f )
-	{
-		msec *= timescale->value;
-		if ( msec < 1 ) msec = 1;
-	}
+	// dedicated servers also run whenever they're woken by a packet
+	uint64_t now         = Com_GetMicroseconds();
+	bool     runServer   = com_serverClock.interval > 0 && ( dedicated->value || Com_IsClockDue( com_serverClock, now ) );
+	bool     runClient   = Com_IsClockDue( com_clientClock, now );
+	unsigned int svMsec  = runServer ? Com_AdvanceClock( com_serverClock, now ) : 0;
+	unsigned int clMsec  = runClient ? Com_AdvanceClock( com_clientClock, now ) : 0;
+
+	if ( runServer || runClient )
+		Prof_BeginFrame();
+
+	PROFILE_ZONE( "Qcommon_Frame" );
 
 	if ( showtrace->value >= 1.0f )
 	{
@@ -1274,32 +1498,34 @@ void Qcommon_Frame( unsigned int msec )
 		c_pointcontents = 0;
 	}
 
-	Cbuf_Execute();
+	Com_FlushDeferredPrints();
+	FS_RunAsyncLoads();
 
-	unsigned int time_before;
-	if ( host_speeds->value >= 1.0f ) time_before = chr::globalApp->GetNumMilliseconds();
+	const char *s;
+	while ( ( s = Sys_ConsoleInput() ) != nullptr )
+		Cbuf_AddText( va( "%s\n", s ) );
 
-	SV_Frame( msec );
-
-	unsigned int time_between;
-	if ( host_speeds->value >= 1.0f ) time_between = chr::globalApp->GetNumMilliseconds();
+	Cbuf_Execute();
 
-	CL_Frame( msec );
+	if ( runServer )
+		SV_Frame( svMsec );
+	if ( runClient )
+		CL_Frame( clMsec );
 
-	if ( host_speeds->value >= 1.0f )
-	{
-		unsigned int time_after = chr::globalApp->GetNumMilliseconds();
-		unsigned int all, sv, gm, cl, rf;
-
-		all = time_after - time_before;
-		sv = time_between - time_before;
-		cl = time_after - time_between;
-		gm = time_after_game - time_before_game;
-		rf = time_after_ref - time_before_ref;
-		sv -= gm;
-		cl -= rf;
-		Com_Printf( "all:%3u sv:%3u gm:%3u cl:%3u rf:%3u\n", all, sv, gm, cl, rf );
-	}
+	// whatever was queued up to send goes out together once the frame's done,
+	// including anything sent by commands when neither clock was due
+	NET_FlushPackets( NS_SERVER );
+	NET_FlushPackets( NS_CLIENT );
 }
 
-void Qcommon_Shutdown() {}
+void Qcommon_Shutdown()
+{
+	// final messages and disconnects are still sitting in the queues
+	NET_FlushPackets( NS_SERVER );
+	NET_FlushPackets( NS_CLIENT );
+
+	FS_Shutdown();
+	Job_Shutdown();
+	Com_FlushDeferredPrints();
+	Log_Shutdown();
+}
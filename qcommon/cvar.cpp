@@ -20,9 +20,12 @@ Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 // cvar.c -- dynamic variable tracking
 
 #include "qcommon.h"
+#include "name_table.h"
 
 cvar_t	*cvar_vars;
 
+static chr::NameTable< cvar_t > cvar_table;	// for finding them by name
+
 /*
 ============
 Cvar_InfoValidate
@@ -46,13 +49,7 @@ Cvar_FindVar
 */
 static cvar_t *Cvar_FindVar (const char *var_name)
 {
-	cvar_t	*var;
-	
-	for (var=cvar_vars ; var ; var=var->next)
-		if (!strcmp (var_name, var->name))
-			return var;
-
-	return NULL;
+	return cvar_table.Find (var_name);
 }
 
 /*
@@ -95,22 +92,19 @@ Cvar_CompleteVariable
 char *Cvar_CompleteVariable (const char *partial)
 {
 	cvar_t		*cvar;
-	int			len;
 	
-	len = strlen(partial);
-	
-	if (!len)
+	if (!*partial)
 		return NULL;
 		
 	// check exact match
-	for (cvar=cvar_vars ; cvar ; cvar=cvar->next)
-		if (!strcmp (partial,cvar->name))
-			return cvar->name;
+	cvar = cvar_table.Find (partial);
+	if (cvar)
+		return cvar->name;
 
 	// check partial match
-	for (cvar=cvar_vars ; cvar ; cvar=cvar->next)
-		if (!strncmp (partial,cvar->name, len))
-			return cvar->name;
+	cvar = cvar_table.FindPrefix (partial);
+	if (cvar)
+		return cvar->name;
 
 	return NULL;
 }
@@ -165,6 +159,7 @@ cvar_t *Cvar_Get ( const char *var_name, const char *var_value, int flags)
 	// link the variable in
 	var->next = cvar_vars;
 	cvar_vars = var;
+	cvar_table.Insert (var);
 
 	var->flags = flags;
 
@@ -452,12 +447,12 @@ Cvar_List_f
 */
 void Cvar_List_f (void)
 {
-	cvar_t	*var;
 	int		i;
 
 	i = 0;
-	for (var = cvar_vars ; var ; var = var->next, i++)
+	for (cvar_t *var : cvar_table.GetSorted ())
 	{
+		i++;
 		if (var->flags & CVAR_ARCHIVE)
 			Com_Printf ("*");
 		else
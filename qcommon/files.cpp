@@ -18,14 +18,33 @@
 	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
 ******************************************************************************/
 
-#include <iostream>
-#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "qcommon.h"
 
 #include <sys/stat.h>
 #include <miniz/miniz.h>
 
+#if defined( _WIN32 )
+#	define NOMINMAX
+#	include <windows.h>
+#else
+#	include <sys/mman.h>
+#	include <sys/file.h>
+#	include <fcntl.h>
+#	include <unistd.h>
+#endif
+
 /*
 =============================================================================
 
@@ -38,443 +57,3057 @@ static bool FS_DecompressFile( const uint8_t *srcBuffer, size_t srcLength, uint8
 
 /*
 =============================================================================
-Anachronox Data Packages
+Path Hashing
 =============================================================================
 */
 
-static constexpr unsigned int ADAT_MAGIC   = GENERATE_MAGICID( 'A', 'D', 'A', 'T' );
-static constexpr unsigned int ADAT_VERSION = 9;
+static constexpr uint32_t FS_HASH_SEED = 2166136261u;
 
-struct Package
+/**
+ * FNV-1a over the canonicalised, lower-case form of the given path, so that
+ * 'Models\Foo.md2' and 'models/foo.md2' land in the same bucket.
+ */
+static uint32_t FS_HashPath( const char *path, uint32_t hash = FS_HASH_SEED, size_t maxLength = SIZE_MAX )
 {
-	struct Index
+	for ( size_t i = 0; i < maxLength && path[ i ] != '\0'; ++i )
 	{
-		char     name[ 128 ];      /* the name of the file, excludes 'model/' etc. */
-		uint32_t offset;           /* offset into the dat that the file resides */
-		uint32_t length;           /* decompressed length of the file */
-		uint32_t compressedLength; /* length of the file in the dat */
-		uint32_t u0;
-	};
+		char c = path[ i ];
+		if ( c == '\\' )
+			c = '/';
 
-	std::string          mappedDir; /* e.g., 'models' */
-	std::string          path;
-	std::vector< Index > indices; /* index data */
+		hash ^= ( uint8_t ) std::tolower( ( unsigned char ) c );
+		hash *= 16777619u;
+	}
 
-	/**
- 	 * Search for the given file within a package and return it's index.
- 	 */
-	const Index *GetFileIndex( const char *fileName ) const
+	return hash;
+}
+
+/**
+ * Open-addressed table mapping a path hash onto a slot in some external
+ * array. The table doesn't know anything about the keys themselves, so
+ * the caller provides the comparison used to resolve collisions.
+ */
+class PathHashIndex
+{
+public:
+	void Reset( size_t numEntries )
+	{
+		size_t capacity = 16;
+		while ( capacity < numEntries * 2 )
+			capacity <<= 1;
+
+		buckets_.assign( capacity, Bucket{} );
+		mask_ = capacity - 1;
+	}
+
+	void Insert( uint32_t hash, uint32_t slot )
 	{
-		for ( const auto &indice : indices )
+		for ( size_t i = hash & mask_;; i = ( i + 1 ) & mask_ )
 		{
-			const Index *index = &indice;
-			if ( Q_strncasecmp( index->name, fileName, sizeof( index->name ) ) != 0 )
+			if ( buckets_[ i ].slot != 0 )
 				continue;
 
-			return index;
+			buckets_[ i ].hash = hash;
+			buckets_[ i ].slot = slot + 1;
+			return;
 		}
-
-		return nullptr;
 	}
 
-	/**
- 	 * Load a file from the given package, and decompress the data.
- 	 */
-	void *LoadFile( const char *fileName, size_t *fileLength ) const
+	template< typename COMPARE >
+	int64_t Find( uint32_t hash, COMPARE compare ) const
 	{
-		// first, ensure that it's actually in the package file table
-		const Index *fileIndex = GetFileIndex( fileName );
-		if ( fileIndex == nullptr )
-			return nullptr;
-
-		// now proceed to load that file
+		if ( buckets_.empty() )
+			return -1;
 
-		std::ifstream file;
-		file.open( path, std::ios::binary );
-		if ( !file.is_open() )
+		for ( size_t i = hash & mask_; buckets_[ i ].slot != 0; i = ( i + 1 ) & mask_ )
 		{
-			Com_Printf( "WARNING: Failed to open package \"%s\"!\n", path.c_str() );
-			return nullptr;
+			if ( buckets_[ i ].hash == hash && compare( buckets_[ i ].slot - 1 ) )
+				return buckets_[ i ].slot - 1;
 		}
 
-		file.seekg( fileIndex->offset );
-
-		if ( fileIndex->compressedLength > 0 )
-		{
-			// now load the compressed block in
-			std::vector< uint8_t > src( fileIndex->compressedLength );
-			file.read( ( char * ) src.data(), fileIndex->compressedLength );
-
-			// decompress it
-			auto   dst       = ( uint8_t * ) Z_Malloc( fileIndex->length );
-			size_t dstLength = fileIndex->length;
-			bool   status    = FS_DecompressFile( src.data(), fileIndex->compressedLength, dst, &dstLength, fileIndex->length );
-
-			file.close();
+		return -1;
+	}
 
-			if ( status )
-			{
-				*fileLength = dstLength;
-				return dst;
-			}
+	inline size_t GetCapacity() const { return buckets_.size(); }
 
-			Z_Free( dst );
-		}
-		else
-		{
-			// it's uncompressed
-			void *dst = Z_Malloc( fileIndex->length );
-			file.read( ( char * ) dst, fileIndex->length );
-			if ( !file.fail() )
-			{
-				file.close();
-				*fileLength = fileIndex->length;
-				return dst;
-			}
+private:
+	struct Bucket
+	{
+		uint32_t hash{ 0 };
+		uint32_t slot{ 0 }; /* slot + 1, so zero marks an empty bucket */
+	};
 
-			file.close();
+	std::vector< Bucket > buckets_;
+	size_t                mask_{ 0 };
+};
 
-			Z_Free( dst );
-		}
+/*
+=============================================================================
+Statistics
+=============================================================================
+*/
 
-		return nullptr;
-	}
+struct FileStats
+{
+	uint64_t numLookups;
+	uint64_t numHits;
+	uint64_t numLooseHits;
+	uint64_t numMisses;
+	uint64_t lookupTime; /* nanoseconds spent resolving packed paths */
+	uint64_t buildTime;  /* nanoseconds spent building the merged table */
+
+	/* package reads happen on the workers too */
+	std::atomic< uint64_t > numMappedReads;     /* package reads served from a mapping */
+	std::atomic< uint64_t > numPositionedReads; /* package reads that went via the handle */
+	std::atomic< uint64_t > bytesMapped;
+	std::atomic< uint64_t > bytesRead;
+
+	std::atomic< uint64_t > numInflatedReads; /* entries served from the inflated cache */
+	std::atomic< uint64_t > numInflatedWrites;
+	std::atomic< uint64_t > bytesInflatedRead;
+	std::atomic< uint64_t > bytesInflatedWritten;
+	std::atomic< uint64_t > numInflatedBad; /* slots that didn't match their checksum */
+
+	uint64_t numAsyncLoads;
+	uint64_t numPrefetches;
+	uint64_t numPrefetchHits;
+	uint64_t numPrefetchesExpired;
+	uint64_t numStolenLoads; /* queued loads the main thread ended up doing itself */
+	uint64_t waitTime;       /* nanoseconds the main thread spent blocked on workers */
 };
+static FileStats fs_stats;
+
+static uint64_t FS_GetNanoseconds()
+{
+	return std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+}
 
 /*
 =============================================================================
+Load tracing
+
+Every file handed out by FS_LoadFile, FS_MapFile or the async loader leaves
+a record of where it came from and where the time went, for fs_stats and
+fs_tracedump.
 =============================================================================
 */
 
-/**
- * Convert back-slashes to forward slashes, to play nice with our packages.
- */
-void FS_CanonicalisePath( char *path )
+enum class LoadSource
 {
-	while ( *path != '\0' )
-	{
-		if ( *path == '\\' )
-			*path = '/';
+	LOOSE,
+	PACKAGE,
+	MEMORY_CACHE, /* decompressed entry cache */
+	DISK_CACHE,   /* inflated package cache */
+};
 
-		path++;
+static const char *FS_GetLoadSourceName( LoadSource source )
+{
+	switch ( source )
+	{
+		case LoadSource::LOOSE:
+			return "loose";
+		case LoadSource::PACKAGE:
+			return "package";
+		case LoadSource::MEMORY_CACHE:
+			return "cache";
+		case LoadSource::DISK_CACHE:
+			return "inflated";
 	}
+
+	return "unknown";
 }
 
-std::string chr::io::SanitizePath( std::string path )
+/**
+ * Where the time went for a single load. Data in a mapped package is only
+ * faulted in once it's touched, so for compressed entries that mostly ends
+ * up counted as inflate time.
+ */
+struct LoadTiming
 {
-	path.erase( std::remove( path.begin(), path.end(), '\"' ), path.end() );
-	std::ranges::replace( path, '\\', '/' );
-	return path;
+	LoadSource source{ LoadSource::PACKAGE };
+	uint64_t   ioTime{ 0 };
+	uint64_t   inflateTime{ 0 };
+};
+
+struct LoadRecord
+{
+	std::string path;
+	std::string origin; /* package or directory it came from */
+	LoadSource  source;
+	size_t      compressedLength; /* 0 if it's stored */
+	size_t      length;
+	uint64_t    startTime; /* relative to the start of the trace */
+	uint64_t    ioTime;
+	uint64_t    inflateTime;
+	bool        async;
+};
+
+static constexpr size_t FS_MAX_LOAD_RECORDS = 65536;
+
+static std::mutex                fs_traceMutex;
+static std::vector< LoadRecord > fs_loadRecords;
+static uint64_t                  fs_traceStartTime;
+static uint64_t                  fs_numDroppedRecords;
+
+static void FS_ClearLoadTrace()
+{
+	std::lock_guard< std::mutex > lock( fs_traceMutex );
+	fs_loadRecords.clear();
+	fs_loadRecords.shrink_to_fit();
+	fs_traceStartTime    = FS_GetNanoseconds();
+	fs_numDroppedRecords = 0;
 }
 
 /**
- * Decompress the given file and carry out validation.
+ * Add a load to the trace; safe to call from any thread.
  */
-static bool FS_DecompressFile( const uint8_t *srcBuffer, size_t srcLength, uint8_t *dstBuffer, size_t *dstLength, size_t expectedLength )
+static void FS_TraceLoad( const char *path, const std::string &origin, const LoadTiming &timing,
+                          size_t compressedLength, size_t length, uint64_t startTime, bool async )
 {
-	assert( srcLength > 0 );
-
-	int returnCode = mz_uncompress( dstBuffer, ( mz_ulong * ) dstLength, srcBuffer, ( mz_ulong ) srcLength );
-	if ( returnCode != MZ_OK )
+	std::lock_guard< std::mutex > lock( fs_traceMutex );
+	if ( fs_loadRecords.size() >= FS_MAX_LOAD_RECORDS )
 	{
-		Com_Printf( "Failed to decompress data, return code \"%d\"!\n", returnCode );
-		return false;
+		fs_numDroppedRecords++;
+		return;
 	}
 
-	if ( *dstLength != expectedLength )
+	fs_loadRecords.push_back( LoadRecord{ path, origin, timing.source, compressedLength, length,
+	                                      startTime - fs_traceStartTime, timing.ioTime, timing.inflateTime, async } );
+}
+
+/*
+=============================================================================
+Positioned I/O
+
+Reads and writes that don't touch the file position, so a handle can be
+shared between threads.
+=============================================================================
+*/
+
+#if defined( _WIN32 )
+typedef HANDLE filehandle_t;
+#	define FS_INVALID_HANDLE INVALID_HANDLE_VALUE
+#else
+typedef int filehandle_t;
+#	define FS_INVALID_HANDLE -1
+#endif
+
+static bool FS_ReadAt( filehandle_t handle, void *dst, size_t offset, size_t length )
+{
+	uint8_t *p = ( uint8_t * ) dst;
+	while ( length > 0 )
 	{
-		Com_Printf( "Unexpected size following decompression, %d vs %d!\n", *dstLength, expectedLength );
-		return false;
+#if defined( _WIN32 )
+		OVERLAPPED overlapped{};
+		overlapped.Offset     = ( DWORD ) ( offset & 0xFFFFFFFF );
+		overlapped.OffsetHigh = ( DWORD ) ( ( uint64_t ) offset >> 32 );
+
+		DWORD numRead = 0;
+		if ( !ReadFile( handle, p, ( DWORD ) std::min< size_t >( length, 0x40000000 ), &numRead, &overlapped ) || numRead == 0 )
+			return false;
+#else
+		ssize_t numRead = pread( handle, p, length, ( off_t ) offset );
+		if ( numRead <= 0 )
+		{
+			if ( numRead == -1 && errno == EINTR )
+				continue;
+
+			return false;
+		}
+#endif
+
+		p += numRead;
+		offset += numRead;
+		length -= numRead;
 	}
 
 	return true;
 }
 
-static bool FS_MountPackage( FILE *filePtr, const char *identity, Package *out )
+static bool FS_WriteAt( filehandle_t handle, const void *src, size_t offset, size_t length )
 {
-	if ( identity == nullptr || identity[ 0 ] == '\0' )
+	const uint8_t *p = ( const uint8_t * ) src;
+	while ( length > 0 )
 	{
-		Com_Printf( "WARNING: Invalid package identity!\n" );
-		return false;
+#if defined( _WIN32 )
+		OVERLAPPED overlapped{};
+		overlapped.Offset     = ( DWORD ) ( offset & 0xFFFFFFFF );
+		overlapped.OffsetHigh = ( DWORD ) ( ( uint64_t ) offset >> 32 );
+
+		DWORD numWritten = 0;
+		if ( !WriteFile( handle, p, ( DWORD ) std::min< size_t >( length, 0x40000000 ), &numWritten, &overlapped ) || numWritten == 0 )
+			return false;
+#else
+		ssize_t numWritten = pwrite( handle, p, length, ( off_t ) offset );
+		if ( numWritten <= 0 )
+		{
+			if ( numWritten == -1 && errno == EINTR )
+				continue;
+
+			return false;
+		}
+#endif
+
+		p += numWritten;
+		offset += numWritten;
+		length -= numWritten;
 	}
 
-	struct PackageHeader
-	{
-		uint32_t magic;     /* ADAT */
-		uint32_t tocOffset; /* table of contents */
-		uint32_t tocLength; /* table of contents length */
-		uint32_t version;   /* always appears to be 9 */
-	} header{};
+	return true;
+}
 
-	// read in the header
-	fread( &header, sizeof( PackageHeader ), 1, filePtr );
+/*
+=============================================================================
+Inflated package cache
 
-	// and now ensure it's as desired!
-	header.magic = LittleLong( ( int ) header.magic );
-	if ( header.magic != ADAT_MAGIC )
-	{
-		Com_Printf( "WARNING: Invalid magic, expected \"ADAT\"!\n" );
-		return false;
-	}
+An optional copy of a package's entries, already decompressed, kept on disk
+under the game directory. Every entry has a slot reserved for it up front,
+which is filled in the first time that entry is inflated. The whole thing is
+started over whenever the package's size, timestamp or table of contents no
+longer match what it was built from.
 
-	header.version = LittleLong( ( int ) header.version );
-	if ( header.version != 9 )
-	{
-		Com_Printf( "WARNING: Unexpected package version, \"%d\" (expected \"9\")!\n", header.version );
-		return false;
-	}
+Nothing's ever synced, so there's no telling what makes it to disk if we go
+down mid-write. Instead every slot has a checksum of what went into it, and
+one that doesn't match is just another miss.
 
-	unsigned int numFiles = header.tocLength / sizeof( Package::Index );
-	if ( numFiles == 0 )
-	{
-		Com_Printf( "WARNING: Empty package!\n" );
-		return false;
-	}
+Several processes (e.g. servers run from the same install) can share the
+one cache. Each holds a shared lock for as long as it's got the cache open,
+and it's only started over by whoever manages to take it exclusively.
+=============================================================================
+*/
 
-	out->mappedDir = identity;
-	std::transform( out->mappedDir.begin(), out->mappedDir.end(), out->mappedDir.begin(), []( unsigned char c )
-	                { return std::tolower( c ); } );
+static constexpr uint32_t INFLATED_MAGIC     = GENERATE_MAGICID( 'A', 'I', 'N', 'F' );
+static constexpr uint32_t INFLATED_VERSION   = 2;
+static constexpr size_t   INFLATED_ALIGNMENT = 16;
 
-	// seek to the table of contents
-	fseek( filePtr, ( long ) header.tocOffset, SEEK_SET );
+class InflatedCache
+{
+public:
+	struct Header
+	{
+		uint32_t magic;
+		uint32_t version;
+		uint64_t packageSize;
+		int64_t  packageTime;
+		uint32_t tocChecksum;
+		uint32_t numEntries;
+	};
 
-	// and now read in the table of contents
-	out->indices.resize( numFiles );
-	if ( fread( out->indices.data(), sizeof( Package::Index ), numFiles, filePtr ) != numFiles )
+	/**
+	 * One per entry, following the header.
+	 */
+	struct Record
 	{
-		Com_Printf( "WARNING: Failed to read entire table of contents!\n" );
-		return false;
-	}
+		uint32_t checksum; /* of the slot's contents, seeded with the header's */
+		uint32_t length;   /* zero until the slot's been filled in */
+	};
 
-	// flip back slash to forward
-	for ( auto &indice : out->indices )
-		FS_CanonicalisePath( indice.name );
+	/**
+	 * Open the cache for a package, starting it afresh if it's missing or
+	 * stale. 'lengths' holds the inflated length of each entry, or zero for
+	 * those stored as-is, which don't need a slot.
+	 */
+	bool Open( const char *path, uint64_t packageSize, int64_t packageTime, uint32_t tocChecksum, const std::vector< uint32_t > &lengths )
+	{
+		numEntries_ = lengths.size();
 
-	return true;
-}
+		// records follow the header, then the slots start on the next page
+		slots_.resize( numEntries_ );
+		size_t offset = AlignUp( sizeof( Header ) + numEntries_ * sizeof( Record ), 4096 );
+		for ( size_t i = 0; i < numEntries_; ++i )
+		{
+			slots_[ i ] = offset;
+			offset      = AlignUp( offset + lengths[ i ], INFLATED_ALIGNMENT );
+		}
 
-//
-// in memory
-//
+		present_   = std::make_unique< std::atomic< bool >[] >( numEntries_ );
+		checksums_ = std::make_unique< std::atomic< uint32_t >[] >( numEntries_ );
 
-static char    fs_gamedir[ MAX_OSPATH ];
-static cvar_t *fs_basedir;
-static cvar_t *fs_cddir;
+		// the share mode keeps anyone else from writing to it on Windows, so it's only locked elsewhere
+#if defined( _WIN32 )
+		handle_ = CreateFileA( path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr );
+#else
+		handle_ = open( path, O_RDWR | O_CREAT, 0644 );
+#endif
+		if ( handle_ == FS_INVALID_HANDLE )
+			return false;
 
-cvar_t *fs_gamedirvar;
+		Header expected{ INFLATED_MAGIC, INFLATED_VERSION, packageSize, packageTime, tocChecksum, ( uint32_t ) numEntries_ };
+		headerChecksum_ = ( uint32_t ) mz_crc32( MZ_CRC32_INIT, ( const uint8_t * ) &expected, sizeof( Header ) );
 
-struct searchpath_t
-{
-	char                             filename[ MAX_OSPATH ]{ '\0' };
-	std::map< std::string, Package > packDirectories;
-	struct searchpath_t             *next{ nullptr };
-};
+#if !defined( _WIN32 )
+		// waits on anyone in the middle of starting it over
+		if ( !Lock( LOCK_SH ) )
+		{
+			Close();
+			return false;
+		}
+#endif
 
-static searchpath_t *fs_searchpaths;
-static searchpath_t *fs_base_searchpaths;// without gamedirs
+		if ( Validate( expected, offset, lengths ) )
+			return true;
 
+#if !defined( _WIN32 )
+		// it can't be started over under someone else who's using it. Swapping
+		// locks lets go of ours first, so they may have started it over in the
+		// meantime, in which case it's worth another look once they're done
+		if ( !Lock( LOCK_EX | LOCK_NB ) )
+		{
+			if ( Lock( LOCK_SH ) && Validate( expected, offset, lengths ) )
+				return true;
 
-/*
+			Com_Printf( "WARNING: Inflated cache \"%s\" is in use for another version of the package, ignoring!\n", path );
+			Close();
+			return false;
+		}
 
-All of Quake's data access is through a hierchal file system, but the contents of the file system can be transparently merged from several sources.
+		if ( Validate( expected, offset, lengths ) )
+		{
+			Lock( LOCK_SH );
+			return true;
+		}
+#endif
 
-The "base directory" is the path to the directory holding the quake.exe and all game directories.  The sys_* files pass this to host_init in quakeparms_t->basedir.  This can be overridden with the "-basedir" command line parm to allow code debugging in a different directory.  The base directory is
-only used during filesystem initialization.
+		// stale or missing, so start over; the header goes in last so that
+		// a cache we didn't finish setting up is never trusted
+		if ( !Resize( 0 ) || !Resize( offset ) || !FS_WriteAt( handle_, &expected, 0, sizeof( Header ) ) )
+		{
+			Com_Printf( "WARNING: Failed to set up inflated cache \"%s\"!\n", path );
+			Close();
+			return false;
+		}
 
-The "game directory" is the first tree on the search path and directory that all generated files (savegames, screenshots, demos, config files) will be saved to.  This can be overridden with the "-game" command line parameter.  The game directory can never be changed while quake is executing.  This is a precacution against having a malicious server instruct clients to write files over areas they shouldn't.
+#if !defined( _WIN32 )
+		Lock( LOCK_SH );
+#endif
 
-*/
+		return true;
+	}
 
-/**
- * Stat a file to fetch it's size. Only works for local files.
- */
-long FS_GetLocalFileLength( const char *path )
-{
-	struct stat buf{};
-	if ( stat( path, &buf ) != 0 )
-		return -1;
+	void Close()
+	{
+		if ( handle_ == FS_INVALID_HANDLE )
+			return;
+
+#if defined( _WIN32 )
+		CloseHandle( handle_ );
+#else
+		close( handle_ );
+#endif
+		handle_ = FS_INVALID_HANDLE;
+	}
 
-	return buf.st_size;
-}
+	InflatedCache() = default;
+	~InflatedCache() { Close(); }
 
-/*
-============
-FS_CreatePath
+	InflatedCache( const InflatedCache & )            = delete;
+	InflatedCache &operator=( const InflatedCache & ) = delete;
 
-Creates any directories needed to store the given filename
-============
-*/
-bool FS_CreatePath( char *path )
-{
-	int status;
-	for ( char *ofs = path + 1; *ofs; ofs++ )
+	inline bool IsOpen() const { return handle_ != FS_INVALID_HANDLE && !failed_; }
+	inline bool IsPresent( size_t entry ) const { return IsOpen() && present_[ entry ].load( std::memory_order_acquire ); }
+
+	/**
+	 * Read an entry back out of its slot, if it's been filled in.
+	 */
+	bool Read( size_t entry, void *dst, size_t length ) const
 	{
-		if ( *ofs == '/' )
-		{// create the directory
-			*ofs   = 0;
-			status = Sys_Mkdir( path );
-			*ofs   = '/';
-			if ( status != 0 )
-				break;
+		if ( !IsPresent( entry ) || !FS_ReadAt( handle_, dst, slots_[ entry ], length ) )
+			return false;
+
+		// cut short, or never made it to disk at all; it'll be written again
+		if ( Checksum( dst, length ) != checksums_[ entry ].load( std::memory_order_relaxed ) )
+		{
+			present_[ entry ].store( false, std::memory_order_relaxed );
+			fs_stats.numInflatedBad++;
+			return false;
+		}
+
+		fs_stats.numInflatedReads++;
+		fs_stats.bytesInflatedRead += length;
+		return true;
+	}
+
+	/**
+	 * Fill in the slot for an entry. Safe to call from several threads at once.
+	 */
+	void Write( size_t entry, const void *src, size_t length )
+	{
+		if ( !IsOpen() || IsPresent( entry ) )
+			return;
+
+		// whatever state this is left in, Read won't take it unless it matches
+		Record record{ Checksum( src, length ), ( uint32_t ) length };
+		if ( !FS_WriteAt( handle_, src, slots_[ entry ], length ) || !FS_WriteAt( handle_, &record, sizeof( Header ) + entry * sizeof( Record ), sizeof( Record ) ) )
+		{
+			if ( !failed_.exchange( true ) )
+				Com_Printf( "WARNING: Failed to write to inflated cache, no longer using it!\n" );
+
+			return;
+		}
+
+		checksums_[ entry ].store( record.checksum, std::memory_order_relaxed );
+		present_[ entry ].store( true, std::memory_order_release );
+
+		fs_stats.numInflatedWrites++;
+		fs_stats.bytesInflatedWritten += length;
+	}
+
+private:
+	static size_t AlignUp( size_t value, size_t alignment )
+	{
+		return ( value + alignment - 1 ) & ~( alignment - 1 );
+	}
+
+	/**
+	 * Seeded with the header, so nothing left over from a cache built for
+	 * something else can pass.
+	 */
+	uint32_t Checksum( const void *data, size_t length ) const
+	{
+		return ( uint32_t ) mz_crc32( headerChecksum_, ( const uint8_t * ) data, length );
+	}
+
+	/**
+	 * Check the header against what's expected, and pick up which slots
+	 * have been filled in if it's a match.
+	 */
+	bool Validate( const Header &expected, size_t size, const std::vector< uint32_t > &lengths )
+	{
+		Header header{};
+		if ( GetSize() != size || !FS_ReadAt( handle_, &header, 0, sizeof( Header ) ) || memcmp( &header, &expected, sizeof( Header ) ) != 0 )
+			return false;
+
+		std::vector< Record > records( numEntries_ );
+		if ( !FS_ReadAt( handle_, records.data(), sizeof( Header ), numEntries_ * sizeof( Record ) ) )
+			return false;
+
+		for ( size_t i = 0; i < numEntries_; ++i )
+		{
+			present_[ i ]   = ( lengths[ i ] != 0 && records[ i ].length == lengths[ i ] );
+			checksums_[ i ] = records[ i ].checksum;
+		}
+
+		return true;
+	}
+
+#if !defined( _WIN32 )
+	bool Lock( int operation )
+	{
+		while ( flock( handle_, operation ) != 0 )
+		{
+			if ( errno != EINTR )
+				return false;
+		}
+
+		return true;
+	}
+#endif
+
+	size_t GetSize() const
+	{
+#if defined( _WIN32 )
+		LARGE_INTEGER size;
+		if ( !GetFileSizeEx( handle_, &size ) )
+			return 0;
+
+		return ( size_t ) size.QuadPart;
+#else
+		struct stat buf{};
+		if ( fstat( handle_, &buf ) != 0 )
+			return 0;
+
+		return ( size_t ) buf.st_size;
+#endif
+	}
+
+	bool Resize( size_t size )
+	{
+#if defined( _WIN32 )
+		LARGE_INTEGER position;
+		position.QuadPart = ( LONGLONG ) size;
+		return SetFilePointerEx( handle_, position, nullptr, FILE_BEGIN ) && SetEndOfFile( handle_ );
+#else
+		return ftruncate( handle_, ( off_t ) size ) == 0;
+#endif
+	}
+
+	filehandle_t                                 handle_{ FS_INVALID_HANDLE };
+	size_t                                       numEntries_{ 0 };
+	std::vector< size_t >                        slots_;
+	std::unique_ptr< std::atomic< bool >[] >     present_;
+	std::unique_ptr< std::atomic< uint32_t >[] > checksums_;
+	uint32_t                                     headerChecksum_{ 0 };
+	std::atomic< bool >                          failed_{ false };
+};
+
+/*
+=============================================================================
+Anachronox Data Packages
+=============================================================================
+*/
+
+static constexpr unsigned int ADAT_MAGIC   = GENERATE_MAGICID( 'A', 'D', 'A', 'T' );
+static constexpr unsigned int ADAT_VERSION = 9;
+
+struct Package
+{
+	struct Index
+	{
+		char     name[ 128 ];      /* the name of the file, excludes 'model/' etc. */
+		uint32_t offset;           /* offset into the dat that the file resides */
+		uint32_t length;           /* decompressed length of the file */
+		uint32_t compressedLength; /* length of the file in the dat */
+		uint32_t u0;
+	};
+
+	std::string          mappedDir; /* e.g., 'models' */
+	std::string          path;
+	std::vector< Index > indices; /* index data */
+	PathHashIndex        lookup;  /* hashed, case-insensitive index into the above */
+
+	/* optional, decompressed copies of the above on disk; filled in as they're loaded */
+	mutable InflatedCache inflatedCache;
+
+	/**
+	 * Build the hashed lookup for the table of contents; names are
+	 * expected to have already been canonicalised.
+	 */
+	void BuildLookup()
+	{
+		lookup.Reset( indices.size() );
+		for ( size_t i = 0; i < indices.size(); ++i )
+		{
+			// first entry wins, same as the linear search used to
+			const char *name = indices[ i ].name;
+			uint32_t    hash = FS_HashPath( name, FS_HASH_SEED, sizeof( Index::name ) );
+			if ( lookup.Find( hash, [ & ]( uint32_t slot )
+			                  { return Q_strncasecmp( indices[ slot ].name, name, sizeof( Index::name ) ) == 0; } ) != -1 )
+				continue;
+
+			lookup.Insert( hash, i );
+		}
+	}
+
+	/**
+ 	 * Search for the given file within a package and return it's index.
+ 	 */
+	const Index *GetFileIndex( const char *fileName ) const
+	{
+		uint32_t hash = FS_HashPath( fileName, FS_HASH_SEED, sizeof( Index::name ) );
+		int64_t  slot = lookup.Find( hash, [ & ]( uint32_t slot )
+		                             { return Q_strncasecmp( indices[ slot ].name, fileName, sizeof( Index::name ) ) == 0; } );
+		if ( slot == -1 )
+			return nullptr;
+
+		return &indices[ slot ];
+	}
+
+	/**
+	 * Open the package for the lifetime of the mount. Where possible the
+	 * whole thing is mapped read-only, otherwise we fall back to positioned
+	 * reads against the handle we keep open.
+	 */
+	bool Open( const char *filePath, bool allowMapping )
+	{
+		path = filePath;
+
+#if defined( _WIN32 )
+		fileHandle_ = CreateFileA( filePath, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+		if ( fileHandle_ == INVALID_HANDLE_VALUE )
+			return false;
+
+		LARGE_INTEGER size;
+		if ( !GetFileSizeEx( fileHandle_, &size ) )
+		{
+			Close();
+			return false;
+		}
+		fileSize_ = ( size_t ) size.QuadPart;
+
+		if ( allowMapping && fileSize_ > 0 )
+		{
+			mappingHandle_ = CreateFileMappingA( fileHandle_, nullptr, PAGE_READONLY, 0, 0, nullptr );
+			if ( mappingHandle_ != nullptr )
+				mappedData_ = ( const uint8_t * ) MapViewOfFile( mappingHandle_, FILE_MAP_READ, 0, 0, 0 );
+		}
+#else
+		fileDescriptor_ = open( filePath, O_RDONLY );
+		if ( fileDescriptor_ == -1 )
+			return false;
+
+		struct stat buf{};
+		if ( fstat( fileDescriptor_, &buf ) != 0 )
+		{
+			Close();
+			return false;
+		}
+		fileSize_ = ( size_t ) buf.st_size;
+
+		if ( allowMapping && fileSize_ > 0 )
+		{
+			void *data = mmap( nullptr, fileSize_, PROT_READ, MAP_PRIVATE, fileDescriptor_, 0 );
+			if ( data != MAP_FAILED )
+				mappedData_ = ( const uint8_t * ) data;
+		}
+#endif
+
+		if ( allowMapping && mappedData_ == nullptr )
+			Com_Printf( "WARNING: Failed to map package \"%s\", falling back to reads!\n", filePath );
+
+		return true;
+	}
+
+	void Close()
+	{
+		inflatedCache.Close();
+
+#if defined( _WIN32 )
+		if ( mappedData_ != nullptr )
+			UnmapViewOfFile( mappedData_ );
+		if ( mappingHandle_ != nullptr )
+			CloseHandle( mappingHandle_ );
+		if ( fileHandle_ != INVALID_HANDLE_VALUE )
+			CloseHandle( fileHandle_ );
+
+		mappingHandle_ = nullptr;
+		fileHandle_    = INVALID_HANDLE_VALUE;
+#else
+		if ( mappedData_ != nullptr )
+			munmap( ( void * ) mappedData_, fileSize_ );
+		if ( fileDescriptor_ != -1 )
+			close( fileDescriptor_ );
+
+		fileDescriptor_ = -1;
+#endif
+
+		mappedData_ = nullptr;
+		fileSize_   = 0;
+	}
+
+	Package() = default;
+	~Package() { Close(); }
+
+	Package( const Package & )            = delete;
+	Package &operator=( const Package & ) = delete;
+
+	inline bool           IsMapped() const { return mappedData_ != nullptr; }
+	inline const uint8_t *GetMappedData() const { return mappedData_; }
+	inline size_t         GetSize() const { return fileSize_; }
+
+	/**
+	 * Hands over the mapping, so it outlives the package; it's then up to
+	 * the caller to unmap it.
+	 */
+	const uint8_t *DetachMapping()
+	{
+		const uint8_t *data = mappedData_;
+		mappedData_         = nullptr;
+		return data;
+	}
+
+	/**
+	 * Returns a pointer straight into the mapping for the given range,
+	 * or null if the package isn't mapped or the range is out of bounds.
+	 */
+	const uint8_t *GetMappedBytes( size_t offset, size_t length ) const
+	{
+		if ( mappedData_ == nullptr || offset > fileSize_ || length > fileSize_ - offset )
+			return nullptr;
+
+		fs_stats.numMappedReads++;
+		fs_stats.bytesMapped += length;
+
+		return mappedData_ + offset;
+	}
+
+	/**
+	 * Copy the given range out of the package, via the mapping if we have
+	 * one, otherwise with a positioned read so the handle can be shared.
+	 */
+	bool ReadBytes( void *dst, size_t offset, size_t length ) const
+	{
+		if ( offset > fileSize_ || length > fileSize_ - offset )
+			return false;
+
+		if ( mappedData_ != nullptr )
+		{
+			memcpy( dst, mappedData_ + offset, length );
+
+			fs_stats.numMappedReads++;
+			fs_stats.bytesMapped += length;
+			return true;
+		}
+
+		fs_stats.numPositionedReads++;
+		fs_stats.bytesRead += length;
+
+#if defined( _WIN32 )
+		return FS_ReadAt( fileHandle_, dst, offset, length );
+#else
+		return FS_ReadAt( fileDescriptor_, dst, offset, length );
+#endif
+	}
+
+	/**
+ 	 * Load a file from the given package, and decompress the data.
+ 	 */
+	void *LoadFile( const Index *fileIndex, size_t *fileLength, LoadTiming *timing = nullptr ) const
+	{
+		LoadTiming unused;
+		if ( timing == nullptr )
+			timing = &unused;
+
+		timing->source = LoadSource::PACKAGE;
+
+		uint64_t startTime = FS_GetNanoseconds();
+		if ( fileIndex->compressedLength > 0 )
+		{
+			auto   dst   = ( uint8_t * ) Z_Malloc( fileIndex->length );
+			size_t entry = fileIndex - indices.data();
+
+			// skip the inflate entirely if it's already been done before
+			if ( inflatedCache.Read( entry, dst, fileIndex->length ) )
+			{
+				timing->source = LoadSource::DISK_CACHE;
+				timing->ioTime += FS_GetNanoseconds() - startTime;
+
+				*fileLength = fileIndex->length;
+				return dst;
+			}
+
+			// inflate straight out of the mapping where we can
+			const uint8_t         *src = GetMappedBytes( fileIndex->offset, fileIndex->compressedLength );
+			std::vector< uint8_t > buffer;
+			if ( src == nullptr )
+			{
+				buffer.resize( fileIndex->compressedLength );
+				if ( !ReadBytes( buffer.data(), fileIndex->offset, fileIndex->compressedLength ) )
+				{
+					Com_Printf( "WARNING: Failed to read \"%s\" from package \"%s\"!\n", fileIndex->name, path.c_str() );
+					Z_Free( dst );
+					return nullptr;
+				}
+				src = buffer.data();
+			}
+
+			uint64_t inflateTime = FS_GetNanoseconds();
+			timing->ioTime += inflateTime - startTime;
+
+			// decompress it
+			size_t dstLength = fileIndex->length;
+			bool   status    = FS_DecompressFile( src, fileIndex->compressedLength, dst, &dstLength, fileIndex->length );
+
+			uint64_t writeTime = FS_GetNanoseconds();
+			timing->inflateTime += writeTime - inflateTime;
+
+			if ( status )
+			{
+				inflatedCache.Write( entry, dst, dstLength );
+				timing->ioTime += FS_GetNanoseconds() - writeTime;
+
+				*fileLength = dstLength;
+				return dst;
+			}
+
+			Z_Free( dst );
+		}
+		else
+		{
+			// it's uncompressed, so copy it straight into the destination
+			void *dst    = Z_Malloc( fileIndex->length );
+			bool  status = ReadBytes( dst, fileIndex->offset, fileIndex->length );
+			timing->ioTime += FS_GetNanoseconds() - startTime;
+			if ( status )
+			{
+				*fileLength = fileIndex->length;
+				return dst;
+			}
+
+			Com_Printf( "WARNING: Failed to read \"%s\" from package \"%s\"!\n", fileIndex->name, path.c_str() );
+
+			Z_Free( dst );
+		}
+
+		return nullptr;
+	}
+
+	/**
+	 * Stored entries in a mapped package can be handed out as-is, anything
+	 * else has to be loaded into a buffer first; 'borrowed' says which.
+	 */
+	const void *MapFile( const Index *fileIndex, size_t *fileLength, bool *borrowed, LoadTiming *timing = nullptr ) const
+	{
+		if ( fileIndex->compressedLength == 0 && fileIndex->length > 0 )
+		{
+			const uint8_t *src = GetMappedBytes( fileIndex->offset, fileIndex->length );
+			if ( src != nullptr )
+			{
+				*fileLength = fileIndex->length;
+				*borrowed   = true;
+				return src;
+			}
+		}
+
+		*borrowed = false;
+		return LoadFile( fileIndex, fileLength, timing );
+	}
+
+private:
+#if defined( _WIN32 )
+	HANDLE fileHandle_{ INVALID_HANDLE_VALUE };
+	HANDLE mappingHandle_{ nullptr };
+#else
+	int fileDescriptor_{ -1 };
+#endif
+	const uint8_t *mappedData_{ nullptr };
+	size_t         fileSize_{ 0 };
+};
+
+/*
+=============================================================================
+Decompressed entry cache
+
+Holds on to recently inflated package entries, so anything that's asked for
+again doesn't need to be read and inflated all over again. Entries are pinned
+while they're handed out by FS_LoadFile or FS_MapFile, otherwise they're
+evicted least recently used first once we're over budget. Used by the workers
+too.
+=============================================================================
+*/
+
+class FileCache
+{
+public:
+	struct Stats
+	{
+		size_t   numEntries;
+		size_t   residentBytes;
+		size_t   pinnedBytes;
+		size_t   budget;
+		uint64_t numHits;
+		uint64_t numMisses;
+		uint64_t numEvictions;
+	};
+
+	/**
+	 * Returns the cached entry, pinned until it's released,
+	 * or null if it's not in the cache.
+	 */
+	const void *Acquire( const Package *package, const Package::Index *index, size_t *length )
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		Entry *entry = Find( package, index );
+		if ( entry == nullptr )
+			return nullptr;
+
+		Pin( entry );
+
+		*length = entry->length;
+		return entry->data;
+	}
+
+	/**
+	 * Take ownership of the given entry and return it pinned. If it doesn't
+	 * fit within the budget, returns null and the caller keeps ownership.
+	 */
+	const void *Adopt( const Package *package, const Package::Index *index, void *data, size_t length )
+	{
+		std::unique_lock< std::mutex > lock( mutex_ );
+
+		if ( length == 0 || length > budget_ )
+			return nullptr;
+
+		// someone else got there first
+		auto i = entries_.find( Key{ package, index } );
+		if ( i != entries_.end() )
+		{
+			Pin( i->second );
+			lock.unlock();
+
+			Z_Free( data );
+			return i->second->data;
+		}
+
+		Entry *entry = Insert( package, index, data, length );
+		Pin( entry );
+		Evict();
+
+		return data;
+	}
+
+	/**
+	 * Unpin an entry handed out by Acquire or Adopt.
+	 */
+	void Release( const void *data )
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		auto i = pinned_.find( data );
+		if ( i == pinned_.end() )
+			return;
+
+		Entry *entry = i->second;
+		if ( --entry->numRefs > 0 )
+			return;
+
+		pinned_.erase( i );
+		pinnedBytes_ -= entry->length;
+
+		// no longer in the cache proper, so nothing else will come for it
+		if ( entry->orphaned )
+		{
+			Free( entry );
+			return;
+		}
+
+		lru_.push_front( entry );
+		entry->lruPosition = lru_.begin();
+
+		Evict();
+	}
+
+	/**
+	 * Drop everything, for when the mounted packages change. Anything still
+	 * pinned is freed once it's released.
+	 */
+	void Clear()
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		for ( auto &i : entries_ )
+		{
+			if ( i.second->numRefs > 0 )
+				i.second->orphaned = true;
+			else
+				Free( i.second );
+		}
+
+		entries_.clear();
+		lru_.clear();
+	}
+
+	void SetBudget( size_t budget )
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+
+		budget_ = budget;
+		Evict();
+	}
+
+	Stats GetStats()
+	{
+		std::lock_guard< std::mutex > lock( mutex_ );
+		return Stats{ entries_.size(), residentBytes_, pinnedBytes_, budget_, numHits_, numMisses_, numEvictions_ };
+	}
+
+private:
+	struct Key
+	{
+		const Package        *package;
+		const Package::Index *index;
+
+		bool operator==( const Key &other ) const { return package == other.package && index == other.index; }
+	};
+
+	struct KeyHash
+	{
+		size_t operator()( const Key &key ) const
+		{
+			return std::hash< const void * >()( key.package ) ^ ( std::hash< const void * >()( key.index ) * 31 );
+		}
+	};
+
+	struct Entry
+	{
+		Key                            key;
+		void                          *data;
+		size_t                         length;
+		unsigned int                   numRefs{ 0 };
+		bool                           orphaned{ false };
+		std::list< Entry * >::iterator lruPosition;
+	};
+
+	Entry *Find( const Package *package, const Package::Index *index )
+	{
+		auto i = entries_.find( Key{ package, index } );
+		if ( i == entries_.end() )
+		{
+			numMisses_++;
+			return nullptr;
+		}
+
+		numHits_++;
+
+		// bump it to the front, if it's not pinned
+		Entry *entry = i->second;
+		if ( entry->numRefs == 0 )
+			lru_.splice( lru_.begin(), lru_, entry->lruPosition );
+
+		return entry;
+	}
+
+	Entry *Insert( const Package *package, const Package::Index *index, void *data, size_t length )
+	{
+		auto entry = new Entry{ Key{ package, index }, data, length };
+		entries_.emplace( entry->key, entry );
+
+		lru_.push_front( entry );
+		entry->lruPosition = lru_.begin();
+
+		residentBytes_ += length;
+
+		return entry;
+	}
+
+	void Pin( Entry *entry )
+	{
+		if ( entry->numRefs++ > 0 )
+			return;
+
+		lru_.erase( entry->lruPosition );
+		pinned_.emplace( entry->data, entry );
+		pinnedBytes_ += entry->length;
+	}
+
+	void Free( Entry *entry )
+	{
+		residentBytes_ -= entry->length;
+
+		Z_Free( entry->data );
+		delete entry;
+	}
+
+	/**
+	 * Evict the least recently used entries until we're within budget,
+	 * or there's nothing left that isn't pinned.
+	 */
+	void Evict()
+	{
+		while ( residentBytes_ > budget_ && !lru_.empty() )
+		{
+			Entry *entry = lru_.back();
+			lru_.pop_back();
+
+			entries_.erase( entry->key );
+			Free( entry );
+
+			numEvictions_++;
+		}
+	}
+
+	std::mutex                                  mutex_;
+	std::unordered_map< Key, Entry *, KeyHash > entries_;
+	std::unordered_map< const void *, Entry * > pinned_;
+	std::list< Entry * >                        lru_; /* unpinned entries, most recently used first */
+	size_t                                      budget_{ 0 };
+	size_t                                      residentBytes_{ 0 };
+	size_t                                      pinnedBytes_{ 0 };
+	uint64_t                                    numHits_{ 0 };
+	uint64_t                                    numMisses_{ 0 };
+	uint64_t                                    numEvictions_{ 0 };
+};
+
+static FileCache fs_fileCache;
+
+/**
+ * Load the given entry, going via the cache. Anything handed out of the cache
+ * is pinned and flagged as 'cached', and needs releasing back to it rather
+ * than being freed.
+ */
+static void *FS_LoadPackedFile( const Package *package, const Package::Index *index, size_t *length, LoadTiming *timing, bool *cached )
+{
+	*cached = false;
+
+	// stored entries are just a read away, so they're not worth the memory
+	if ( index->compressedLength == 0 )
+		return package->LoadFile( index, length, timing );
+
+	const void *data = fs_fileCache.Acquire( package, index, length );
+	if ( data != nullptr )
+	{
+		timing->source = LoadSource::MEMORY_CACHE;
+		*cached        = true;
+		return ( void * ) data;
+	}
+
+	void *buffer = package->LoadFile( index, length, timing );
+	if ( buffer == nullptr )
+		return nullptr;
+
+	// the cache takes it over, rather than keeping a copy of its own
+	data = fs_fileCache.Adopt( package, index, buffer, *length );
+	if ( data == nullptr )
+		return buffer;
+
+	*cached = true;
+	return ( void * ) data;
+}
+
+/*
+=============================================================================
+=============================================================================
+*/
+
+/**
+ * Convert back-slashes to forward slashes, to play nice with our packages.
+ */
+void FS_CanonicalisePath( char *path )
+{
+	while ( *path != '\0' )
+	{
+		if ( *path == '\\' )
+			*path = '/';
+
+		path++;
+	}
+}
+
+std::string chr::io::SanitizePath( std::string path )
+{
+	path.erase( std::remove( path.begin(), path.end(), '\"' ), path.end() );
+	std::ranges::replace( path, '\\', '/' );
+	return path;
+}
+
+/**
+ * Decompress the given file and carry out validation.
+ */
+static bool FS_DecompressFile( const uint8_t *srcBuffer, size_t srcLength, uint8_t *dstBuffer, size_t *dstLength, size_t expectedLength )
+{
+	assert( srcLength > 0 );
+
+	int returnCode = mz_uncompress( dstBuffer, ( mz_ulong * ) dstLength, srcBuffer, ( mz_ulong ) srcLength );
+	if ( returnCode != MZ_OK )
+	{
+		Com_Printf( "Failed to decompress data, return code \"%d\"!\n", returnCode );
+		return false;
+	}
+
+	if ( *dstLength != expectedLength )
+	{
+		Com_Printf( "Unexpected size following decompression, %d vs %d!\n", *dstLength, expectedLength );
+		return false;
+	}
+
+	return true;
+}
+
+static bool FS_MountPackage( const char *path, const char *identity, bool allowMapping, const char *cachePath, Package *out )
+{
+	if ( identity == nullptr || identity[ 0 ] == '\0' )
+	{
+		Com_Printf( "WARNING: Invalid package identity!\n" );
+		return false;
+	}
+
+	if ( !out->Open( path, allowMapping ) )
+	{
+		Com_Printf( "WARNING: Failed to open package \"%s\"!\n", path );
+		return false;
+	}
+
+	struct PackageHeader
+	{
+		uint32_t magic;     /* ADAT */
+		uint32_t tocOffset; /* table of contents */
+		uint32_t tocLength; /* table of contents length */
+		uint32_t version;   /* always appears to be 9 */
+	} header{};
+
+	// read in the header
+	if ( !out->ReadBytes( &header, 0, sizeof( PackageHeader ) ) )
+	{
+		Com_Printf( "WARNING: Failed to read package header!\n" );
+		return false;
+	}
+
+	// and now ensure it's as desired!
+	header.magic = LittleLong( ( int ) header.magic );
+	if ( header.magic != ADAT_MAGIC )
+	{
+		Com_Printf( "WARNING: Invalid magic, expected \"ADAT\"!\n" );
+		return false;
+	}
+
+	header.version = LittleLong( ( int ) header.version );
+	if ( header.version != ADAT_VERSION )
+	{
+		Com_Printf( "WARNING: Unexpected package version, \"%d\" (expected \"%d\")!\n", header.version, ADAT_VERSION );
+		return false;
+	}
+
+	header.tocOffset = LittleLong( ( int ) header.tocOffset );
+	header.tocLength = LittleLong( ( int ) header.tocLength );
+
+	unsigned int numFiles = header.tocLength / sizeof( Package::Index );
+	if ( numFiles == 0 )
+	{
+		Com_Printf( "WARNING: Empty package!\n" );
+		return false;
+	}
+
+	out->mappedDir = identity;
+	std::transform( out->mappedDir.begin(), out->mappedDir.end(), out->mappedDir.begin(), []( unsigned char c )
+	                { return std::tolower( c ); } );
+
+	// and now read in the table of contents
+	out->indices.resize( numFiles );
+	if ( !out->ReadBytes( out->indices.data(), header.tocOffset, numFiles * sizeof( Package::Index ) ) )
+	{
+		Com_Printf( "WARNING: Failed to read entire table of contents!\n" );
+		return false;
+	}
+
+	// taken before anything's been swapped or canonicalised
+	uint32_t tocChecksum = Com_BlockChecksum( out->indices.data(), ( int ) ( numFiles * sizeof( Package::Index ) ) );
+
+	// flip back slash to forward
+	for ( auto &indice : out->indices )
+	{
+		indice.name[ sizeof( indice.name ) - 1 ] = '\0';
+		FS_CanonicalisePath( indice.name );
+
+		indice.offset           = LittleLong( ( int ) indice.offset );
+		indice.length           = LittleLong( ( int ) indice.length );
+		indice.compressedLength = LittleLong( ( int ) indice.compressedLength );
+	}
+
+	out->BuildLookup();
+
+	if ( cachePath != nullptr )
+	{
+		std::vector< uint32_t > lengths( numFiles );
+		for ( unsigned int i = 0; i < numFiles; ++i )
+			lengths[ i ] = out->indices[ i ].compressedLength > 0 ? out->indices[ i ].length : 0;
+
+		struct stat buf{};
+		stat( path, &buf );
+
+		out->inflatedCache.Open( cachePath, out->GetSize(), ( int64_t ) buf.st_mtime, tocChecksum, lengths );
+	}
+
+	return true;
+}
+
+//
+// in memory
+//
+
+static char    fs_gamedir[ MAX_OSPATH ];
+static cvar_t *fs_basedir;
+static cvar_t *fs_cddir;
+static cvar_t *fs_mmap;
+static cvar_t *fs_cachesize;
+static cvar_t *fs_diskcache;
+static cvar_t *fs_extractmemory;
+
+cvar_t *fs_gamedirvar;
+
+struct searchpath_t
+{
+	char                             filename[ MAX_OSPATH ]{ '\0' };
+	std::map< std::string, Package > packDirectories;
+	struct searchpath_t             *next{ nullptr };
+};
+
+static searchpath_t *fs_searchpaths;
+static searchpath_t *fs_base_searchpaths;// without gamedirs
+
+/**
+ * Pick up any change to the cache budget.
+ */
+static void FS_CheckCacheSize()
+{
+	if ( !fs_cachesize->modified )
+		return;
+
+	fs_cachesize->modified = false;
+
+	float megabytes = std::max( fs_cachesize->value, 0.0f );
+	fs_fileCache.SetBudget( ( size_t ) ( megabytes * 1024.0f * 1024.0f ) );
+}
+
+/*
+=============================================================================
+Merged file table
+
+Every file provided by a mounted package, across all search paths, keyed on
+'<mapped dir>/<name>'. Where the same file is provided more than once, the
+entry from the search path nearest the head wins, as it would have when
+walking the search paths. The others are chained on behind it, in search
+order, so there's something to fall back on if it can't be loaded.
+=============================================================================
+*/
+
+struct PackedFile
+{
+	const searchpath_t   *search;
+	const Package        *package;
+	const Package::Index *index;
+	PackedFile           *shadowed{ nullptr }; /* next one down providing the same file */
+};
+
+static std::vector< PackedFile > fs_packedFiles;
+static std::deque< PackedFile >  fs_shadowedFiles; /* everything that lost out above */
+static PathHashIndex             fs_packedFileLookup;
+
+
+static bool FS_PackedFileMatches( const PackedFile &file, const char *path )
+{
+	const std::string &dir = file.package->mappedDir;
+	if ( Q_strncasecmp( path, dir.c_str(), ( int ) dir.size() ) != 0 || path[ dir.size() ] != '/' )
+		return false;
+
+	return Q_strncasecmp( path + dir.size() + 1, file.index->name, sizeof( Package::Index::name ) ) == 0;
+}
+
+/**
+ * Rebuild the merged table; needs to be called whenever the search paths change.
+ */
+static void FS_BuildPackedFileTable()
+{
+	uint64_t startTime = FS_GetNanoseconds();
+
+	size_t numFiles = 0;
+	for ( const searchpath_t *search = fs_searchpaths; search; search = search->next )
+	{
+		for ( const auto &i : search->packDirectories )
+			numFiles += i.second.indices.size();
+	}
+
+	fs_packedFiles.clear();
+	fs_packedFiles.reserve( numFiles );
+	fs_shadowedFiles.clear();
+	fs_packedFileLookup.Reset( numFiles );
+
+	for ( const searchpath_t *search = fs_searchpaths; search; search = search->next )
+	{
+		for ( const auto &i : search->packDirectories )
+		{
+			const Package &package = i.second;
+
+			uint32_t dirHash = FS_HashPath( package.mappedDir.c_str() );
+			dirHash          = FS_HashPath( "/", dirHash );
+			for ( const auto &index : package.indices )
+			{
+				PackedFile file{ search, &package, &index };
+
+				char path[ MAX_OSPATH ];
+				snprintf( path, sizeof( path ), "%s/%s", package.mappedDir.c_str(), index.name );
+
+				uint32_t hash = FS_HashPath( index.name, dirHash, sizeof( Package::Index::name ) );
+				int64_t  slot = fs_packedFileLookup.Find( hash, [ & ]( uint32_t slot )
+				                                          { return FS_PackedFileMatches( fs_packedFiles[ slot ], path ); } );
+				if ( slot != -1 )
+				{
+					PackedFile *last = &fs_packedFiles[ slot ];
+					while ( last->shadowed != nullptr )
+						last = last->shadowed;
+
+					last->shadowed = &fs_shadowedFiles.emplace_back( file );
+					continue;
+				}
+
+				fs_packedFileLookup.Insert( hash, fs_packedFiles.size() );
+				fs_packedFiles.push_back( file );
+			}
+		}
+	}
+
+	fs_stats.buildTime = FS_GetNanoseconds() - startTime;
+}
+
+/**
+ * Resolve the given path to the package and index that provides it,
+ * with a single probe of the merged table.
+ */
+static const PackedFile *FS_FindPackedFile( const char *path )
+{
+	uint64_t startTime = FS_GetNanoseconds();
+
+	const PackedFile *file = nullptr;
+
+	uint32_t hash = FS_HashPath( path );
+	int64_t  slot = fs_packedFileLookup.Find( hash, [ & ]( uint32_t slot )
+	                                          { return FS_PackedFileMatches( fs_packedFiles[ slot ], path ); } );
+	if ( slot != -1 )
+	{
+		file = &fs_packedFiles[ slot ];
+		fs_stats.numHits++;
+	}
+
+	fs_stats.numLookups++;
+	fs_stats.lookupTime += FS_GetNanoseconds() - startTime;
+
+	return file;
+}
+
+
+/*
+
+All of Quake's data access is through a hierchal file system, but the contents of the file system can be transparently merged from several sources.
+
+The "base directory" is the path to the directory holding the quake.exe and all game directories.  The sys_* files pass this to host_init in quakeparms_t->basedir.  This can be overridden with the "-basedir" command line parm to allow code debugging in a different directory.  The base directory is
+only used during filesystem initialization.
+
+The "game directory" is the first tree on the search path and directory that all generated files (savegames, screenshots, demos, config files) will be saved to.  This can be overridden with the "-game" command line parameter.  The game directory can never be changed while quake is executing.  This is a precacution against having a malicious server instruct clients to write files over areas they shouldn't.
+
+*/
+
+/**
+ * Stat a file to fetch it's size. Only works for local files.
+ */
+long FS_GetLocalFileLength( const char *path )
+{
+	struct stat buf{};
+	if ( stat( path, &buf ) != 0 )
+		return -1;
+
+	return buf.st_size;
+}
+
+/*
+============
+FS_CreatePath
+
+Creates any directories needed to store the given filename
+============
+*/
+bool FS_CreatePath( char *path )
+{
+	int status;
+	for ( char *ofs = path + 1; *ofs; ofs++ )
+	{
+		if ( *ofs == '/' )
+		{// create the directory
+			*ofs   = 0;
+			status = Sys_Mkdir( path );
+			*ofs   = '/';
+			if ( status != 0 )
+				break;
 		}
 	}
 
 	if ( status != 0 )
 		Com_Printf( "Failed to create path (%s)\n", path );
 
-	return ( status == 0 );
+	return ( status == 0 );
+}
+
+/**
+ * Check if the given file exists locally. Only works for local files.
+ */
+bool FS_LocalFileExists( const char *path )
+{
+	return ( FS_GetLocalFileLength( path ) != -1 );
+}
+
+/*
+=============================================================================
+Mapped views
+
+Read-only views handed out by FS_MapFile. Where possible these point straight
+into a mapped package or loose file, otherwise into a buffer that we own.
+=============================================================================
+*/
+
+struct FileView
+{
+	enum class Source
+	{
+		PACKAGE, /* borrowed from a mapped package */
+		LOOSE,   /* mapping of a loose file */
+		BUFFER,  /* allocated with Z_Malloc */
+		CACHE,   /* pinned in the decompressed entry cache */
+	};
+
+	Source       source;
+	size_t       length;
+	unsigned int numRefs;
+};
+
+static std::unordered_map< const void *, FileView > fs_fileViews;
+
+static void FS_RegisterView( const void *data, FileView::Source source, size_t length )
+{
+	auto i = fs_fileViews.find( data );
+	if ( i != fs_fileViews.end() )
+	{
+		i->second.numRefs++;
+		return;
+	}
+
+	fs_fileViews.emplace( data, FileView{ source, length, 1 } );
+}
+
+/**
+ * Map a loose file into memory, read-only. Returns null if the file
+ * couldn't be mapped, in which case it should be read instead.
+ */
+static const void *FS_MapLocalFile( const char *path, size_t *length )
+{
+	const void *data = nullptr;
+
+#if defined( _WIN32 )
+	HANDLE file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+	if ( file == INVALID_HANDLE_VALUE )
+		return nullptr;
+
+	LARGE_INTEGER size;
+	if ( GetFileSizeEx( file, &size ) && size.QuadPart > 0 )
+	{
+		// the view keeps the mapping alive, so both handles can go straight away
+		HANDLE mapping = CreateFileMappingA( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+		if ( mapping != nullptr )
+		{
+			data    = MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 );
+			*length = ( size_t ) size.QuadPart;
+			CloseHandle( mapping );
+		}
+	}
+
+	CloseHandle( file );
+#else
+	int fd = open( path, O_RDONLY );
+	if ( fd == -1 )
+		return nullptr;
+
+	struct stat buf{};
+	if ( fstat( fd, &buf ) == 0 && buf.st_size > 0 )
+	{
+		void *mapping = mmap( nullptr, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+		if ( mapping != MAP_FAILED )
+		{
+			data    = mapping;
+			*length = ( size_t ) buf.st_size;
+		}
+	}
+
+	close( fd );
+#endif
+
+	return data;
+}
+
+static void FS_UnmapLocalFile( const void *data, size_t length )
+{
+#if defined( _WIN32 )
+	Q_UNUSED( length );
+	UnmapViewOfFile( data );
+#else
+	munmap( ( void * ) data, length );
+#endif
+}
+
+/**
+ * Mappings of packages that have been unmounted while views into them were
+ * still out; each is let go of once the last of those views is.
+ */
+struct RetiredMapping
+{
+	const uint8_t *data;
+	size_t         length;
+	size_t         numViews;
+};
+
+static std::vector< RetiredMapping > fs_retiredMappings;
+
+/**
+ * Returns the number of views still borrowing from the given package.
+ */
+static size_t FS_GetNumBorrowedViews( const Package &package )
+{
+	const uint8_t *start = package.GetMappedData();
+	if ( start == nullptr )
+		return 0;
+
+	size_t numViews = 0;
+	for ( const auto &i : fs_fileViews )
+	{
+		const uint8_t *data = ( const uint8_t * ) i.first;
+		if ( i.second.source == FileView::Source::PACKAGE && data >= start && data < start + package.GetSize() )
+			numViews++;
+	}
+
+	return numViews;
+}
+
+/**
+ * Keeps the package's mapping around for as long as anything is still
+ * looking into it, rather than pulling it out from under them.
+ */
+static void FS_RetirePackage( Package &package )
+{
+	size_t numViews = FS_GetNumBorrowedViews( package );
+	if ( numViews == 0 )
+		return;
+
+	size_t length = package.GetSize();
+	fs_retiredMappings.push_back( { package.DetachMapping(), length, numViews } );
+
+	Com_DPrintf( "Keeping \"%s\" mapped for %zu outstanding views\n", package.path.c_str(), numViews );
+}
+
+/**
+ * Packages that have been unmounted while streams were still reading from
+ * them; each is let go of once the last of those streams is closed.
+ */
+static std::list< std::map< std::string, Package >::node_type > fs_retiredPackages;
+static std::unordered_map< const Package *, size_t >            fs_streamedPackages;// number of streams open on each
+
+/**
+ * Unmount everything in the given search path, holding on to whatever is
+ * still being read from.
+ */
+static void FS_RetirePackages( searchpath_t *search )
+{
+	auto &packages = search->packDirectories;
+	while ( !packages.empty() )
+	{
+		// taking the node out leaves the package where it is, so streams can carry on with it
+		auto node = packages.extract( packages.begin() );
+		if ( fs_streamedPackages.count( &node.mapped() ) > 0 )
+		{
+			Com_DPrintf( "Keeping \"%s\" open for %zu outstanding streams\n", node.mapped().path.c_str(), fs_streamedPackages[ &node.mapped() ] );
+			fs_retiredPackages.push_back( std::move( node ) );
+			continue;
+		}
+
+		FS_RetirePackage( node.mapped() );
+	}
+}
+
+/**
+ * Called as a stream on a package is closed, in case it was the last one
+ * keeping a retired package around.
+ */
+static void FS_ReleaseStreamedPackage( const Package *package )
+{
+	auto i = fs_streamedPackages.find( package );
+	if ( --i->second > 0 )
+		return;
+
+	fs_streamedPackages.erase( i );
+
+	for ( auto j = fs_retiredPackages.begin(); j != fs_retiredPackages.end(); ++j )
+	{
+		if ( &j->mapped() != package )
+			continue;
+
+		// views can still be out on it, even once the streams are done
+		FS_RetirePackage( j->mapped() );
+		fs_retiredPackages.erase( j );
+		return;
+	}
+}
+
+/**
+ * Called as a view borrowed from a package is let go of, in case it was
+ * the last one keeping a retired mapping around.
+ */
+static void FS_ReleaseBorrowedView( const void *view )
+{
+	const uint8_t *data = ( const uint8_t * ) view;
+	for ( auto i = fs_retiredMappings.begin(); i != fs_retiredMappings.end(); ++i )
+	{
+		if ( data < i->data || data >= i->data + i->length )
+			continue;
+
+		if ( --i->numViews == 0 )
+		{
+			FS_UnmapLocalFile( i->data, i->length );
+			fs_retiredMappings.erase( i );
+		}
+		return;
+	}
+}
+
+/**
+ * Load the given entry for FS_OpenFile, returning null if it couldn't be.
+ */
+static const void *FS_OpenPackedFile( const char *filename, const PackedFile *packedFile, size_t *length, bool mapped, uint64_t startTime )
+{
+	LoadTiming timing;
+
+	const Package        *package = packedFile->package;
+	const Package::Index *index   = packedFile->index;
+	if ( mapped )
+	{
+		// compressed entries can be shared straight out of the cache
+		const void *view = nullptr;
+		if ( index->compressedLength > 0 )
+			view = fs_fileCache.Acquire( package, index, length );
+
+		if ( view != nullptr )
+		{
+			timing.source = LoadSource::MEMORY_CACHE;
+			FS_TraceLoad( filename, package->path, timing, index->compressedLength, *length, startTime, false );
+
+			FS_RegisterView( view, FileView::Source::CACHE, *length );
+			return view;
+		}
+
+		bool borrowed;
+		view = package->MapFile( index, length, &borrowed, &timing );
+		if ( view == nullptr )
+			return nullptr;
+
+		FS_TraceLoad( filename, package->path, timing, index->compressedLength, *length, startTime, false );
+
+		if ( borrowed )
+		{
+			FS_RegisterView( view, FileView::Source::PACKAGE, *length );
+			return view;
+		}
+
+		const void *cached = nullptr;
+		if ( index->compressedLength > 0 )
+			cached = fs_fileCache.Adopt( package, index, ( void * ) view, *length );
+
+		if ( cached != nullptr )
+		{
+			FS_RegisterView( cached, FileView::Source::CACHE, *length );
+			return cached;
+		}
+
+		FS_RegisterView( view, FileView::Source::BUFFER, *length );
+		return view;
+	}
+
+	bool  cached;
+	void *buffer = FS_LoadPackedFile( package, index, length, &timing, &cached );
+	if ( buffer == nullptr )
+		return nullptr;
+
+	FS_TraceLoad( filename, package->path, timing, index->compressedLength, *length, startTime, false );
+
+	if ( cached )
+		FS_RegisterView( buffer, FileView::Source::CACHE, *length );
+
+	return buffer;
+}
+
+/*
+===========
+FS_FOpenFile
+
+Finds the file in the search path.
+returns filesize and an open FILE *
+Used for streaming data out of either a pak file or
+a seperate file.
+===========
+*/
+static const void *FS_OpenFile( const char *filename, size_t *length, bool mapped )
+{
+	FS_CheckCacheSize();
+
+	uint64_t startTime = FS_GetNanoseconds();
+
+	// resolve which package, if any, provides the file up front
+	const PackedFile *packedFile = FS_FindPackedFile( filename );
+
+	// search through the path, one element at a time
+	for ( searchpath_t *search = fs_searchpaths; search; search = search->next )
+	{
+		LoadTiming timing{ LoadSource::LOOSE };
+
+		// check a file in the directory tree
+		char netpath[ MAX_OSPATH ];
+		Com_sprintf( netpath, sizeof( netpath ), "%s/%s", search->filename, filename );
+
+		FS_CanonicalisePath( netpath );
+
+		// first, attempt to open it locally
+		long fileLength = FS_GetLocalFileLength( netpath );
+		if ( fileLength >= 0 )
+		{
+			if ( mapped && fs_mmap->value != 0.0f )
+			{
+				const void *view = FS_MapLocalFile( netpath, length );
+				if ( view != nullptr )
+				{
+					timing.ioTime = FS_GetNanoseconds() - startTime;
+					FS_TraceLoad( filename, search->filename, timing, 0, *length, startTime, false );
+
+					FS_RegisterView( view, FileView::Source::LOOSE, *length );
+					fs_stats.numLooseHits++;
+					return view;
+				}
+			}
+
+			FILE *filePtr = fopen( netpath, "rb" );
+			if ( filePtr != nullptr )
+			{
+				/* allocate a buffer and read the whole thing into memory */
+				void *buffer = Z_Malloc( fileLength );
+				fread( buffer, sizeof( uint8_t ), fileLength, filePtr );
+
+				fclose( filePtr );
+				*length = fileLength;
+
+				timing.ioTime = FS_GetNanoseconds() - startTime;
+				FS_TraceLoad( filename, search->filename, timing, 0, fileLength, startTime, false );
+
+				if ( mapped )
+					FS_RegisterView( buffer, FileView::Source::BUFFER, fileLength );
+
+				fs_stats.numLooseHits++;
+
+				return buffer;
+			}
+		}
+
+		// otherwise, load it from one of the anox packages, falling back on
+		// whatever that one shadows should it fail
+		for ( ; packedFile != nullptr && packedFile->search == search; packedFile = packedFile->shadowed )
+		{
+			const void *data = FS_OpenPackedFile( filename, packedFile, length, mapped, startTime );
+			if ( data != nullptr )
+				return data;
+		}
+	}
+
+	Com_DPrintf( "FindFile: can't find %s\n", filename );
+
+	fs_stats.numMisses++;
+
+	return nullptr;
+}
+
+void *FS_FOpenFile( const char *filename, size_t *length )
+{
+	return ( void * ) FS_OpenFile( filename, length, false );
+}
+
+/*
+=================
+FS_ReadFile
+
+Properly handles partial reads
+=================
+*/
+void CDAudio_Stop();
+#define MAX_READ 0x10000// read in blocks of 64k
+void FS_Read( void *buffer, int len, FILE *f )
+{
+	int   block, remaining;
+	int   read;
+	byte *buf;
+	int   tries;
+
+	buf = ( byte * ) buffer;
+
+	// read in chunks for progress bar
+	remaining = len;
+	tries     = 0;
+	while ( remaining )
+	{
+		block = remaining;
+		if ( block > MAX_READ )
+			block = MAX_READ;
+		read = fread( buf, 1, block, f );
+		if ( read == 0 )
+		{
+			// we might have been trying to read from a CD
+			if ( !tries )
+			{
+				tries = 1;
+				CDAudio_Stop();
+			}
+			else
+				Com_Error( ERR_FATAL, "FS_Read: 0 bytes read" );
+		}
+
+		if ( read == -1 )
+			Com_Error( ERR_FATAL, "FS_Read: -1 bytes read" );
+
+		// do some progress bar thing here...
+
+		remaining -= read;
+		buf += read;
+	}
+}
+
+/*
+=============================================================================
+Streaming
+
+Streams read a file in pieces rather than all at once. Compressed package
+entries are inflated as they're read, so only the inflater's window and a
+small input buffer are ever held in memory.
+=============================================================================
+*/
+
+static constexpr size_t FS_STREAM_BUFFER_SIZE = 64 * 1024;
+
+struct fsstream_s
+{
+	FILE                 *file{ nullptr };
+	const Package        *package{ nullptr };
+	const Package::Index *index{ nullptr };
+
+	size_t length{ 0 };
+	size_t position{ 0 };
+
+	// only used for compressed entries
+	bool                   inflating{ false };
+	mz_stream              inflater{};
+	size_t                 inputOffset{ 0 };// compressed bytes handed over to the inflater so far
+	std::vector< uint8_t > input;
+};
+
+static bool FS_StartInflatingStream( fsstream_t *stream )
+{
+	stream->inflater = {};
+	if ( mz_inflateInit( &stream->inflater ) != MZ_OK )
+	{
+		Com_Printf( "WARNING: Failed to start inflating \"%s\"!\n", stream->index->name );
+		return false;
+	}
+
+	stream->inflating   = true;
+	stream->position    = 0;
+	stream->inputOffset = 0;
+
+	// mapped packages can have the whole thing handed over up front
+	const uint8_t *src = stream->package->GetMappedBytes( stream->index->offset, stream->index->compressedLength );
+	if ( src != nullptr )
+	{
+		stream->inflater.next_in  = src;
+		stream->inflater.avail_in = stream->index->compressedLength;
+		stream->inputOffset       = stream->index->compressedLength;
+	}
+	else
+		stream->input.resize( FS_STREAM_BUFFER_SIZE );
+
+	return true;
+}
+
+static void FS_StopInflatingStream( fsstream_t *stream )
+{
+	if ( !stream->inflating )
+		return;
+
+	mz_inflateEnd( &stream->inflater );
+	stream->inflating = false;
+}
+
+static size_t FS_InflateStream( fsstream_t *stream, uint8_t *dst, size_t length )
+{
+	if ( !stream->inflating )
+		return 0;
+
+	mz_stream *inflater = &stream->inflater;
+	inflater->next_out  = dst;
+	inflater->avail_out = ( unsigned int ) length;
+
+	while ( inflater->avail_out > 0 )
+	{
+		size_t compressedLength = stream->index->compressedLength;
+		if ( inflater->avail_in == 0 && stream->inputOffset < compressedLength )
+		{
+			size_t chunk = std::min( stream->input.size(), compressedLength - stream->inputOffset );
+			if ( !stream->package->ReadBytes( stream->input.data(), stream->index->offset + stream->inputOffset, chunk ) )
+			{
+				Com_Printf( "WARNING: Failed to read \"%s\" from package \"%s\"!\n", stream->index->name, stream->package->path.c_str() );
+				FS_StopInflatingStream( stream );
+				break;
+			}
+
+			inflater->next_in  = stream->input.data();
+			inflater->avail_in = ( unsigned int ) chunk;
+			stream->inputOffset += chunk;
+		}
+
+		int returnCode = mz_inflate( inflater, MZ_NO_FLUSH );
+		if ( returnCode == MZ_STREAM_END )
+			break;
+
+		if ( returnCode != MZ_OK )
+		{
+			Com_Printf( "WARNING: Failed to inflate \"%s\", return code \"%d\"!\n", stream->index->name, returnCode );
+			FS_StopInflatingStream( stream );
+			break;
+		}
+	}
+
+	size_t numBytes = length - inflater->avail_out;
+	stream->position += numBytes;
+	return numBytes;
+}
+
+/**
+ * Open the given file for reading in pieces, following the same search order
+ * as FS_LoadFile.
+ */
+fsstream_t *FS_OpenStream( const char *path, size_t *length )
+{
+	const PackedFile *packedFile = FS_FindPackedFile( path );
+
+	for ( searchpath_t *search = fs_searchpaths; search; search = search->next )
+	{
+		char netpath[ MAX_OSPATH ];
+		Com_sprintf( netpath, sizeof( netpath ), "%s/%s", search->filename, path );
+
+		FS_CanonicalisePath( netpath );
+
+		long fileLength = FS_GetLocalFileLength( netpath );
+		if ( fileLength >= 0 )
+		{
+			FILE *file = fopen( netpath, "rb" );
+			if ( file != nullptr )
+			{
+				auto stream    = new fsstream_t;
+				stream->file   = file;
+				stream->length = fileLength;
+				if ( length != nullptr )
+					*length = stream->length;
+
+				fs_stats.numLooseHits++;
+				return stream;
+			}
+		}
+
+		for ( ; packedFile != nullptr && packedFile->search == search; packedFile = packedFile->shadowed )
+		{
+			auto stream     = new fsstream_t;
+			stream->package = packedFile->package;
+			stream->index   = packedFile->index;
+			stream->length  = packedFile->index->length;
+			if ( stream->index->compressedLength > 0 && !FS_StartInflatingStream( stream ) )
+			{
+				delete stream;
+				continue;
+			}
+
+			if ( length != nullptr )
+				*length = stream->length;
+
+			// keeps the package around if it's unmounted before we're done
+			fs_streamedPackages[ stream->package ]++;
+
+			return stream;
+		}
+	}
+
+	Com_DPrintf( "FS_OpenStream: can't find %s\n", path );
+
+	fs_stats.numMisses++;
+
+	return nullptr;
+}
+
+/**
+ * Read up to the given number of bytes, returning how many were actually read.
+ */
+size_t FS_ReadStream( fsstream_t *stream, void *buffer, size_t length )
+{
+	length = std::min( length, stream->length - stream->position );
+	if ( length == 0 )
+		return 0;
+
+	if ( stream->file != nullptr )
+	{
+		size_t numBytes = fread( buffer, 1, length, stream->file );
+		stream->position += numBytes;
+		return numBytes;
+	}
+
+	if ( stream->index->compressedLength > 0 )
+		return FS_InflateStream( stream, ( uint8_t * ) buffer, length );
+
+	if ( !stream->package->ReadBytes( buffer, stream->index->offset + stream->position, length ) )
+	{
+		Com_Printf( "WARNING: Failed to read \"%s\" from package \"%s\"!\n", stream->index->name, stream->package->path.c_str() );
+		return 0;
+	}
+
+	stream->position += length;
+	return length;
+}
+
+/**
+ * Move the read position to the given offset from the start. Compressed
+ * entries can only be moved forwards by inflating up to the new position,
+ * so going backwards means starting over from the beginning.
+ */
+bool FS_SeekStream( fsstream_t *stream, size_t offset )
+{
+	if ( offset > stream->length )
+		return false;
+
+	if ( stream->file != nullptr )
+	{
+		if ( fseek( stream->file, ( long ) offset, SEEK_SET ) != 0 )
+			return false;
+
+		stream->position = offset;
+		return true;
+	}
+
+	if ( stream->index->compressedLength == 0 )
+	{
+		stream->position = offset;
+		return true;
+	}
+
+	if ( offset < stream->position )
+	{
+		FS_StopInflatingStream( stream );
+		if ( !FS_StartInflatingStream( stream ) )
+			return false;
+	}
+
+	uint8_t scratch[ 4096 ];
+	while ( stream->position < offset )
+	{
+		if ( FS_InflateStream( stream, scratch, std::min( sizeof( scratch ), offset - stream->position ) ) == 0 )
+			return false;
+	}
+
+	return true;
+}
+
+void FS_CloseStream( fsstream_t *stream )
+{
+	if ( stream == nullptr )
+		return;
+
+	FS_StopInflatingStream( stream );
+
+	if ( stream->file != nullptr )
+		fclose( stream->file );
+
+	if ( stream->package != nullptr )
+		FS_ReleaseStreamedPackage( stream->package );
+
+	delete stream;
+}
+
+/*
+=============================================================================
+Load manifests
+
+Everything a map loads between starting up and its first rendered frame is
+recorded, in order, to a manifest under the game directory. The next time
+that map starts, the manifest is replayed as a batch of prefetches sorted by
+where the files sit in their packages, so the workers can stream through and
+inflate it all ahead of whatever's about to ask for it.
+=============================================================================
+*/
+
+static constexpr size_t FS_MAX_MANIFEST_BYTES = 256 * 1024 * 1024; /* cap on what a replay inflates up front */
+
+static cvar_t                           *fs_manifests;
+static std::string                       fs_manifestName; /* empty if nothing's being recorded */
+static std::vector< std::string >        fs_manifestPaths;
+static std::unordered_set< std::string > fs_manifestLookup;
+
+static void FS_GetManifestPath( const std::string &name, char *out, size_t size )
+{
+	Com_sprintf( out, size, "%s/manifests/%s.txt", FS_Gamedir(), name.c_str() );
+}
+
+static void FS_RecordManifestLoad( const char *path )
+{
+	if ( fs_manifestName.empty() )
+		return;
+
+	if ( fs_manifestLookup.insert( chr::StringToLower( path ) ).second )
+		fs_manifestPaths.emplace_back( path );
+}
+
+/**
+ * Queue up prefetches for everything in the given manifest, in package order.
+ */
+static void FS_ReplayManifest( const char *manifestPath )
+{
+	FILE *file = fopen( manifestPath, "r" );
+	if ( file == nullptr )
+		return;
+
+	std::vector< std::pair< std::string, const PackedFile * > > entries;
+
+	char line[ MAX_QPATH ];
+	while ( fgets( line, sizeof( line ), file ) != nullptr )
+	{
+		line[ strcspn( line, "\r\n" ) ] = '\0';
+		if ( line[ 0 ] == '\0' )
+			continue;
+
+		entries.emplace_back( line, FS_FindPackedFile( line ) );
+	}
+
+	fclose( file );
+
+	// loose files first, then each package from front to back
+	std::stable_sort( entries.begin(), entries.end(), []( const auto &a, const auto &b )
+	                  {
+		                  const PackedFile *x = a.second;
+		                  const PackedFile *y = b.second;
+		                  if ( x == nullptr || y == nullptr )
+			                  return x == nullptr && y != nullptr;
+		                  if ( x->package != y->package )
+			                  return x->package->path < y->package->path;
+		                  return x->index->offset < y->index->offset; } );
+
+	size_t numBytes    = 0;
+	size_t numReplayed = 0;
+	for ( const auto &i : entries )
+	{
+		const PackedFile *packedFile = i.second;
+		if ( packedFile != nullptr && packedFile->index->compressedLength > 0 )
+		{
+			numBytes += packedFile->index->length;
+			if ( numBytes > FS_MAX_MANIFEST_BYTES )
+				break;
+		}
+
+		FS_Prefetch( i.first.c_str() );
+		numReplayed++;
+	}
+
+	Com_DPrintf( "Replayed %zu of %zu files from \"%s\"\n", numReplayed, entries.size(), manifestPath );
+}
+
+/**
+ * Start recording the loads for the given map, and replay whatever was
+ * recorded for it last time.
+ */
+void FS_BeginLoadManifest( const char *name )
+{
+	if ( fs_manifests->value == 0.0f || name == nullptr || name[ 0 ] == '\0' )
+		return;
+
+	// without any workers there's nothing to prefetch with, so don't bother writing it down
+	if ( Job_GetNumWorkers() == 0 )
+		return;
+
+	// the server and client both announce the same map when it's local
+	if ( fs_manifestName == name )
+		return;
+
+	fs_manifestName = name;
+	fs_manifestPaths.clear();
+	fs_manifestLookup.clear();
+
+	char path[ MAX_OSPATH ];
+	FS_GetManifestPath( fs_manifestName, path, sizeof( path ) );
+	FS_ReplayManifest( path );
+}
+
+/**
+ * Stop recording, and write out what was loaded for next time.
+ */
+void FS_EndLoadManifest()
+{
+	if ( fs_manifestName.empty() )
+		return;
+
+	char path[ MAX_OSPATH ];
+	FS_GetManifestPath( fs_manifestName, path, sizeof( path ) );
+
+	fs_manifestName.clear();
+	fs_manifestLookup.clear();
+
+	if ( fs_manifestPaths.empty() || !FS_CreatePath( path ) )
+		return;
+
+	FILE *file = fopen( path, "w" );
+	if ( file == nullptr )
+	{
+		Com_Printf( "WARNING: Failed to open \"%s\" for writing!\n", path );
+		return;
+	}
+
+	for ( const std::string &i : fs_manifestPaths )
+		fprintf( file, "%s\n", i.c_str() );
+
+	fclose( file );
+
+	Com_DPrintf( "Wrote %zu files to \"%s\"\n", fs_manifestPaths.size(), path );
+
+	fs_manifestPaths.clear();
+}
+
+/*
+=============================================================================
+Asynchronous loading
+
+Requests are resolved against the search paths on the main thread and then
+queued up by priority. Each one queued is matched by a background job, which
+takes whatever's most urgent at the time and does the reads and decompression
+on one of the job workers. Completion is only ever reported back on the main
+thread.
+=============================================================================
+*/
+
+struct AsyncLoad
+{
+	enum class State
+	{
+		QUEUED,
+		RUNNING,
+		DONE,
+	};
+
+	fsrequest_t handle{ 0 };
+	std::string path;
+
+	/* where the file comes from, resolved when the request is made */
+	const Package        *package{ nullptr };
+	const Package::Index *index{ nullptr };
+	std::string           localPath;
+	bool                  touch{ false }; /* only fault the pages in, there's nothing to hand over */
+
+	/* main thread only */
+	fscallback_t callback{ nullptr };
+	void        *user{ nullptr };
+	bool         released{ false };   /* nobody wants the result anymore */
+	uint64_t     completionTime{ 0 }; /* when the main thread saw it finish */
+
+	/* guarded by fs_asyncMutex until the load is done */
+	State   state{ State::QUEUED };
+	void   *buffer{ nullptr };
+	ssize_t length{ -1 };
+	bool    cached{ false }; /* the buffer's pinned in fs_fileCache, rather than ours */
+};
+
+struct QueuedLoad
+{
+	fspriority_t                 priority;
+	uint64_t                     sequence;
+	std::shared_ptr< AsyncLoad > load;
+
+	bool operator<( const QueuedLoad &other ) const
+	{
+		// highest priority first, then first come, first served
+		if ( priority != other.priority )
+			return priority < other.priority;
+
+		return sequence > other.sequence;
+	}
+};
+
+static jobcounter_t                                fs_asyncJobs;
+static std::mutex                                  fs_asyncMutex;
+static std::condition_variable                     fs_asyncDone;
+static std::priority_queue< QueuedLoad >           fs_asyncQueue;
+static std::vector< std::shared_ptr< AsyncLoad > > fs_asyncCompleted;
+static uint64_t                                    fs_asyncSequence;
+static unsigned int                                fs_asyncNumRunning;
+
+static std::unordered_map< fsrequest_t, std::shared_ptr< AsyncLoad > > fs_asyncLoads;
+static std::unordered_map< std::string, std::shared_ptr< AsyncLoad > > fs_prefetches;
+static fsrequest_t                                                     fs_asyncHandle;
+
+static constexpr uint64_t FS_PREFETCH_EXPIRY = 10ULL * 1000000000ULL; /* unclaimed prefetches are dropped after this */
+static constexpr size_t   FS_PAGE_SIZE       = 4096;
+
+/**
+ * Work out where the given file would be loaded from, following the
+ * same order as FS_OpenFile. Returns false if it doesn't exist.
+ */
+static bool FS_ResolveLoad( const char *filename, AsyncLoad *load )
+{
+	const PackedFile *packedFile = FS_FindPackedFile( filename );
+	for ( const searchpath_t *search = fs_searchpaths; search; search = search->next )
+	{
+		char netpath[ MAX_OSPATH ];
+		Com_sprintf( netpath, sizeof( netpath ), "%s/%s", search->filename, filename );
+
+		FS_CanonicalisePath( netpath );
+
+		if ( FS_LocalFileExists( netpath ) )
+		{
+			load->localPath = netpath;
+			return true;
+		}
+
+		if ( packedFile != nullptr && packedFile->search == search )
+		{
+			load->package = packedFile->package;
+			load->index   = packedFile->index;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/**
+ * Carry out the reads and decompression for a load; safe to call from any thread.
+ */
+static void FS_PerformLoad( AsyncLoad *load )
+{
+	PROFILE_ZONE( "FS_PerformLoad" );
+
+	uint64_t startTime = FS_GetNanoseconds();
+
+	LoadTiming timing;
+	if ( load->touch )
+	{
+		const volatile uint8_t *src = load->package->GetMappedBytes( load->index->offset, load->index->length );
+		if ( src != nullptr )
+		{
+			for ( size_t i = 0; i < load->index->length; i += FS_PAGE_SIZE )
+				( void ) src[ i ];
+		}
+
+		timing.ioTime = FS_GetNanoseconds() - startTime;
+		FS_TraceLoad( load->path.c_str(), load->package->path, timing, 0, load->index->length, startTime, true );
+		return;
+	}
+
+	if ( load->package != nullptr )
+	{
+		size_t length;
+		load->buffer = FS_LoadPackedFile( load->package, load->index, &length, &timing, &load->cached );
+		if ( load->buffer != nullptr )
+		{
+			load->length = ( ssize_t ) length;
+			FS_TraceLoad( load->path.c_str(), load->package->path, timing, load->index->compressedLength, length, startTime, true );
+		}
+
+		return;
+	}
+
+	long fileLength = FS_GetLocalFileLength( load->localPath.c_str() );
+	if ( fileLength < 0 )
+		return;
+
+	FILE *filePtr = fopen( load->localPath.c_str(), "rb" );
+	if ( filePtr == nullptr )
+		return;
+
+	void *buffer = Z_Malloc( fileLength );
+	if ( fread( buffer, sizeof( uint8_t ), fileLength, filePtr ) == ( size_t ) fileLength )
+	{
+		load->buffer = buffer;
+		load->length = fileLength;
+
+		timing.source = LoadSource::LOOSE;
+		timing.ioTime = FS_GetNanoseconds() - startTime;
+		// trace it against the search directory, same as FS_OpenFile
+		std::string origin = load->localPath.substr( 0, load->localPath.size() - load->path.size() - 1 );
+		FS_TraceLoad( load->path.c_str(), origin, timing, 0, fileLength, startTime, true );
+	}
+	else
+	{
+		Com_Printf( "WARNING: Failed to read \"%s\"!\n", load->localPath.c_str() );
+		Z_Free( buffer );
+	}
+
+	fclose( filePtr );
+}
+
+static void FS_CompleteLoad( const std::shared_ptr< AsyncLoad > &load )
+{
+	{
+		std::lock_guard< std::mutex > lock( fs_asyncMutex );
+		load->state = AsyncLoad::State::DONE;
+		fs_asyncCompleted.push_back( load );
+	}
+
+	fs_asyncDone.notify_all();
+}
+
+/**
+ * Carries out whichever queued load is most urgent, rather than any one in
+ * particular. There's a job for every time something's queued, so nothing's
+ * left behind. These go to the background, as they block on I/O.
+ */
+static void FS_AsyncJob( void *data, size_t begin, size_t end )
+{
+	std::unique_lock< std::mutex > lock( fs_asyncMutex );
+	while ( !fs_asyncQueue.empty() )
+	{
+		std::shared_ptr< AsyncLoad > load = fs_asyncQueue.top().load;
+		fs_asyncQueue.pop();
+
+		// may have been cancelled, taken over by the main thread or queued twice
+		if ( load->state != AsyncLoad::State::QUEUED )
+			continue;
+
+		load->state = AsyncLoad::State::RUNNING;
+		fs_asyncNumRunning++;
+
+		lock.unlock();
+		FS_PerformLoad( load.get() );
+		lock.lock();
+
+		load->state = AsyncLoad::State::DONE;
+		fs_asyncCompleted.push_back( load );
+		fs_asyncNumRunning--;
+
+		fs_asyncDone.notify_all();
+		return;
+	}
+}
+
+static void FS_QueueLoad( const std::shared_ptr< AsyncLoad > &load, fspriority_t priority )
+{
+	if ( Job_GetNumWorkers() == 0 )
+	{
+		// no workers, so it's done there and then
+		{
+			std::lock_guard< std::mutex > lock( fs_asyncMutex );
+			if ( load->state != AsyncLoad::State::QUEUED )
+				return;
+
+			load->state = AsyncLoad::State::RUNNING;
+		}
+
+		FS_PerformLoad( load.get() );
+		FS_CompleteLoad( load );
+		return;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( fs_asyncMutex );
+		fs_asyncQueue.push( QueuedLoad{ priority, fs_asyncSequence++, load } );
+	}
+
+	Job_SubmitBackground( { FS_AsyncJob }, &fs_asyncJobs );
 }
 
 /**
- * Check if the given file exists locally. Only works for local files.
+ * Block until the given load is done. If no worker has picked it up yet,
+ * the main thread just does it itself rather than waiting its turn.
  */
-bool FS_LocalFileExists( const char *path )
+static void FS_WaitLoad( const std::shared_ptr< AsyncLoad > &load )
 {
-	return ( FS_GetLocalFileLength( path ) != -1 );
+	std::unique_lock< std::mutex > lock( fs_asyncMutex );
+	if ( load->state == AsyncLoad::State::DONE )
+		return;
+
+	if ( load->state == AsyncLoad::State::QUEUED )
+	{
+		load->state = AsyncLoad::State::RUNNING;
+		lock.unlock();
+
+		FS_PerformLoad( load.get() );
+		FS_CompleteLoad( load );
+
+		fs_stats.numStolenLoads++;
+		return;
+	}
+
+	uint64_t startTime = FS_GetNanoseconds();
+	fs_asyncDone.wait( lock, [ & ]()
+	                   { return load->state == AsyncLoad::State::DONE; } );
+	fs_stats.waitTime += FS_GetNanoseconds() - startTime;
 }
 
-/*
-===========
-FS_FOpenFile
+static void FS_FreeLoadBuffer( void *buffer, bool cached )
+{
+	if ( cached )
+		fs_fileCache.Release( buffer );
+	else
+		Z_Free( buffer );
+}
 
-Finds the file in the search path.
-returns filesize and an open FILE *
-Used for streaming data out of either a pak file or
-a seperate file.
-===========
-*/
-void *FS_FOpenFile( const char *filename, size_t *length )
+/**
+ * Hand over the result of a completed load; it's released afterwards.
+ * Anything out of the cache is registered as a view, so that it's let
+ * go of through FS_FreeFile or FS_UnmapFile like everything else.
+ */
+static ssize_t FS_TakeLoad( const std::shared_ptr< AsyncLoad > &load, void **buffer )
 {
-	// search through the path, one element at a time
-	for ( searchpath_t *search = fs_searchpaths; search; search = search->next )
+	void   *data   = load->buffer;
+	ssize_t length = data != nullptr ? load->length : -1;
+
+	load->buffer   = nullptr;
+	load->released = true;
+
+	if ( data == nullptr )
 	{
-		// check a file in the directory tree
-		char netpath[ MAX_OSPATH ];
-		Com_sprintf( netpath, sizeof( netpath ), "%s/%s", search->filename, filename );
+		if ( buffer != nullptr )
+			*buffer = nullptr;
 
-		FS_CanonicalisePath( netpath );
+		return length;
+	}
 
-		// first, attempt to open it locally
-		uint32_t fileLength = FS_GetLocalFileLength( netpath );
-		if ( fileLength >= 0 )
-		{
-			FILE *filePtr = fopen( netpath, "rb" );
-			if ( filePtr != nullptr )
-			{
-				/* allocate a buffer and read the whole thing into memory */
-				void *buffer = Z_Malloc( fileLength );
-				fread( buffer, sizeof( uint8_t ), fileLength, filePtr );
+	if ( buffer == nullptr )
+	{
+		FS_FreeLoadBuffer( data, load->cached );
+		return length;
+	}
 
-				fclose( filePtr );
-				*length = fileLength;
+	if ( load->cached )
+		FS_RegisterView( data, FileView::Source::CACHE, length );
 
-				return buffer;
-			}
-		}
+	*buffer = data;
+	return length;
+}
+
+/**
+ * Let go of a load nobody wants anymore. Anything still queued is skipped by
+ * the workers, while anything in flight is freed once it's seen to complete.
+ */
+static void FS_ReleaseLoad( const std::shared_ptr< AsyncLoad > &load )
+{
+	void *buffer = nullptr;
+	{
+		std::lock_guard< std::mutex > lock( fs_asyncMutex );
+		load->released = true;
+		if ( load->state == AsyncLoad::State::QUEUED )
+			load->state = AsyncLoad::State::DONE;
+		else if ( load->state == AsyncLoad::State::DONE )
+			std::swap( buffer, load->buffer );
+	}
+
+	if ( buffer != nullptr )
+		FS_FreeLoadBuffer( buffer, load->cached );
+}
+
+/**
+ * Hand over the result of an earlier FS_Prefetch for the given path, if
+ * there was one, waiting on it if it's still in flight.
+ */
+static void *FS_ClaimPrefetch( const char *path, size_t *length )
+{
+	if ( fs_prefetches.empty() )
+		return nullptr;
+
+	auto i = fs_prefetches.find( chr::StringToLower( path ) );
+	if ( i == fs_prefetches.end() )
+		return nullptr;
+
+	std::shared_ptr< AsyncLoad > load = i->second;
+	fs_prefetches.erase( i );
+
+	if ( load->touch )
+	{
+		// the pages have been faulted in, so it's down to the usual path from here
+		FS_ReleaseLoad( load );
+		return nullptr;
+	}
 
-		// otherwise, load it from one of the anox packages
+	FS_WaitLoad( load );
 
-		/* Anachronox does some horrible path munging to determine which package
-		 * it should be loading from, so we need to grab the first dir here to do the same. */
-		char rootFolder[ 32 ];
-		memset( rootFolder, 0, sizeof( rootFolder ) );
-		const char *p = filename;
-		for ( unsigned int i = 0; i < sizeof( rootFolder ) - 4; ++i )
+	void   *buffer;
+	ssize_t fileLength = FS_TakeLoad( load, &buffer );
+	if ( buffer == nullptr )
+		return nullptr;
+
+	fs_stats.numPrefetchHits++;
+
+	*length = fileLength;
+	return buffer;
+}
+
+fsrequest_t FS_LoadFileAsync( const char *path, fspriority_t priority, fscallback_t callback, void *user )
+{
+	char upath[ MAX_QPATH ];
+	snprintf( upath, sizeof( upath ), "%s", path );
+
+	FS_CanonicalisePath( upath );
+
+	std::shared_ptr< AsyncLoad > load;
+
+	// if it's already been prefetched, take that over rather than loading it twice
+	auto i = fs_prefetches.find( chr::StringToLower( upath ) );
+	if ( i != fs_prefetches.end() && !i->second->touch )
+	{
+		load = i->second;
+		fs_prefetches.erase( i );
+
+		fs_stats.numPrefetchHits++;
+
+		FS_RecordManifestLoad( upath );
+
+		// bump it up the queue, if it's still in there
+		if ( priority > FS_PRIORITY_LOW )
+			FS_QueueLoad( load, priority );
+	}
+	else
+	{
+		load       = std::make_shared< AsyncLoad >();
+		load->path = upath;
+		if ( FS_ResolveLoad( upath, load.get() ) )
 		{
-			if ( *p == '\0' || *p == '/' )
-				break;
+			FS_RecordManifestLoad( upath );
+			FS_QueueLoad( load, priority );
+		}
+		else
+		{
+			Com_DPrintf( "FindFile: can't find %s\n", upath );
+			fs_stats.numMisses++;
 
-			rootFolder[ i ] = *p++;
+			FS_CompleteLoad( load );
 		}
-		p++;
+	}
 
-		// see if we have a match!
-		for ( const auto &i : search->packDirectories )
+	if ( ++fs_asyncHandle == 0 )
+		fs_asyncHandle = 1;
+
+	load->handle   = fs_asyncHandle;
+	load->callback = callback;
+	load->user     = user;
+
+	// already finished and dispatched as a prefetch, so needs dispatching again
+	if ( load->completionTime != 0 && callback != nullptr )
+	{
+		std::lock_guard< std::mutex > lock( fs_asyncMutex );
+		fs_asyncCompleted.push_back( load );
+	}
+
+	fs_asyncLoads.emplace( load->handle, load );
+
+	fs_stats.numAsyncLoads++;
+
+	return load->handle;
+}
+
+bool FS_PollFile( fsrequest_t request, void **buffer, ssize_t *length )
+{
+	auto i = fs_asyncLoads.find( request );
+	if ( i == fs_asyncLoads.end() )
+	{
+		*buffer = nullptr;
+		*length = -1;
+		return true;
+	}
+
+	{
+		std::lock_guard< std::mutex > lock( fs_asyncMutex );
+		if ( i->second->state != AsyncLoad::State::DONE )
+			return false;
+	}
+
+	*length = FS_TakeLoad( i->second, buffer );
+	fs_asyncLoads.erase( i );
+
+	return true;
+}
+
+ssize_t FS_WaitFile( fsrequest_t request, void **buffer )
+{
+	auto i = fs_asyncLoads.find( request );
+	if ( i == fs_asyncLoads.end() )
+	{
+		if ( buffer != nullptr )
+			*buffer = nullptr;
+
+		return -1;
+	}
+
+	FS_WaitLoad( i->second );
+
+	ssize_t length = FS_TakeLoad( i->second, buffer );
+	fs_asyncLoads.erase( i );
+
+	return length;
+}
+
+void FS_CancelFile( fsrequest_t request )
+{
+	auto i = fs_asyncLoads.find( request );
+	if ( i == fs_asyncLoads.end() )
+		return;
+
+	FS_ReleaseLoad( i->second );
+	fs_asyncLoads.erase( i );
+}
+
+bool FS_Prefetch( const char *path )
+{
+	// nothing to be gained from doing it up front
+	if ( Job_GetNumWorkers() == 0 )
+		return false;
+
+	char upath[ MAX_QPATH ];
+	snprintf( upath, sizeof( upath ), "%s", path );
+
+	FS_CanonicalisePath( upath );
+
+	std::string key = chr::StringToLower( upath );
+	if ( fs_prefetches.find( key ) != fs_prefetches.end() )
+		return true;
+
+	// anything missing is left for FS_LoadFile to report
+	auto load  = std::make_shared< AsyncLoad >();
+	load->path = upath;
+	if ( !FS_ResolveLoad( upath, load.get() ) )
+		return false;
+
+	// stored files in a mapped package get handed out as-is by FS_MapFile,
+	// so rather than making a copy, just get the pages faulted in early
+	load->touch = load->package != nullptr && load->package->IsMapped() && load->index->compressedLength == 0;
+
+	fs_prefetches.emplace( key, load );
+	FS_QueueLoad( load, FS_PRIORITY_LOW );
+
+	fs_stats.numPrefetches++;
+
+	return true;
+}
+
+void FS_RunAsyncLoads()
+{
+	std::vector< std::shared_ptr< AsyncLoad > > completed;
+	{
+		std::lock_guard< std::mutex > lock( fs_asyncMutex );
+		completed.swap( fs_asyncCompleted );
+	}
+
+	FS_CheckCacheSize();
+
+	uint64_t now = FS_GetNanoseconds();
+	for ( const auto &load : completed )
+	{
+		if ( load->released )
 		{
-			if ( i.second.mappedDir != rootFolder )
-				continue;
+			// let go of while it was still in flight
+			if ( load->buffer != nullptr )
+			{
+				FS_FreeLoadBuffer( load->buffer, load->cached );
+				load->buffer = nullptr;
+			}
 
-			void *buffer = i.second.LoadFile( p, length );
-			if ( buffer == nullptr )
-				break;
+			continue;
+		}
+
+		load->completionTime = now;
+
+		if ( load->callback == nullptr )
+			continue;
 
-			return buffer;
+		void   *buffer;
+		ssize_t length = FS_TakeLoad( load, &buffer );
+		load->callback( load->path.c_str(), buffer, length, load->user );
+
+		fs_asyncLoads.erase( load->handle );
+	}
+
+	// drop anything that was prefetched but never asked for
+	for ( auto i = fs_prefetches.begin(); i != fs_prefetches.end(); )
+	{
+		if ( i->second->completionTime == 0 || now - i->second->completionTime < FS_PREFETCH_EXPIRY )
+		{
+			++i;
+			continue;
 		}
+
+		FS_ReleaseLoad( i->second );
+		i = fs_prefetches.erase( i );
+
+		fs_stats.numPrefetchesExpired++;
 	}
+}
 
-	Com_DPrintf( "FindFile: can't find %s\n", filename );
+/**
+ * Complete everything that's outstanding, before the search paths
+ * are changed out from under the workers.
+ */
+static void FS_FlushAsyncLoads()
+{
+	for ( const auto &i : fs_prefetches )
+		FS_ReleaseLoad( i.second );
 
-	return nullptr;
+	fs_prefetches.clear();
+
+	for ( const auto &i : fs_asyncLoads )
+		FS_WaitLoad( i.second );
+
+	// and anything that's been let go of, but is still in flight
+	{
+		std::unique_lock< std::mutex > lock( fs_asyncMutex );
+		fs_asyncDone.wait( lock, []()
+		                   { return fs_asyncNumRunning == 0; } );
+	}
+
+	FS_RunAsyncLoads();
 }
 
 /*
-=================
-FS_ReadFile
+============
+FS_LoadFile
 
-Properly handles partial reads
-=================
+Filename are reletive to the quake search path
+a null buffer will just return the file length without loading
+============
 */
-void CDAudio_Stop();
-#define MAX_READ 0x10000// read in blocks of 64k
-void FS_Read( void *buffer, int len, FILE *f )
+ssize_t FS_LoadFile( const char *path, void **buffer )
 {
-	int   block, remaining;
-	int   read;
-	byte *buf;
-	int   tries;
+	PROFILE_ZONE( "FS_LoadFile" );
 
-	buf = ( byte * ) buffer;
+	char upath[ MAX_QPATH ];
+	snprintf( upath, sizeof( upath ), "%s", path );
 
-	// read in chunks for progress bar
-	remaining = len;
-	tries     = 0;
-	while ( remaining )
+	FS_CanonicalisePath( upath );
+
+	// look for it in the filesystem or pack files, unless it's already been prefetched
+	size_t length;
+	void  *buf = FS_ClaimPrefetch( upath, &length );
+	if ( buf == nullptr )
+		buf = FS_FOpenFile( upath, &length );
+
+	if ( buf == nullptr )
 	{
-		block = remaining;
-		if ( block > MAX_READ )
-			block = MAX_READ;
-		read = fread( buf, 1, block, f );
-		if ( read == 0 )
+		if ( buffer != nullptr )
 		{
-			// we might have been trying to read from a CD
-			if ( !tries )
-			{
-				tries = 1;
-				CDAudio_Stop();
-			}
-			else
-				Com_Error( ERR_FATAL, "FS_Read: 0 bytes read" );
+			*buffer = nullptr;
 		}
 
-		if ( read == -1 )
-			Com_Error( ERR_FATAL, "FS_Read: -1 bytes read" );
+		return -1;
+	}
 
-		// do some progress bar thing here...
+	/* retain compat for fetching the length, for now */
+	if ( buffer == nullptr )
+	{
+		FS_FreeFile( buf );
+		return length;
+	}
 
-		remaining -= read;
-		buf += read;
+	FS_RecordManifestLoad( upath );
+
+	*buffer = buf;
+
+	return length;
+}
+
+void FS_FreeFile( void *buffer )
+{
+	// views from FS_MapFile can be let go of here too
+	if ( fs_fileViews.find( buffer ) != fs_fileViews.end() )
+	{
+		FS_UnmapFile( buffer );
+		return;
 	}
+
+	Z_Free( buffer );
 }
 
 /*
 ============
-FS_LoadFile
+FS_MapFile
 
-Filename are reletive to the quake search path
-a null buffer will just return the file length without loading
+Same as FS_LoadFile, but the returned data is read-only and
+may point directly into a mapped package or file, rather
+than being copied. Release it with FS_UnmapFile.
 ============
 */
-ssize_t FS_LoadFile( const char *path, void **buffer )
+ssize_t FS_MapFile( const char *path, const void **buffer )
 {
 	char upath[ MAX_QPATH ];
 	snprintf( upath, sizeof( upath ), "%s", path );
 
 	FS_CanonicalisePath( upath );
 
-	// look for it in the filesystem or pack files
-	size_t length;
-	void  *buf = FS_FOpenFile( upath, &length );
-	if ( buf == nullptr )
+	size_t      length;
+	const void *view = FS_ClaimPrefetch( upath, &length );
+	if ( view == nullptr )
+		view = FS_OpenFile( upath, &length, true );
+	else if ( fs_fileViews.find( view ) == fs_fileViews.end() )
+	{
+		// anything that came out of the cache has been registered already
+		FS_RegisterView( view, FileView::Source::BUFFER, length );
+	}
+
+	if ( view == nullptr )
 	{
 		if ( buffer != nullptr )
 		{
@@ -484,21 +3117,51 @@ ssize_t FS_LoadFile( const char *path, void **buffer )
 		return -1;
 	}
 
-	/* retain compat for fetching the length, for now */
 	if ( buffer == nullptr )
 	{
-		Z_Free( buf );
+		FS_UnmapFile( view );
 		return length;
 	}
 
-	*buffer = buf;
+	FS_RecordManifestLoad( upath );
+
+	*buffer = view;
 
 	return length;
 }
 
-void FS_FreeFile( void *buffer )
+void FS_UnmapFile( const void *buffer )
 {
-	Z_Free( buffer );
+	auto i = fs_fileViews.find( buffer );
+	if ( i == fs_fileViews.end() )
+	{
+		Com_Printf( "WARNING: Attempted to unmap a file that wasn't mapped!\n" );
+		return;
+	}
+
+	// the cache keeps its own count of who's using what
+	if ( i->second.source == FileView::Source::CACHE )
+		fs_fileCache.Release( buffer );
+
+	if ( --i->second.numRefs > 0 )
+		return;
+
+	switch ( i->second.source )
+	{
+		case FileView::Source::PACKAGE:
+			FS_ReleaseBorrowedView( buffer );
+			break;
+		case FileView::Source::CACHE:
+			break;
+		case FileView::Source::LOOSE:
+			FS_UnmapLocalFile( buffer, i->second.length );
+			break;
+		case FileView::Source::BUFFER:
+			Z_Free( ( void * ) buffer );
+			break;
+	}
+
+	fs_fileViews.erase( i );
 }
 
 /*
@@ -544,23 +3207,28 @@ static void FS_AddGameDirectory( const char *dir )
 		std::string packPath = search->filename;
 		packPath += "/" + std::string( defaultPack ) + ".dat";
 
-		FILE *filePtr = fopen( packPath.c_str(), "rb" );
-		if ( filePtr == nullptr )
+		if ( !FS_LocalFileExists( packPath.c_str() ) )
 		{
 			Com_Error( ERR_FATAL, "Failed to find default pack: %s\n", packPath.c_str() );
 			continue;
 		}
 
-		Package package;
-		if ( FS_MountPackage( filePtr, defaultPack, &package ) )
+		/* and the inflated copy of it, e.g. 'anoxdata/cache/battle.inflated' */
+		std::string cachePath;
+		if ( fs_diskcache->value != 0.0f )
 		{
-			/* if it loaded successfully, add it onto the list */
-			package.path = packPath;
-			search->packDirectories.emplace( defaultPack, package );
+			cachePath = std::string( search->filename ) + "/cache/" + defaultPack + ".inflated";
+			if ( !FS_CreatePath( cachePath.data() ) )
+				cachePath.clear();
 		}
 
-		fclose( filePtr );
+		/* packages stay open for as long as they're mounted, so mount in place */
+		auto i = search->packDirectories.try_emplace( defaultPack ).first;
+		if ( !FS_MountPackage( packPath.c_str(), defaultPack, fs_mmap->value != 0.0f, cachePath.empty() ? nullptr : cachePath.c_str(), &i->second ) )
+			search->packDirectories.erase( i );
 	}
+
+	FS_BuildPackedFileTable();
 }
 
 /*
@@ -618,13 +3286,21 @@ void FS_SetGamedir( const char *dir )
 	//
 	// free up any current game dir info
 	//
+	FS_FlushAsyncLoads();
+	fs_fileCache.Clear();
+
 	while ( fs_searchpaths != fs_base_searchpaths )
 	{
+		// anything still reading from the packages keeps them alive
+		FS_RetirePackages( fs_searchpaths );
+
 		next = fs_searchpaths->next;
-		Z_Free( fs_searchpaths );
+		delete fs_searchpaths;
 		fs_searchpaths = next;
 	}
 
+	FS_BuildPackedFileTable();
+
 	//
 	// flush all data, so it will be forced to reload
 	//
@@ -760,7 +3436,7 @@ void FS_Path_f()
 
 		Com_Printf( "Packages:\n" );
 		for ( const auto &i : s->packDirectories )
-			Com_Printf( " %s\n", i.second.mappedDir.c_str() );
+			Com_Printf( " %s%s\n", i.second.mappedDir.c_str(), i.second.IsMapped() ? " (mapped)" : "" );
 	}
 }
 
@@ -808,51 +3484,557 @@ bool FS_WriteFile( const char *filename, void *data, uint32_t length )
 		return false;
 	}
 
-	if ( fwrite( data, length, 1, file ) != 1 )
+	bool status = true;
+	if ( length > 0 && fwrite( data, length, 1, file ) != 1 )
+	{
 		Com_Printf( "Failed to write %s\n", upath );
+		status = false;
+	}
+
+	if ( fclose( file ) != 0 )
+		status = false;
+
+	return status;
+}
+
+/**
+ * Print the top few loads from the trace, ordered by the given comparison.
+ */
+template< typename COMPARE >
+static void FS_PrintTopLoads( std::vector< LoadRecord > &records, size_t count, COMPARE compare )
+{
+	count = std::min( count, records.size() );
+	std::partial_sort( records.begin(), records.begin() + count, records.end(), compare );
+	for ( size_t i = 0; i < count; ++i )
+	{
+		const LoadRecord &record = records[ i ];
+		Com_Printf( "  %8.3fms io %8.3fms inflate %10.2fKB  %-8s %s%s\n",
+		            record.ioTime / 1000000.0,
+		            record.inflateTime / 1000000.0,
+		            record.length / 1024.0,
+		            FS_GetLoadSourceName( record.source ),
+		            record.path.c_str(),
+		            record.async ? " (async)" : "" );
+	}
+}
+
+/**
+ * Summarise the load trace; the slowest and largest loads, and the totals
+ * for each package or directory.
+ */
+static void FS_PrintLoadTrace( size_t count )
+{
+	std::vector< LoadRecord > records;
+	uint64_t                  numDropped;
+	{
+		std::lock_guard< std::mutex > lock( fs_traceMutex );
+		records    = fs_loadRecords;
+		numDropped = fs_numDroppedRecords;
+	}
+
+	struct Totals
+	{
+		size_t   numLoads{ 0 };
+		uint64_t numBytes{ 0 };
+		uint64_t ioTime{ 0 };
+		uint64_t inflateTime{ 0 };
+	};
+
+	Totals                                  total;
+	std::unordered_map< std::string, Totals > origins;
+	for ( const LoadRecord &record : records )
+	{
+		for ( Totals *totals : { &total, &origins[ record.origin ] } )
+		{
+			totals->numLoads++;
+			totals->numBytes += record.length;
+			totals->ioTime += record.ioTime;
+			totals->inflateTime += record.inflateTime;
+		}
+	}
+
+	Com_Printf( "Load trace: %zu loads (%llu dropped), %.2fMB, %.3fms io, %.3fms inflate\n",
+	            total.numLoads,
+	            ( unsigned long long ) numDropped,
+	            total.numBytes / ( 1024.0 * 1024.0 ),
+	            total.ioTime / 1000000.0,
+	            total.inflateTime / 1000000.0 );
+	if ( records.empty() )
+		return;
+
+	Com_Printf( "Slowest:\n" );
+	FS_PrintTopLoads( records, count, []( const LoadRecord &a, const LoadRecord &b )
+	                  { return ( a.ioTime + a.inflateTime ) > ( b.ioTime + b.inflateTime ); } );
+	Com_Printf( "Largest:\n" );
+	FS_PrintTopLoads( records, count, []( const LoadRecord &a, const LoadRecord &b )
+	                  { return a.length > b.length; } );
+
+	std::vector< std::pair< std::string, Totals > > sortedOrigins( origins.begin(), origins.end() );
+	std::sort( sortedOrigins.begin(), sortedOrigins.end(), []( const auto &a, const auto &b )
+	           { return ( a.second.ioTime + a.second.inflateTime ) > ( b.second.ioTime + b.second.inflateTime ); } );
+
+	Com_Printf( "By source:\n" );
+	for ( const auto &i : sortedOrigins )
+	{
+		Com_Printf( "  %6zu loads %10.2fMB %10.3fms io %10.3fms inflate  %s\n",
+		            i.second.numLoads,
+		            i.second.numBytes / ( 1024.0 * 1024.0 ),
+		            i.second.ioTime / 1000000.0,
+		            i.second.inflateTime / 1000000.0,
+		            i.first.c_str() );
+	}
+}
+
+/*
+================
+FS_Stats_f
+
+Usage: fs_stats [count|clear]
+================
+*/
+static void FS_Stats_f()
+{
+	if ( Cmd_Argc() > 1 && Q_strcasecmp( Cmd_Argv( 1 ), "clear" ) == 0 )
+	{
+		FS_ClearLoadTrace();
+		Com_Printf( "Cleared the load trace.\n" );
+		return;
+	}
+
+	const FileStats &stats = fs_stats;
+
+	Com_Printf( "Merged file table: %zu files, %zu buckets (built in %.2fms)\n",
+	            fs_packedFiles.size(), fs_packedFileLookup.GetCapacity(), stats.buildTime / 1000000.0 );
+	Com_Printf( "Lookups: %llu (%llu packed, %llu loose, %llu missed)\n",
+	            ( unsigned long long ) stats.numLookups,
+	            ( unsigned long long ) stats.numHits,
+	            ( unsigned long long ) stats.numLooseHits,
+	            ( unsigned long long ) stats.numMisses );
+	Com_Printf( "Lookup time: %.3fms total, %.3fus average\n",
+	            stats.lookupTime / 1000000.0,
+	            stats.numLookups > 0 ? ( stats.lookupTime / ( double ) stats.numLookups ) / 1000.0 : 0.0 );
+	Com_Printf( "Package reads: %llu mapped (%.2fMB), %llu positioned (%.2fMB)\n",
+	            ( unsigned long long ) stats.numMappedReads, stats.bytesMapped / ( 1024.0 * 1024.0 ),
+	            ( unsigned long long ) stats.numPositionedReads, stats.bytesRead / ( 1024.0 * 1024.0 ) );
+	Com_Printf( "Inflated cache: %llu reads (%.2fMB), %llu writes (%.2fMB), %llu bad\n",
+	            ( unsigned long long ) stats.numInflatedReads, stats.bytesInflatedRead / ( 1024.0 * 1024.0 ),
+	            ( unsigned long long ) stats.numInflatedWrites, stats.bytesInflatedWritten / ( 1024.0 * 1024.0 ),
+	            ( unsigned long long ) stats.numInflatedBad );
+	Com_Printf( "Async loads: %llu requested, %zu outstanding, %u workers\n",
+	            ( unsigned long long ) stats.numAsyncLoads, fs_asyncLoads.size(), Job_GetNumWorkers() );
+	Com_Printf( "Prefetches: %llu issued, %llu claimed, %llu expired, %zu pending\n",
+	            ( unsigned long long ) stats.numPrefetches,
+	            ( unsigned long long ) stats.numPrefetchHits,
+	            ( unsigned long long ) stats.numPrefetchesExpired,
+	            fs_prefetches.size() );
+	Com_Printf( "Main thread: %llu loads taken over, %.3fms waiting on workers\n",
+	            ( unsigned long long ) stats.numStolenLoads, stats.waitTime / 1000000.0 );
+
+	int count = ( Cmd_Argc() > 1 ) ? atoi( Cmd_Argv( 1 ) ) : 10;
+	FS_PrintLoadTrace( ( size_t ) std::max( count, 0 ) );
+}
+
+/**
+ * Write the given string out with anything that would upset JSON or CSV escaped.
+ */
+static void FS_WriteQuotedString( FILE *file, const std::string &string, bool json )
+{
+	fputc( '"', file );
+	for ( char c : string )
+	{
+		if ( c == '"' )
+			fputs( json ? "\\\"" : "\"\"", file );
+		else if ( c == '\\' && json )
+			fputs( "\\\\", file );
+		else
+			fputc( c, file );
+	}
+	fputc( '"', file );
+}
+
+/*
+================
+FS_TraceDump_f
+
+Writes the load trace out under the game directory, as JSON if the
+name ends in .json and CSV otherwise
+================
+*/
+static void FS_TraceDump_f()
+{
+	if ( Cmd_Argc() != 2 )
+	{
+		Com_Printf( "Usage: fs_tracedump <filename>\n" );
+		return;
+	}
+
+	char path[ MAX_OSPATH ];
+	Com_sprintf( path, sizeof( path ), "%s/%s", FS_Gamedir(), Cmd_Argv( 1 ) );
+	if ( !FS_CreatePath( path ) )
+		return;
+
+	FILE *file = fopen( path, "w" );
+	if ( file == nullptr )
+	{
+		Com_Printf( "WARNING: Failed to open \"%s\" for writing!\n", path );
+		return;
+	}
+
+	std::vector< LoadRecord > records;
+	{
+		std::lock_guard< std::mutex > lock( fs_traceMutex );
+		records = fs_loadRecords;
+	}
+
+	size_t length = strlen( path );
+	bool   json   = ( length > 5 && Q_strcasecmp( path + length - 5, ".json" ) == 0 );
+	if ( json )
+		fputs( "[\n", file );
+	else
+		fputs( "path,origin,source,async,compressed_bytes,bytes,start_us,io_us,inflate_us\n", file );
+
+	for ( size_t i = 0; i < records.size(); ++i )
+	{
+		const LoadRecord &record = records[ i ];
+		if ( json )
+		{
+			fputs( "\t{ \"path\": ", file );
+			FS_WriteQuotedString( file, record.path, true );
+			fputs( ", \"origin\": ", file );
+			FS_WriteQuotedString( file, record.origin, true );
+			fprintf( file, ", \"source\": \"%s\", \"async\": %s, \"compressed_bytes\": %zu, \"bytes\": %zu, "
+			               "\"start_us\": %.3f, \"io_us\": %.3f, \"inflate_us\": %.3f }%s\n",
+			         FS_GetLoadSourceName( record.source ),
+			         record.async ? "true" : "false",
+			         record.compressedLength,
+			         record.length,
+			         record.startTime / 1000.0,
+			         record.ioTime / 1000.0,
+			         record.inflateTime / 1000.0,
+			         ( i + 1 < records.size() ) ? "," : "" );
+		}
+		else
+		{
+			FS_WriteQuotedString( file, record.path, false );
+			fputc( ',', file );
+			FS_WriteQuotedString( file, record.origin, false );
+			fprintf( file, ",%s,%d,%zu,%zu,%.3f,%.3f,%.3f\n",
+			         FS_GetLoadSourceName( record.source ),
+			         record.async ? 1 : 0,
+			         record.compressedLength,
+			         record.length,
+			         record.startTime / 1000.0,
+			         record.ioTime / 1000.0,
+			         record.inflateTime / 1000.0 );
+		}
+	}
+
+	if ( json )
+		fputs( "]\n", file );
 
 	fclose( file );
 
-	return true;
+	Com_Printf( "Wrote %zu loads to \"%s\"\n", records.size(), path );
+}
+
+/**
+ * Run the given function for every index in [0, count) as jobs. Blocks
+ * until they're all done, calling report with the number completed so far
+ * every so often.
+ */
+template< typename FUNCTION, typename REPORT >
+static void FS_ParallelFor( size_t count, FUNCTION function, REPORT report )
+{
+	std::atomic< size_t > numDone{ 0 };
+
+	auto counted = [ & ]( size_t i )
+	{
+		function( i );
+		numDone++;
+	};
+
+	jobcounter_t counter;
+	Job_SubmitParallelFor( 0, count, counted, &counter );
+	while ( !Job_Wait( &counter, 500 ) )
+		report( numDone.load() );
 }
 
 /*
 ================
-ExtractCommand
+FS_BuildCache_f
 
-Extracts all the packages in the search path
+Inflates everything that's not already in the inflated cache
 ================
 */
-static void ExtractCommand()
+static void FS_BuildCache_f()
 {
-	for ( searchpath_t *s = fs_searchpaths; s; s = s->next )
+	if ( fs_diskcache->value == 0.0f )
 	{
-		for ( const auto &i : s->packDirectories )
+		Com_Printf( "The inflated cache is disabled, start with \"+set fs_diskcache 1\" to use it.\n" );
+		return;
+	}
+
+	std::vector< std::pair< const Package *, const Package::Index * > > entries;
+
+	size_t numBytes = 0;
+	for ( const searchpath_t *search = fs_searchpaths; search; search = search->next )
+	{
+		for ( const auto &i : search->packDirectories )
 		{
-			Com_Printf( "Extracting from %s\n", i.second.mappedDir.c_str() );
-			for ( const auto &j : i.second.indices )
+			const Package &package = i.second;
+			if ( !package.inflatedCache.IsOpen() )
+				continue;
+
+			for ( size_t j = 0; j < package.indices.size(); ++j )
 			{
-				size_t fileSize;
-				void  *p = i.second.LoadFile( j.name, &fileSize );
-				if ( p == nullptr )
-				{
-					Com_Printf( "Failed to load %s\n", j.name );
+				const Package::Index &index = package.indices[ j ];
+				if ( index.compressedLength == 0 || package.inflatedCache.IsPresent( j ) )
 					continue;
-				}
 
-				char path[ MAX_OSPATH ];
-				snprintf( path, sizeof( path ), "%s/extracted/%s/%s", FS_Gamedir(), i.second.mappedDir.c_str(), j.name );
-				if ( !FS_CreatePath( path ) )
-					continue;
+				entries.emplace_back( &package, &index );
+				numBytes += index.length;
+			}
+		}
+	}
+
+	if ( entries.empty() )
+	{
+		Com_Printf( "Inflated cache is already up to date.\n" );
+		return;
+	}
 
-				FS_WriteFile( path, p, fileSize );
+	Com_Printf( "Inflating %zu entries (%.2fMB)...\n", entries.size(), numBytes / ( 1024.0 * 1024.0 ) );
+
+	uint64_t startTime = FS_GetNanoseconds();
+
+	// loading an entry is enough to get it into the cache
+	std::atomic< size_t > numFailed{ 0 };
+	FS_ParallelFor(
+	        entries.size(), [ & ]( size_t i )
+	        {
+		        size_t length;
+		        void  *data = entries[ i ].first->LoadFile( entries[ i ].second, &length );
+		        if ( data == nullptr )
+		        {
+			        numFailed++;
+			        return;
+		        }
+
+		        Z_Free( data );
+	        },
+	        [ & ]( size_t numDone )
+	        { Com_Printf( "Inflating: %zu/%zu\n", numDone, entries.size() ); } );
+
+	Com_Printf( "Done in %.2fs, %zu failed\n", ( FS_GetNanoseconds() - startTime ) / 1000000000.0, numFailed.load() );
+}
 
-				Z_Free( p );
-			}
+/*
+================
+FS_CacheStats_f
+================
+*/
+static void FS_CacheStats_f()
+{
+	FS_CheckCacheSize();
+
+	FileCache::Stats stats = fs_fileCache.GetStats();
+
+	uint64_t numRequests = stats.numHits + stats.numMisses;
+	Com_Printf( "File cache: %zu entries, %.2fMB resident (%.2fMB pinned), %.2fMB budget\n",
+	            stats.numEntries,
+	            stats.residentBytes / ( 1024.0 * 1024.0 ),
+	            stats.pinnedBytes / ( 1024.0 * 1024.0 ),
+	            stats.budget / ( 1024.0 * 1024.0 ) );
+	Com_Printf( "Hits: %llu, misses: %llu (%.1f%% hit rate), evictions: %llu\n",
+	            ( unsigned long long ) stats.numHits,
+	            ( unsigned long long ) stats.numMisses,
+	            numRequests > 0 ? ( stats.numHits * 100.0 ) / numRequests : 0.0,
+	            ( unsigned long long ) stats.numEvictions );
+}
+
+/**
+ * Case-insensitive wildcard match, supporting '*' and '?'.
+ */
+static bool FS_MatchWildcard( const char *pattern, const char *text )
+{
+	const char *starPattern = nullptr;
+	const char *starText    = nullptr;
+	while ( *text != '\0' )
+	{
+		if ( *pattern == '*' )
+		{
+			starPattern = ++pattern;
+			starText    = text;
+		}
+		else if ( *pattern != '\0' && ( *pattern == '?' || tolower( ( unsigned char ) *pattern ) == tolower( ( unsigned char ) *text ) ) )
+		{
+			pattern++;
+			text++;
+		}
+		else if ( starPattern != nullptr )
+		{
+			// let the last star swallow one more character and try again
+			pattern = starPattern;
+			text    = ++starText;
+		}
+		else
+			return false;
+	}
+
+	while ( *pattern == '*' )
+		pattern++;
+
+	return ( *pattern == '\0' );
+}
+
+/**
+ * Caps the number of bytes held at once across a set of threads. A request
+ * larger than the whole budget is let through once nothing else is held.
+ */
+class ByteBudget
+{
+public:
+	explicit ByteBudget( size_t capacity ) : capacity_( capacity ) {}
+
+	void Acquire( size_t numBytes )
+	{
+		std::unique_lock< std::mutex > lock( mutex_ );
+		released_.wait( lock, [ & ]()
+		                { return inUse_ == 0 || inUse_ + numBytes <= capacity_; } );
+		inUse_ += numBytes;
+	}
+
+	void Release( size_t numBytes )
+	{
+		{
+			std::lock_guard< std::mutex > lock( mutex_ );
+			inUse_ -= numBytes;
 		}
+		released_.notify_all();
+	}
+
+private:
+	std::mutex              mutex_;
+	std::condition_variable released_;
+	size_t                  capacity_;
+	size_t                  inUse_{ 0 };
+};
+
+/*
+================
+ExtractCommand
+
+Extracts the mounted packages, optionally limited to the given package
+and entries matching the given pattern, e.g. "extract models *.md2"
+================
+*/
+static void ExtractCommand()
+{
+	const char *packageFilter = ( Cmd_Argc() > 1 ) ? Cmd_Argv( 1 ) : "*";
+	const char *entryFilter   = ( Cmd_Argc() > 2 ) ? Cmd_Argv( 2 ) : "*";
+
+	// only the copy that wins in the search order is extracted, otherwise
+	// overridden entries would be fighting over the same destination
+	std::vector< const PackedFile * > files;
+
+	uint64_t totalBytes = 0;
+	for ( const PackedFile &file : fs_packedFiles )
+	{
+		if ( !FS_MatchWildcard( packageFilter, file.package->mappedDir.c_str() ) || !FS_MatchWildcard( entryFilter, file.index->name ) )
+			continue;
+
+		files.push_back( &file );
+		totalBytes += file.index->length;
+	}
+
+	if ( files.empty() )
+	{
+		Com_Printf( "No entries match \"%s\" in \"%s\"\n", entryFilter, packageFilter );
+		return;
 	}
 
-	Com_Printf( "Done\n" );
+	// keep the reads within each package roughly sequential
+	std::sort( files.begin(), files.end(), []( const PackedFile *a, const PackedFile *b )
+	           {
+		           if ( a->package != b->package )
+			           return a->package < b->package;
+		           return a->index->offset < b->index->offset; } );
+
+	Com_Printf( "Extracting %zu files (%.2fMB)...\n", files.size(), totalBytes / ( 1024.0 * 1024.0 ) );
+
+	ByteBudget budget( ( size_t ) std::max( fs_extractmemory->value, 1.0f ) * 1024 * 1024 );
+
+	std::string baseDir = std::string( FS_Gamedir() ) + "/extracted/";
+
+	std::atomic< uint64_t >    bytesWritten{ 0 };
+	std::mutex                 failureMutex;
+	std::vector< std::string > failures;
+
+	uint64_t startTime = FS_GetNanoseconds();
+
+	FS_ParallelFor(
+	        files.size(), [ & ]( size_t i )
+	        {
+		        const Package        &package = *files[ i ]->package;
+		        const Package::Index &index   = *files[ i ]->index;
+
+		        // compressed entries have both copies around while being inflated
+		        size_t footprint = index.length + index.compressedLength;
+		        budget.Acquire( footprint );
+
+		        char path[ MAX_OSPATH ];
+		        snprintf( path, sizeof( path ), "%s%s/%s", baseDir.c_str(), package.mappedDir.c_str(), index.name );
+
+		        const char *failure = nullptr;
+
+		        // stored entries get written straight out of the mapping
+		        size_t      length;
+		        bool        borrowed;
+		        const void *data = package.MapFile( &index, &length, &borrowed );
+		        if ( data == nullptr )
+			        failure = "failed to load";
+		        else if ( !FS_CreatePath( path ) )
+			        failure = "failed to create path";
+		        else if ( !FS_WriteFile( path, ( void * ) data, length ) )
+			        failure = "failed to write";
+		        else
+			        bytesWritten += length;
+
+		        if ( data != nullptr && !borrowed )
+			        Z_Free( ( void * ) data );
+
+		        budget.Release( footprint );
+
+		        if ( failure != nullptr )
+		        {
+			        std::lock_guard< std::mutex > lock( failureMutex );
+			        failures.push_back( package.mappedDir + "/" + index.name + ": " + failure );
+		        }
+	        },
+	        [ & ]( size_t numDone )
+	        {
+		        double seconds = ( FS_GetNanoseconds() - startTime ) / 1000000000.0;
+		        Com_Printf( "Extracting: %zu/%zu (%.2fMB/s)\n", numDone, files.size(), ( bytesWritten / ( 1024.0 * 1024.0 ) ) / seconds );
+	        } );
+
+	double seconds = ( FS_GetNanoseconds() - startTime ) / 1000000000.0;
+	Com_Printf( "Extracted %zu files (%.2fMB) in %.2fs, %.2fMB/s\n",
+	            files.size() - failures.size(),
+	            bytesWritten / ( 1024.0 * 1024.0 ),
+	            seconds,
+	            seconds > 0.0 ? ( bytesWritten / ( 1024.0 * 1024.0 ) ) / seconds : 0.0 );
+
+	if ( failures.empty() )
+		return;
+
+	static constexpr size_t MAX_LISTED_FAILURES = 32;
+
+	std::sort( failures.begin(), failures.end() );
+	Com_Printf( "WARNING: %zu files failed to extract:\n", failures.size() );
+	for ( size_t i = 0; i < failures.size() && i < MAX_LISTED_FAILURES; ++i )
+		Com_Printf( "  %s\n", failures[ i ].c_str() );
+	if ( failures.size() > MAX_LISTED_FAILURES )
+		Com_Printf( "  ...and %zu more\n", failures.size() - MAX_LISTED_FAILURES );
 }
 
 /*
@@ -862,9 +4044,15 @@ FS_InitFilesystem
 */
 void FS_InitFilesystem()
 {
+	FS_ClearLoadTrace();
+
 	Cmd_AddCommand( "path", FS_Path_f );
 	Cmd_AddCommand( "dir", FS_Dir_f );
 	Cmd_AddCommand( "extract", ExtractCommand );
+	Cmd_AddCommand( "fs_stats", FS_Stats_f );
+	Cmd_AddCommand( "fs_tracedump", FS_TraceDump_f );
+	Cmd_AddCommand( "fs_cachestats", FS_CacheStats_f );
+	Cmd_AddCommand( "fs_buildcache", FS_BuildCache_f );
 
 	//
 	// basedir <path>
@@ -878,6 +4066,38 @@ void FS_InitFilesystem()
 	// allows the game to run from outside the data tree
 	//
 	fs_cddir = Cvar_Get( "cddir", "", CVAR_NOSET );
+
+	//
+	// fs_mmap <0/1>
+	// packages are memory mapped by default, falling back to reads if that fails
+	//
+	fs_mmap = Cvar_Get( "fs_mmap", "1", CVAR_NOSET );
+
+	//
+	// fs_cachesize <megabytes>
+	// budget for keeping decompressed package entries around, 0 disables
+	//
+	fs_cachesize = Cvar_Get( "fs_cachesize", "64", CVAR_ARCHIVE );
+	FS_CheckCacheSize();
+
+	//
+	// fs_diskcache <0/1>
+	// keeps inflated copies of the packages under the game directory, to skip decompression
+	//
+	fs_diskcache = Cvar_Get( "fs_diskcache", "0", CVAR_NOSET );
+
+	//
+	// fs_extractmemory <megabytes>
+	// cap on how much data the extract command holds in memory at once
+	//
+	fs_extractmemory = Cvar_Get( "fs_extractmemory", "256", 0 );
+
+	//
+	// fs_manifests <0/1>
+	// records what each map loads on startup, so it can be prefetched next time
+	//
+	fs_manifests = Cvar_Get( "fs_manifests", "1", CVAR_ARCHIVE );
+
 	if ( fs_cddir->string[ 0 ] )
 		FS_AddGameDirectory( va( "%s/" BASEDIRNAME, fs_cddir->string ) );
 
@@ -894,3 +4114,28 @@ void FS_InitFilesystem()
 	if ( fs_gamedirvar->string[ 0 ] )
 		FS_SetGamedir( fs_gamedirvar->string );
 }
+
+/*
+================
+FS_Shutdown
+================
+*/
+void FS_Shutdown()
+{
+	// nothing's going to come for these now
+	for ( const auto &i : fs_prefetches )
+		FS_ReleaseLoad( i.second );
+	for ( const auto &i : fs_asyncLoads )
+		FS_ReleaseLoad( i.second );
+
+	fs_prefetches.clear();
+	fs_asyncLoads.clear();
+
+	// anything released that's still queued is skipped, so this won't be long
+	Job_Wait( &fs_asyncJobs );
+
+	// free up anything that finished in the meantime
+	FS_RunAsyncLoads();
+
+	fs_fileCache.Clear();
+}
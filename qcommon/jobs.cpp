@@ -0,0 +1,423 @@
+/******************************************************************************
+	Copyright © 2020-2025 Mark E Sowden <hogsy@oldtimes-software.com>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+******************************************************************************/
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "qcommon.h"
+
+/*
+==============================================================================
+
+JOBS
+
+A fixed pool of workers, sized to the machine unless com_workers says
+otherwise. Every worker, plus the main thread, has its own queue; jobs
+are pushed onto and taken off the back of the thread's own queue, while
+anyone that's run out of work steals from the front of someone else's.
+Anything waiting on jobs to finish runs jobs in the meantime.
+
+Jobs that depend on a counter that hasn't reached zero yet are parked
+until it does, and then queued by whoever finished the last job on it.
+
+Background jobs sit in a queue of their own, first come first served,
+which the workers only turn to once there's nothing else. The main thread
+never takes them, so it's not held up by them while waiting on its own.
+
+With no workers, jobs are just run as they're submitted.
+
+==============================================================================
+*/
+
+static constexpr unsigned int JOB_QUEUE_SIZE  = 1024;// per thread, anything past that is run there and then
+static constexpr unsigned int JOB_MAX_WORKERS = 63;
+static constexpr unsigned int JOB_SPIN_COUNT  = 64;  // tries for more work before a worker goes to sleep
+
+struct QueuedJob
+{
+	job_t               job;
+	jobcounter_t       *counter;
+	const jobcounter_t *dependency;
+};
+
+struct JobQueue
+{
+	std::mutex   mutex;
+	QueuedJob    jobs[ JOB_QUEUE_SIZE ];
+	unsigned int head{ 0 };// the next to steal
+	unsigned int size{ 0 };
+
+	std::atomic< unsigned int > numRun{ 0 };
+	std::atomic< unsigned int > numStolen{ 0 };
+
+	bool Push( const QueuedJob &job )
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		if ( size == JOB_QUEUE_SIZE )
+			return false;
+
+		jobs[ ( head + size++ ) % JOB_QUEUE_SIZE ] = job;
+		return true;
+	}
+
+	bool PopBack( QueuedJob *job )
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		if ( size == 0 )
+			return false;
+
+		*job = jobs[ ( head + --size ) % JOB_QUEUE_SIZE ];
+		return true;
+	}
+
+	bool PopFront( QueuedJob *job )
+	{
+		std::lock_guard< std::mutex > lock( mutex );
+		if ( size == 0 )
+			return false;
+
+		*job = jobs[ head ];
+		head = ( head + 1 ) % JOB_QUEUE_SIZE;
+		size--;
+		return true;
+	}
+};
+
+static cvar_t *com_workers;
+
+static std::vector< std::thread > job_workers;
+static JobQueue                  *job_queues;// main thread first, then each worker
+static unsigned int               job_numQueues;
+
+static std::atomic< unsigned int > job_numQueued{ 0 };
+static std::atomic< unsigned int > job_numSleeping{ 0 };
+static std::atomic< unsigned int > job_nextExternal{ 0 };
+static std::atomic< bool >         job_shutdown{ false };
+static std::mutex                  job_sleepMutex;
+static std::condition_variable     job_wake;
+
+static std::deque< QueuedJob > job_background;
+static std::mutex              job_backgroundMutex;
+
+static std::vector< QueuedJob >    job_parked;// waiting on a dependency
+static std::atomic< unsigned int > job_numParked{ 0 };
+static std::mutex                  job_parkedMutex;
+
+static thread_local int job_threadQueue = -1;// the calling thread's own queue, if it has one
+
+unsigned int Job_GetNumWorkers()
+{
+	return ( unsigned int ) job_workers.size();
+}
+
+static void Job_Queue( const QueuedJob &job );
+
+static void Job_Run( const QueuedJob &job, JobQueue *queue )
+{
+	{
+		PROFILE_ZONE( "Job" );
+		job.job.func( job.job.data, job.job.begin, job.job.end );
+	}
+	if ( queue != nullptr )
+		queue->numRun.fetch_add( 1, std::memory_order_relaxed );
+
+	// nothing can touch the counter past this point, as whoever's waiting on it may be gone
+	if ( job.counter->count.fetch_sub( 1 ) != 1 || job_numParked.load() == 0 )
+		return;
+
+	std::vector< QueuedJob > ready;
+	{
+		std::lock_guard< std::mutex > lock( job_parkedMutex );
+		for ( auto i = job_parked.begin(); i != job_parked.end(); )
+		{
+			if ( i->dependency->count.load() != 0 )
+			{
+				++i;
+				continue;
+			}
+
+			ready.push_back( *i );
+			i = job_parked.erase( i );
+			job_numParked--;
+		}
+	}
+
+	for ( const QueuedJob &i : ready )
+		Job_Queue( i );
+}
+
+static void Job_Queue( const QueuedJob &job )
+{
+	if ( job_numQueues == 0 )
+	{
+		Job_Run( job, nullptr );
+		return;
+	}
+
+	// threads outside of the pool spread what they submit around
+	unsigned int index = ( job_threadQueue >= 0 ) ? job_threadQueue : ( job_nextExternal++ % job_numQueues );
+
+	// counted first, so it can't be taken off before it's been counted
+	job_numQueued++;
+	if ( !job_queues[ index ].Push( job ) )
+	{
+		job_numQueued--;
+		Job_Run( job, &job_queues[ index ] );
+		return;
+	}
+
+	if ( job_numSleeping.load() > 0 )
+	{
+		// taking the lock means a worker that's about to sleep will see this first
+		{ std::lock_guard< std::mutex > lock( job_sleepMutex ); }
+		job_wake.notify_one();
+	}
+}
+
+void Job_Submit( const job_t &job, jobcounter_t *counter, const jobcounter_t *dependency )
+{
+	counter->count++;
+
+	QueuedJob queued = { job, counter, dependency };
+	if ( dependency != nullptr && dependency->count.load() != 0 )
+	{
+		std::lock_guard< std::mutex > lock( job_parkedMutex );
+
+		// check again now that whoever finishes it has to wait on the lock
+		job_numParked++;
+		if ( dependency->count.load() != 0 )
+		{
+			job_parked.push_back( queued );
+			return;
+		}
+		job_numParked--;
+	}
+
+	Job_Queue( queued );
+}
+
+void Job_SubmitBackground( const job_t &job, jobcounter_t *counter )
+{
+	counter->count++;
+
+	QueuedJob queued = { job, counter, nullptr };
+	if ( job_numQueues == 0 )
+	{
+		Job_Run( queued, nullptr );
+		return;
+	}
+
+	job_numQueued++;
+	{
+		std::lock_guard< std::mutex > lock( job_backgroundMutex );
+		job_background.push_back( queued );
+	}
+
+	if ( job_numSleeping.load() > 0 )
+	{
+		{ std::lock_guard< std::mutex > lock( job_sleepMutex ); }
+		job_wake.notify_one();
+	}
+}
+
+/**
+ * Runs one job, from the calling thread's own queue if it has one,
+ * otherwise whatever it can steal. Returns false if there was nothing to do.
+ */
+static bool Job_RunOne()
+{
+	if ( job_numQueues == 0 || job_numQueued.load() == 0 )
+		return false;
+
+	QueuedJob job;
+	JobQueue *own = ( job_threadQueue >= 0 ) ? &job_queues[ job_threadQueue ] : nullptr;
+	if ( own != nullptr && own->PopBack( &job ) )
+	{
+		job_numQueued--;
+		Job_Run( job, own );
+		return true;
+	}
+
+	unsigned int start = ( job_threadQueue >= 0 ) ? job_threadQueue + 1 : 0;
+	for ( unsigned int i = 0; i < job_numQueues; ++i )
+	{
+		JobQueue &victim = job_queues[ ( start + i ) % job_numQueues ];
+		if ( &victim == own || !victim.PopFront( &job ) )
+			continue;
+
+		job_numQueued--;
+		if ( own != nullptr )
+			own->numStolen.fetch_add( 1, std::memory_order_relaxed );
+		Job_Run( job, own );
+		return true;
+	}
+
+	if ( job_threadQueue <= 0 )
+		return false;
+
+	{
+		std::lock_guard< std::mutex > lock( job_backgroundMutex );
+		if ( job_background.empty() )
+			return false;
+
+		job = job_background.front();
+		job_background.pop_front();
+	}
+
+	job_numQueued--;
+	Job_Run( job, own );
+	return true;
+}
+
+bool Job_Wait( jobcounter_t *counter, unsigned int timeout )
+{
+	auto         deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds( timeout );
+	unsigned int numIdle  = 0;
+	while ( counter->count.load() != 0 )
+	{
+		if ( timeout > 0 && std::chrono::steady_clock::now() >= deadline )
+			return false;
+
+		if ( Job_RunOne() )
+		{
+			numIdle = 0;
+			continue;
+		}
+
+		// whatever's left is already being run, so give it a moment
+		if ( ++numIdle < JOB_SPIN_COUNT )
+			std::this_thread::yield();
+		else
+			std::this_thread::sleep_for( std::chrono::microseconds( 100 ) );
+	}
+
+	return true;
+}
+
+static void Job_Worker( int queue )
+{
+	job_threadQueue = queue;
+	Prof_SetThreadName( va( "worker %d", queue ) );
+
+	unsigned int numIdle = 0;
+	while ( true )
+	{
+		if ( Job_RunOne() )
+		{
+			numIdle = 0;
+			continue;
+		}
+
+		if ( ++numIdle < JOB_SPIN_COUNT )
+		{
+			std::this_thread::yield();
+			continue;
+		}
+
+		std::unique_lock< std::mutex > lock( job_sleepMutex );
+		job_numSleeping++;
+		job_wake.wait( lock, []()
+		               { return job_numQueued.load() > 0 || job_shutdown.load(); } );
+		job_numSleeping--;
+
+		if ( job_shutdown.load() && job_numQueued.load() == 0 )
+			return;
+
+		numIdle = 0;
+	}
+}
+
+void Job_Init()
+{
+	//
+	// com_workers <n>
+	// threads kept around for running jobs, -1 picks based on the number of cores
+	//
+#ifdef DEDICATED_ONLY
+	com_workers = Cvar_Get( "com_workers", "0", CVAR_NOSET );
+#else
+	com_workers = Cvar_Get( "com_workers", "-1", CVAR_NOSET );
+#endif
+
+	int numWorkers = ( int ) com_workers->value;
+	if ( numWorkers < 0 )
+	{
+		// the main thread takes part too
+		numWorkers = ( int ) std::thread::hardware_concurrency() - 1;
+	}
+	numWorkers = std::clamp( numWorkers, 0, ( int ) JOB_MAX_WORKERS );
+
+	if ( numWorkers == 0 )
+		return;
+
+	job_numQueues   = numWorkers + 1;
+	job_queues      = new JobQueue[ job_numQueues ];
+	job_threadQueue = 0;
+
+	job_shutdown = false;
+	for ( int i = 0; i < numWorkers; ++i )
+		job_workers.emplace_back( Job_Worker, i + 1 );
+}
+
+void Job_Shutdown()
+{
+	if ( job_workers.empty() )
+		return;
+
+	{
+		std::lock_guard< std::mutex > lock( job_sleepMutex );
+		job_shutdown = true;
+	}
+	job_wake.notify_all();
+
+	for ( auto &i : job_workers )
+		i.join();
+
+	job_workers.clear();
+
+	delete[] job_queues;
+	job_queues    = nullptr;
+	job_numQueues = 0;
+}
+
+/*
+================
+Job_Stats_f
+================
+*/
+void Job_Stats_f()
+{
+	size_t numBackground;
+	{
+		std::lock_guard< std::mutex > lock( job_backgroundMutex );
+		numBackground = job_background.size();
+	}
+
+	Com_Printf( "%u workers, %u jobs queued (%zu in the background), %u waiting on others\n", Job_GetNumWorkers(), job_numQueued.load(), numBackground, job_numParked.load() );
+	for ( unsigned int i = 0; i < job_numQueues; ++i )
+	{
+		Com_Printf( "%-8s %10u run, %10u stolen\n",
+		            ( i == 0 ) ? "main" : va( "worker %u", i ),
+		            job_queues[ i ].numRun.load(), job_queues[ i ].numStolen.load() );
+	}
+}
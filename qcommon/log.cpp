@@ -0,0 +1,298 @@
+/******************************************************************************
+	Copyright © 2020-2025 Mark E Sowden <hogsy@oldtimes-software.com>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+******************************************************************************/
+
+#include <mutex>
+#include <thread>
+
+#include "qcommon.h"
+
+/*
+==============================================================================
+
+LOGGING
+
+Everything printed is written out to the terminal and log file by a
+thread of its own, so none of it holds up whoever's printing.
+
+Messages go through a ring buffer, which any number of threads can write
+into at once without locking; each reserves its space by moving the head
+along, copies its message in, and then fills in the length to say it's
+done. The writer works through them in order from the tail, and clears
+them behind it. If the buffer fills up, messages are dropped and counted
+rather than making anyone wait.
+
+==============================================================================
+*/
+
+static constexpr size_t LOG_BUFFER_SIZE = 512 * 1024;// has to be a power of two
+static constexpr size_t LOG_MAX_MESSAGE = 16 * 1024; // anything longer is cut short
+static constexpr size_t LOG_BATCH_SIZE  = 64 * 1024;
+
+struct LogRecord
+{
+	std::atomic< uint32_t > length;// 0 until the message has been copied in
+	uint32_t                flags;
+};
+
+static_assert( sizeof( LogRecord ) == 8 );
+
+alignas( 64 ) static byte log_buffer[ LOG_BUFFER_SIZE ];
+
+alignas( 64 ) static std::atomic< uint64_t > log_head{ 0 };// next to be reserved
+alignas( 64 ) static std::atomic< uint64_t > log_tail{ 0 };// next to be written out
+static std::atomic< uint32_t >               log_numPublished{ 0 };
+static std::atomic< uint32_t >               log_numDropped{ 0 };
+
+static std::thread        *log_writer;
+static std::atomic< bool > log_shutdown{ false };
+
+static std::mutex log_fileMutex;// only between the writer and whoever's changing the file
+static FILE      *log_file;
+
+static size_t Log_RecordSize( size_t length )
+{
+	return sizeof( LogRecord ) + ( ( length + 7 ) & ~7 );
+}
+
+// these all wrap around the end of the buffer
+
+static void Log_CopyIn( uint64_t position, const void *src, size_t length )
+{
+	size_t offset = position & ( LOG_BUFFER_SIZE - 1 );
+	size_t first  = std::min( length, LOG_BUFFER_SIZE - offset );
+	memcpy( log_buffer + offset, src, first );
+	memcpy( log_buffer, ( const byte * ) src + first, length - first );
+}
+
+static void Log_CopyOut( uint64_t position, void *dest, size_t length )
+{
+	size_t offset = position & ( LOG_BUFFER_SIZE - 1 );
+	size_t first  = std::min( length, LOG_BUFFER_SIZE - offset );
+	memcpy( dest, log_buffer + offset, first );
+	memcpy( ( byte * ) dest + first, log_buffer, length - first );
+}
+
+static void Log_Clear( uint64_t position, size_t length )
+{
+	size_t offset = position & ( LOG_BUFFER_SIZE - 1 );
+	size_t first  = std::min( length, LOG_BUFFER_SIZE - offset );
+	memset( log_buffer + offset, 0, first );
+	memset( log_buffer, 0, length - first );
+}
+
+static void Log_Output( const char *text, size_t length, unsigned int flags )
+{
+	if ( length == 0 )
+		return;
+
+	if ( flags & LOG_STDOUT )
+		chr::globalApp->PushConsoleOutput( text );
+
+	if ( flags & LOG_FILE )
+	{
+		std::lock_guard< std::mutex > lock( log_fileMutex );
+		if ( log_file != nullptr )
+		{
+			fwrite( text, 1, length, log_file );
+			if ( flags & LOG_FLUSH )
+				fflush( log_file );
+		}
+	}
+}
+
+/**
+ * Writes out whatever's ready, batching it up as it goes. Returns false if
+ * there wasn't anything.
+ */
+static bool Log_Drain()
+{
+	static char  batch[ 2 ][ LOG_BATCH_SIZE + 1 ];// for the terminal and the file
+	size_t       batchLength[ 2 ] = {};
+	unsigned int fileFlags        = 0;
+
+	uint64_t tail  = log_tail.load( std::memory_order_relaxed );
+	uint64_t start = tail;
+
+	auto emit = [ & ]()
+	{
+		batch[ 0 ][ batchLength[ 0 ] ] = batch[ 1 ][ batchLength[ 1 ] ] = '\0';
+		Log_Output( batch[ 0 ], batchLength[ 0 ], LOG_STDOUT );
+		Log_Output( batch[ 1 ], batchLength[ 1 ], LOG_FILE | fileFlags );
+		batchLength[ 0 ] = batchLength[ 1 ] = 0;
+		fileFlags                           = 0;
+
+		// hand the space back
+		log_tail.store( tail, std::memory_order_release );
+		log_tail.notify_all();
+	};
+
+	while ( tail != log_head.load( std::memory_order_acquire ) )
+	{
+		const LogRecord *record = ( const LogRecord * ) ( log_buffer + ( tail & ( LOG_BUFFER_SIZE - 1 ) ) );
+		uint32_t         length = record->length.load( std::memory_order_acquire );
+		if ( length == 0 )
+			break;// still being copied in
+
+		if ( batchLength[ 0 ] + length > LOG_BATCH_SIZE || batchLength[ 1 ] + length > LOG_BATCH_SIZE )
+			emit();
+
+		uint32_t flags = record->flags;
+		for ( int i = 0; i < 2; ++i )
+		{
+			if ( !( flags & ( ( i == 0 ) ? LOG_STDOUT : LOG_FILE ) ) )
+				continue;
+
+			Log_CopyOut( tail + sizeof( LogRecord ), batch[ i ] + batchLength[ i ], length );
+			batchLength[ i ] += length;
+		}
+		fileFlags |= flags & LOG_FLUSH;
+
+		// whatever lands here next has to start out looking unfinished
+		size_t size = Log_RecordSize( length );
+		Log_Clear( tail, size );
+		tail += size;
+	}
+
+	if ( tail == start && log_numDropped.load( std::memory_order_relaxed ) == 0 )
+		return false;
+
+	emit();
+
+	uint32_t numDropped = log_numDropped.exchange( 0 );
+	if ( numDropped > 0 )
+	{
+		char warning[ 128 ];
+		snprintf( warning, sizeof( warning ), "WARNING: %u messages weren't logged, as they came in faster than they could be written\n", numDropped );
+		Log_Output( warning, strlen( warning ), LOG_STDOUT | LOG_FILE );
+	}
+
+	fflush( stdout );
+	return true;
+}
+
+static void Log_Writer()
+{
+	Prof_SetThreadName( "log writer" );
+
+	while ( true )
+	{
+		uint32_t numPublished = log_numPublished.load();
+		if ( Log_Drain() )
+			continue;
+
+		if ( log_shutdown.load() )
+			break;
+
+		log_numPublished.wait( numPublished );
+	}
+}
+
+/**
+ * Queues up the message to be written out to wherever flags says. Safe to
+ * call from any thread.
+ */
+void Log_Print( const char *msg, unsigned int flags )
+{
+	size_t length = std::min( strlen( msg ), LOG_MAX_MESSAGE );
+	if ( length == 0 || !( flags & ( LOG_STDOUT | LOG_FILE ) ) )
+		return;
+
+	if ( log_writer == nullptr )
+	{
+		// nothing to hand it over to yet, or any more
+		Log_Output( msg, strlen( msg ), flags );
+		return;
+	}
+
+	size_t   size = Log_RecordSize( length );
+	uint64_t head = log_head.load( std::memory_order_relaxed );
+	do
+	{
+		if ( head + size - log_tail.load( std::memory_order_acquire ) > LOG_BUFFER_SIZE )
+		{
+			log_numDropped++;
+			return;
+		}
+	} while ( !log_head.compare_exchange_weak( head, head + size, std::memory_order_acq_rel ) );
+
+	LogRecord *record = ( LogRecord * ) ( log_buffer + ( head & ( LOG_BUFFER_SIZE - 1 ) ) );
+	record->flags     = flags;
+	Log_CopyIn( head + sizeof( LogRecord ), msg, length );
+	record->length.store( ( uint32_t ) length, std::memory_order_release );
+
+	log_numPublished.fetch_add( 1, std::memory_order_release );
+	log_numPublished.notify_one();
+}
+
+/**
+ * Blocks until everything that's been printed so far has been written out.
+ */
+void Log_Flush()
+{
+	if ( log_writer == nullptr )
+		return;
+
+	// anything reserved before this has to be finished off in a moment, so it's safe to wait on
+	uint64_t head = log_head.load();
+	for ( uint64_t tail = log_tail.load(); tail < head; tail = log_tail.load() )
+	{
+		log_numPublished.fetch_add( 1 );
+		log_numPublished.notify_one();
+		log_tail.wait( tail );
+	}
+
+	std::lock_guard< std::mutex > lock( log_fileMutex );
+	if ( log_file != nullptr )
+		fflush( log_file );
+}
+
+/**
+ * Changes the file everything's logged to, once everything that was meant
+ * for the last one has been written. Returns the last one.
+ */
+FILE *Log_SetFile( FILE *file )
+{
+	Log_Flush();
+
+	std::lock_guard< std::mutex > lock( log_fileMutex );
+	std::swap( log_file, file );
+	return file;
+}
+
+void Log_Init()
+{
+	log_shutdown = false;
+	log_writer   = new std::thread( Log_Writer );
+}
+
+void Log_Shutdown()
+{
+	if ( log_writer == nullptr )
+		return;
+
+	Log_Flush();
+
+	log_shutdown = true;
+	log_numPublished.fetch_add( 1 );
+	log_numPublished.notify_one();
+
+	log_writer->join();
+	delete log_writer;
+	log_writer = nullptr;
+}
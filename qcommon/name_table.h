@@ -0,0 +1,128 @@
+/******************************************************************************
+	Copyright © 2020-2025 Mark E Sowden <hogsy@oldtimes-software.com>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+******************************************************************************/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace chr
+{
+	/**
+	 * Indexes named things (cvars, commands, aliases) by name, ignoring case
+	 * like the console always has. Alongside the hash there's a sorted view,
+	 * so listing and completion don't need to walk everything.
+	 *
+	 * Entries are only referenced; their names need to stay put for as long
+	 * as they're in here.
+	 */
+	template< typename T >
+	class NameTable
+	{
+	public:
+		T *Find( const char *name ) const
+		{
+			auto i = table.find( name );
+			return ( i != table.end() ) ? i->second : nullptr;
+		}
+
+		void Insert( T *item )
+		{
+			table.emplace( item->name, item );
+			sorted.insert( std::lower_bound( sorted.begin(), sorted.end(), item, SortsBefore ), item );
+		}
+
+		void Remove( T *item )
+		{
+			table.erase( item->name );
+
+			auto i = std::lower_bound( sorted.begin(), sorted.end(), item, SortsBefore );
+			if ( i != sorted.end() && *i == item )
+				sorted.erase( i );
+		}
+
+		/**
+		 * Returns the first entry, in sorted order, that starts with the given
+		 * prefix, or null if there isn't one.
+		 */
+		T *FindPrefix( const char *prefix ) const
+		{
+			size_t length = strlen( prefix );
+			auto   i      = std::lower_bound( sorted.begin(), sorted.end(), prefix, []( const T *item, const char *key ) { return Compare( item->name, key ) < 0; } );
+			if ( i == sorted.end() || Compare( ( *i )->name, prefix, length ) != 0 )
+				return nullptr;
+
+			return *i;
+		}
+
+		const std::vector< T * > &GetSorted() const { return sorted; }
+
+	private:
+		/**
+		 * Q_strcasecmp only says whether things match, this orders them too.
+		 */
+		static int Compare( const char *a, const char *b, size_t length = SIZE_MAX )
+		{
+			for ( size_t i = 0; i < length; ++i )
+			{
+				int c1 = tolower( ( unsigned char ) a[ i ] );
+				int c2 = tolower( ( unsigned char ) b[ i ] );
+				if ( c1 != c2 )
+					return c1 - c2;
+				if ( c1 == '\0' )
+					break;
+			}
+
+			return 0;
+		}
+
+		static bool SortsBefore( const T *a, const T *b ) { return Compare( a->name, b->name ) < 0; }
+
+		struct Hash
+		{
+			size_t operator()( std::string_view name ) const
+			{
+				// fnv-1a, folding case as it goes
+				uint64_t hash = 14695981039346656037ULL;
+				for ( char c : name )
+				{
+					hash ^= ( unsigned char ) tolower( ( unsigned char ) c );
+					hash *= 1099511628211ULL;
+				}
+				return ( size_t ) hash;
+			}
+		};
+
+		struct Equal
+		{
+			bool operator()( std::string_view a, std::string_view b ) const
+			{
+				return a.size() == b.size() && Compare( a.data(), b.data(), a.size() ) == 0;
+			}
+		};
+
+		std::unordered_map< std::string_view, T *, Hash, Equal > table;
+		std::vector< T * >                                       sorted;
+	};
+}// namespace chr
@@ -0,0 +1,383 @@
+/******************************************************************************
+	Copyright © 2020-2025 Mark E Sowden <hogsy@oldtimes-software.com>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+******************************************************************************/
+
+#include <chrono>
+#include <mutex>
+#include <vector>
+
+#include "qcommon.h"
+
+/*
+==============================================================================
+
+PROFILING
+
+Zones are recorded into a ring buffer belonging to the thread they ran
+on, but only while something wants them; either profile_capture, which
+writes out a number of frames in Chrome's trace event format (open it in
+about://tracing or Perfetto), or host_speeds, which prints a summary
+every second. Otherwise a zone costs a single check of prof_active.
+
+==============================================================================
+*/
+
+static constexpr unsigned int PROF_RING_SIZE = 65536;// zones kept per thread
+static constexpr unsigned int PROF_MAX_DEPTH = 64;
+
+struct ProfileEvent
+{
+	const char  *name;
+	uint64_t     start, end;
+	unsigned int depth;
+};
+
+struct ProfileThread
+{
+	std::mutex   mutex;// only contended while a capture or summary is being read
+	ProfileEvent events[ PROF_RING_SIZE ];
+	uint64_t     numEvents{ 0 };    // written in total, the next goes at numEvents % PROF_RING_SIZE
+	uint64_t     numSummarised{ 0 };// as of the last host_speeds summary
+
+	unsigned int id;
+	char         name[ 32 ];
+
+	// zones that have been started but not finished yet
+	struct
+	{
+		const char *name;
+		uint64_t    start;
+	} open[ PROF_MAX_DEPTH ];
+	unsigned int depth{ 0 };
+};
+
+std::atomic< bool > prof_active{ false };
+
+static std::mutex                     prof_threadsMutex;
+static std::vector< ProfileThread * > prof_threads;// never freed, as a capture may still want them
+
+static thread_local ProfileThread *prof_thread;
+static thread_local char           prof_threadName[ 32 ];
+
+static uint64_t     prof_captureStart;
+static unsigned int prof_captureFrames;// still to go
+static char         prof_capturePath[ MAX_OSPATH ];
+
+static bool         prof_summarising;
+static uint64_t     prof_summaryStart;
+static unsigned int prof_summaryFrames;
+
+static uint64_t Prof_GetNanoseconds()
+{
+	static const auto start = std::chrono::steady_clock::now();
+	return std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - start ).count();
+}
+
+/**
+ * Names the calling thread in captures.
+ */
+void Prof_SetThreadName( const char *name )
+{
+	snprintf( prof_threadName, sizeof( prof_threadName ), "%s", name );
+	if ( prof_thread != nullptr )
+	{
+		std::lock_guard< std::mutex > lock( prof_thread->mutex );
+		snprintf( prof_thread->name, sizeof( prof_thread->name ), "%s", name );
+	}
+}
+
+static ProfileThread *Prof_GetThread()
+{
+	if ( prof_thread != nullptr )
+		return prof_thread;
+
+	// only set up once the thread's actually recorded something, as they're not small
+	prof_thread = new ProfileThread;
+
+	std::lock_guard< std::mutex > lock( prof_threadsMutex );
+	prof_thread->id = ( unsigned int ) prof_threads.size() + 1;
+	if ( prof_threadName[ 0 ] != '\0' )
+		snprintf( prof_thread->name, sizeof( prof_thread->name ), "%s", prof_threadName );
+	else
+		Com_sprintf( prof_thread->name, sizeof( prof_thread->name ), "thread %u", prof_thread->id );
+	prof_threads.push_back( prof_thread );
+
+	return prof_thread;
+}
+
+void Prof_BeginZone( const char *name )
+{
+	ProfileThread *thread = Prof_GetThread();
+	if ( thread->depth < PROF_MAX_DEPTH )
+	{
+		thread->open[ thread->depth ].name  = name;
+		thread->open[ thread->depth ].start = Prof_GetNanoseconds();
+	}
+	thread->depth++;
+}
+
+void Prof_EndZone()
+{
+	ProfileThread *thread = prof_thread;
+	if ( thread == nullptr || thread->depth == 0 )
+		return;// thrown away by Prof_BeginFrame after an error
+
+	if ( --thread->depth >= PROF_MAX_DEPTH )
+		return;
+
+	uint64_t end = Prof_GetNanoseconds();
+
+	std::lock_guard< std::mutex > lock( thread->mutex );
+	ProfileEvent &event = thread->events[ thread->numEvents++ % PROF_RING_SIZE ];
+	event.name          = thread->open[ thread->depth ].name;
+	event.start         = thread->open[ thread->depth ].start;
+	event.end           = end;
+	event.depth         = thread->depth;
+}
+
+static void Prof_UpdateActive()
+{
+	prof_active.store( prof_captureFrames > 0 || host_speeds->value >= 1.0f, std::memory_order_relaxed );
+}
+
+/*
+==============================================================================
+
+CAPTURE
+
+==============================================================================
+*/
+
+static void Prof_WriteCapture()
+{
+	FILE *file = fopen( prof_capturePath, "w" );
+	if ( file == nullptr )
+	{
+		Com_Printf( "WARNING: Failed to open \"%s\" for writing!\n", prof_capturePath );
+		return;
+	}
+
+	fputs( "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file );
+
+	size_t numWritten = 0, numLost = 0;
+	{
+		std::lock_guard< std::mutex > threadsLock( prof_threadsMutex );
+		for ( ProfileThread *thread : prof_threads )
+		{
+			std::lock_guard< std::mutex > lock( thread->mutex );
+
+			fprintf( file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			         ( numWritten++ > 0 ) ? ",\n" : "", thread->id, thread->name );
+
+			uint64_t first = ( thread->numEvents > PROF_RING_SIZE ) ? thread->numEvents - PROF_RING_SIZE : 0;
+			for ( uint64_t i = first; i < thread->numEvents; ++i )
+			{
+				const ProfileEvent &event = thread->events[ i % PROF_RING_SIZE ];
+				if ( event.start < prof_captureStart )
+					continue;
+
+				fprintf( file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				         event.name, thread->id, event.start / 1000.0, ( event.end - event.start ) / 1000.0 );
+				numWritten++;
+			}
+
+			// if the oldest one kept is still in the capture, there were more before it
+			if ( first > 0 && thread->events[ first % PROF_RING_SIZE ].start >= prof_captureStart )
+				numLost++;
+		}
+	}
+
+	fputs( "\n]}\n", file );
+	fclose( file );
+
+	Com_Printf( "Wrote %zu zones to \"%s\"\n", numWritten, prof_capturePath );
+	if ( numLost > 0 )
+		Com_Printf( "WARNING: %zu threads ran out of room, so the start of the capture is missing for them\n", numLost );
+}
+
+/*
+================
+Prof_Capture_f
+
+profile_capture <frames> [filename]
+================
+*/
+static void Prof_Capture_f()
+{
+	if ( Cmd_Argc() < 2 || Cmd_Argc() > 3 )
+	{
+		Com_Printf( "Usage: profile_capture <frames> [filename]\n" );
+		return;
+	}
+
+	if ( prof_captureFrames > 0 )
+	{
+		Com_Printf( "A capture is already in progress\n" );
+		return;
+	}
+
+	int numFrames = atoi( Cmd_Argv( 1 ) );
+	if ( numFrames <= 0 )
+	{
+		Com_Printf( "Need to capture at least one frame\n" );
+		return;
+	}
+
+	const char *name = ( Cmd_Argc() == 3 ) ? Cmd_Argv( 2 ) : va( "profiles/capture_%llu.json", ( unsigned long long ) time( nullptr ) );
+	Com_sprintf( prof_capturePath, sizeof( prof_capturePath ), "%s/%s", FS_Gamedir(), name );
+	if ( !FS_CreatePath( prof_capturePath ) )
+		return;
+
+	// starts from the next frame
+	prof_captureFrames = numFrames + 1;
+	prof_captureStart  = UINT64_MAX;
+	Prof_UpdateActive();
+
+	Com_Printf( "Capturing %i frames...\n", numFrames );
+}
+
+/*
+==============================================================================
+
+SUMMARY
+
+==============================================================================
+*/
+
+struct ProfileTotal
+{
+	const char          *name;
+	const ProfileThread *thread;
+	unsigned int         depth;
+	unsigned int         numCalls;
+	uint64_t             time;
+	uint64_t             longest;
+};
+
+static void Prof_PrintSummary( uint64_t now )
+{
+	std::vector< ProfileTotal > totals;
+	{
+		std::lock_guard< std::mutex > threadsLock( prof_threadsMutex );
+		for ( ProfileThread *thread : prof_threads )
+		{
+			std::lock_guard< std::mutex > lock( thread->mutex );
+
+			uint64_t first = std::max( thread->numSummarised, ( thread->numEvents > PROF_RING_SIZE ) ? thread->numEvents - PROF_RING_SIZE : 0 );
+			for ( uint64_t i = first; i < thread->numEvents; ++i )
+			{
+				const ProfileEvent &event = thread->events[ i % PROF_RING_SIZE ];
+
+				// names are literals, so there's no need to compare anything but the pointers
+				auto total = std::find_if( totals.begin(), totals.end(), [ & ]( const ProfileTotal &t )
+				                           { return t.name == event.name && t.thread == thread; } );
+				if ( total == totals.end() )
+					total = totals.insert( totals.end(), { event.name, thread, event.depth } );
+
+				uint64_t time = event.end - event.start;
+				total->depth  = std::min( total->depth, event.depth );
+				total->numCalls++;
+				total->time += time;
+				total->longest = std::max( total->longest, time );
+			}
+
+			thread->numSummarised = thread->numEvents;
+		}
+	}
+
+	// by thread, then outermost first, then whatever took the longest
+	std::sort( totals.begin(), totals.end(), []( const ProfileTotal &a, const ProfileTotal &b )
+	           {
+		           if ( a.thread->id != b.thread->id ) return a.thread->id < b.thread->id;
+		           if ( a.depth != b.depth ) return a.depth < b.depth;
+		           return a.time > b.time; } );
+
+	double numFrames = std::max( prof_summaryFrames, 1U );
+	Com_Printf( "%u frames in %.2fs, %u heap allocations last frame\n", prof_summaryFrames, ( now - prof_summaryStart ) / 1000000000.0, Z_GetFrameHeapAllocs() );
+	Com_Printf( "%-12s %-24s %10s %10s %10s\n", "thread", "zone", "calls/frm", "ms/frm", "max ms" );
+	for ( const ProfileTotal &total : totals )
+	{
+		Com_Printf( "%-12s %*s%-*s %10.1f %10.3f %10.3f\n",
+		            total.thread->name,
+		            std::min( total.depth, 8U ), "", 24 - std::min( total.depth, 8U ), total.name,
+		            total.numCalls / numFrames, ( total.time / numFrames ) / 1000000.0, total.longest / 1000000.0 );
+	}
+}
+
+/*
+================
+Prof_BeginFrame
+
+Called at the start of every frame that runs the server or client
+================
+*/
+void Prof_BeginFrame()
+{
+	// if the last frame errored out, whatever was open on this thread is never going to close
+	if ( prof_thread != nullptr )
+		prof_thread->depth = 0;
+
+	uint64_t now = Prof_GetNanoseconds();
+
+	if ( prof_captureFrames > 0 )
+	{
+		if ( prof_captureStart == UINT64_MAX )
+			prof_captureStart = now;
+
+		if ( --prof_captureFrames == 0 )
+			Prof_WriteCapture();
+	}
+
+	if ( host_speeds->value >= 1.0f )
+	{
+		if ( !prof_summarising )
+		{
+			// just switched on, so anything already recorded is from a capture
+			std::lock_guard< std::mutex > threadsLock( prof_threadsMutex );
+			for ( ProfileThread *thread : prof_threads )
+			{
+				std::lock_guard< std::mutex > lock( thread->mutex );
+				thread->numSummarised = thread->numEvents;
+			}
+
+			prof_summarising   = true;
+			prof_summaryStart  = now;
+			prof_summaryFrames = 0;
+		}
+		else if ( now - prof_summaryStart >= 1000000000 )
+		{
+			Prof_PrintSummary( now );
+
+			prof_summaryStart  = now;
+			prof_summaryFrames = 0;
+		}
+
+		prof_summaryFrames++;
+	}
+	else
+		prof_summarising = false;
+
+	Prof_UpdateActive();
+}
+
+void Prof_Init()
+{
+	Prof_SetThreadName( "main" );
+
+	Cmd_AddCommand( "profile_capture", Prof_Capture_f );
+}
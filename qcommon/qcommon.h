@@ -22,6 +22,8 @@
 
 // qcommon.h -- definitions common between client and server, but not game.dll
 
+#include <atomic>
+
 #include "../game/q_shared.h"
 
 #define ENGINE_NAME     "Chronon"
@@ -537,13 +539,14 @@ void NET_Config( bool multiplayer );
 bool NET_GetPacket( netsrc_t sock, netadr_t *net_from,
 	sizebuf_t *net_message );
 void NET_SendPacket( netsrc_t sock, int length, void *data, netadr_t to );
+void NET_FlushPackets( netsrc_t sock );
 
 bool NET_CompareAdr( netadr_t a, netadr_t b );
 bool NET_CompareBaseAdr( netadr_t a, netadr_t b );
 bool NET_IsLocalAddress( netadr_t adr );
 char *NET_AdrToString( netadr_t a );
 bool NET_StringToAdr( const char *s, netadr_t *a );
-void NET_Sleep( int msec );
+bool NET_Sleep( int msec );
 
 //============================================================================
 
@@ -633,11 +636,18 @@ trace_t CM_TransformedBoxTrace( vec3_t start, vec3_t end, vec3_t mins,
 
 byte *CM_ClusterPVS( int cluster );
 byte *CM_ClusterPHS( int cluster );
+// as above, but into the caller's own buffer so they can be used from any thread;
+// rows are padded with zeros out to CM_ClusterRowWords, so can be worked on a word at a time
+int  CM_ClusterRowWords( void );
+void CM_DecompressClusterPVS( int cluster, uint64_t *out );
+void CM_DecompressClusterPHS( int cluster, uint64_t *out );
+void CM_MergeClusterPVS( int cluster, uint64_t *out );// ORs the row into out
+void CM_VisStats_f( void );
 
 int CM_PointLeafnum( vec3_t p );
 
 // call with topnode set to the headnode, returns with topnode
-// set to the first node that splits the box
+// set to the first node that splits the box; safe to call from any thread
 int CM_BoxLeafnums( vec3_t mins, vec3_t maxs, int *list, int listsize,
 	int *topnode );
 
@@ -677,6 +687,7 @@ FILESYSTEM
 */
 
 void FS_InitFilesystem( void );
+void FS_Shutdown( void );
 void FS_SetGamedir( const char *dir );
 const char *FS_Gamedir( void );
 char *FS_NextPath( char *prevpath );
@@ -684,13 +695,77 @@ void        FS_ExecAutoexec( void );
 
 ssize_t FS_LoadFile( const char *path, void **buffer );
 // a null buffer will just return the file length without loading
-// a -1 length is not present
+// a -1 length is not present. the buffer may be shared with the cache,
+// so treat it as read-only and let go of it with FS_FreeFile
 
 void FS_Read( void *buffer, int len, FILE *f );
 // properly handles partial reads
 
 void FS_FreeFile( void *buffer );
 
+ssize_t FS_MapFile( const char *path, const void **buffer );
+// read-only alternative to FS_LoadFile, which avoids a copy where
+// the file can be handed out straight from a mapped package or file
+
+void FS_UnmapFile( const void *buffer );
+
+typedef struct fsstream_s fsstream_t;
+
+fsstream_t *FS_OpenStream( const char *path, size_t *length );
+// opens the file for reading in pieces, compressed package entries are
+// inflated as they're read rather than all up front. returns null if the
+// file isn't present, length can be null
+
+size_t FS_ReadStream( fsstream_t *stream, void *buffer, size_t length );
+// returns the number of bytes read, which is only short at the end of the
+// file or if the data couldn't be read
+
+bool FS_SeekStream( fsstream_t *stream, size_t offset );
+// seeking backwards in a compressed entry means inflating it from the start
+
+void FS_CloseStream( fsstream_t *stream );
+
+typedef uint32_t fsrequest_t;// 0 is never a valid request
+
+typedef enum
+{
+	FS_PRIORITY_LOW,
+	FS_PRIORITY_NORMAL,
+	FS_PRIORITY_HIGH,
+} fspriority_t;
+
+typedef void ( *fscallback_t )( const char *path, void *buffer, ssize_t length, void *user );
+
+fsrequest_t FS_LoadFileAsync( const char *path, fspriority_t priority, fscallback_t callback, void *user );
+// queues the file to be read and decompressed by the worker threads. if a
+// callback is given, it's run from FS_RunAsyncLoads on the main thread and
+// owns the buffer as it would from FS_LoadFile, otherwise the result has to
+// be collected with FS_PollFile or FS_WaitFile. a file that couldn't be
+// loaded has a null buffer and -1 length
+
+bool FS_PollFile( fsrequest_t request, void **buffer, ssize_t *length );
+// returns true once the request has completed, handing over the buffer
+
+ssize_t FS_WaitFile( fsrequest_t request, void **buffer );
+// blocks until the request has completed, same result as FS_LoadFile
+
+void FS_CancelFile( fsrequest_t request );
+
+bool FS_Prefetch( const char *path );
+// hint that the file is about to be loaded; it's read in the background and
+// picked up by the next FS_LoadFile or FS_MapFile for the same path. returns
+// false if it couldn't be found, or there's nothing to read it in the background
+
+void FS_RunAsyncLoads( void );
+// dispatches completed requests, called once per frame
+
+void FS_BeginLoadManifest( const char *name );
+// starts recording what the given map loads, and prefetches whatever it
+// loaded last time. does nothing if that map is already being recorded
+
+void FS_EndLoadManifest( void );
+// stops recording and writes the manifest out, once the map is up
+
 bool FS_CreatePath( char *path );
 bool FS_LocalFileExists( const char *path );
 
@@ -732,7 +807,7 @@ void Com_Quit( void );
 int Com_ServerState( void );  // this should have just been a cvar...
 void Com_SetServerState( int state );
 
-unsigned int Com_BlockChecksum( void *buffer, int length );
+unsigned int Com_BlockChecksum( const void *buffer, int length );
 byte COM_BlockSequenceCRCByte( byte *base, int length, int sequence );
 
 float frand( void );  // 0 ti 1
@@ -745,19 +820,51 @@ extern cvar_t *log_stats;
 
 extern FILE *log_stats_file;
 
-// host_speeds times
-extern unsigned int time_before_game;
-extern unsigned int time_after_game;
-extern unsigned int time_before_ref;
-extern unsigned int time_after_ref;
-
 void Z_Free( void *ptr );
 void *Z_Malloc( size_t size );  // returns 0 filled memory
 void *Z_TagMalloc( size_t size, int16_t tag );
 void Z_FreeTags( int tag );
+void Z_Stats_f( void );
+void Z_Report_f( void );
+void Hunk_Stats_f( void );
+void Hunk_Snapshot( void );
+void Hunk_ReportSinceSnapshot( void );
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+/**
+ * One of these is kept for every place Z_Malloc/Z_TagMalloc is called
+ * from, so mem_report can say where everything came from.
+ */
+typedef struct zsite_s
+{
+	const char     *file;
+	int             line;
+	bool            linked;// into the list of sites that have been allocated from
+	struct zsite_s *next;
+	size_t          numAllocs, numAllocsMark;
+	size_t          numLive;
+	size_t          liveBytes, peakBytes;
+} zsite_t;
+
+void *Z_TagMallocSite( size_t size, int16_t tag, zsite_t *site );
+
+#	define Z_SITE                   ( []() -> zsite_t * { static zsite_t site = { __FILE__, __LINE__ }; return &site; }() )
+#	define Z_Malloc( size )         Z_TagMallocSite( ( size ), 0, Z_SITE )
+#	define Z_TagMalloc( size, tag ) Z_TagMallocSite( ( size ), ( tag ), Z_SITE )
+#endif
+
+// transient memory for the calling thread, good until the next frame
+void *Z_ScratchAlloc( size_t size );
+char *Z_ScratchVPrintf( const char *fmt, va_list args );
+size_t Z_ScratchMark( void );
+void Z_ScratchRewind( size_t mark );
+void Z_ResetScratch( void );
+void Z_BeginFrame( void );
+unsigned int Z_GetFrameHeapAllocs( void );
 
 void Qcommon_Init( int argc, char **argv );
-void Qcommon_Frame( unsigned int msec );
+void Qcommon_WaitForFrame();
+void Qcommon_Frame();
 void Qcommon_Shutdown( void );
 
 #define NUMVERTEXNORMALS 162
@@ -769,6 +876,140 @@ void SCR_DebugGraph( float value, int color );
 /*
 ==============================================================
 
+JOBS
+
+==============================================================
+*/
+
+typedef void ( *jobfunc_t )( void *data, size_t begin, size_t end );
+
+typedef struct job_s
+{
+	jobfunc_t func;
+	void     *data;
+	size_t    begin, end;// handed to func, so work can be split up into ranges
+} job_t;
+
+/**
+ * Counts the jobs still to finish that were submitted against it. It has
+ * to outlive them, along with any jobs depending on it.
+ */
+typedef struct jobcounter_s
+{
+	std::atomic< unsigned int > count{ 0 };
+} jobcounter_t;
+
+void Job_Init( void );
+void Job_Shutdown( void );
+void Job_Stats_f( void );
+unsigned int Job_GetNumWorkers( void );
+
+// won't be started until dependency, if there is one, reaches zero
+void Job_Submit( const job_t &job, jobcounter_t *counter, const jobcounter_t *dependency = nullptr );
+// for work that can block, like loading; only picked up by the workers once
+// they've nothing else to do, and never by the main thread while it waits
+void Job_SubmitBackground( const job_t &job, jobcounter_t *counter );
+// runs other jobs while waiting, returns false if timeout (in milliseconds) passed first
+bool Job_Wait( jobcounter_t *counter, unsigned int timeout = 0 );
+
+/**
+ * Splits [begin, end) up into jobs that call function for each index,
+ * with at least grain indices in each. Function has to stay around until
+ * the counter's been waited on.
+ */
+template< typename FUNCTION >
+void Job_SubmitParallelFor( size_t begin, size_t end, FUNCTION &function, jobcounter_t *counter, size_t grain = 1 )
+{
+	if ( begin >= end )
+		return;
+
+	size_t count     = end - begin;
+	size_t numChunks = std::max< size_t >( std::min< size_t >( count / std::max< size_t >( grain, 1 ), ( Job_GetNumWorkers() + 1 ) * 4 ), 1 );
+	size_t chunkSize = ( count + numChunks - 1 ) / numChunks;
+
+	jobfunc_t func = []( void *data, size_t chunkBegin, size_t chunkEnd )
+	{
+		FUNCTION &function = *( FUNCTION * ) data;
+		for ( size_t i = chunkBegin; i < chunkEnd; ++i )
+			function( i );
+	};
+
+	for ( size_t i = begin; i < end; i += chunkSize )
+		Job_Submit( { func, ( void * ) &function, i, std::min( i + chunkSize, end ) }, counter );
+}
+
+template< typename FUNCTION >
+void Job_ParallelFor( size_t begin, size_t end, FUNCTION function, size_t grain = 1 )
+{
+	jobcounter_t counter;
+	Job_SubmitParallelFor( begin, end, function, &counter, grain );
+	Job_Wait( &counter );
+}
+
+/*
+==============================================================
+
+PROFILING
+
+==============================================================
+*/
+
+extern std::atomic< bool > prof_active;// only record anything while capturing, or summarising for host_speeds
+
+void Prof_Init( void );
+void Prof_BeginFrame( void );
+void Prof_SetThreadName( const char *name );
+void Prof_BeginZone( const char *name );
+void Prof_EndZone( void );
+
+/**
+ * Times everything from here to the end of the scope, under the given
+ * name, which has to stay around (i.e. be a literal).
+ */
+class ProfileZone
+{
+public:
+	explicit ProfileZone( const char *name ) : active_( prof_active.load( std::memory_order_relaxed ) )
+	{
+		if ( active_ ) Prof_BeginZone( name );
+	}
+	~ProfileZone()
+	{
+		if ( active_ ) Prof_EndZone();
+	}
+
+private:
+	bool active_;
+};
+
+#define PROFILE_ZONE_NAME( LINE ) profileZone##LINE
+#define PROFILE_ZONE_LINE( NAME, LINE ) ProfileZone PROFILE_ZONE_NAME( LINE )( NAME )
+#define PROFILE_ZONE( NAME ) PROFILE_ZONE_LINE( NAME, __LINE__ )
+
+/*
+==============================================================
+
+LOGGING
+
+==============================================================
+*/
+
+enum
+{
+	LOG_STDOUT = 1,
+	LOG_FILE   = 2,
+	LOG_FLUSH  = 4,// flush the log file as soon as it's written
+};
+
+void Log_Init( void );
+void Log_Shutdown( void );
+void Log_Print( const char *msg, unsigned int flags );
+void Log_Flush( void );
+FILE *Log_SetFile( FILE *file );
+
+/*
+==============================================================
+
 NON-PORTABLE SYSTEM SERVICES
 
 ==============================================================
@@ -791,6 +1032,8 @@ namespace chr
 void Sys_Error( const char *error, ... );
 void Sys_Quit( void );
 
+char *Sys_ConsoleInput();// next line typed into the terminal when dedicated, or null
+
 /*
 ==============================================================
 
@@ -803,9 +1046,11 @@ void CL_Init( void );
 void CL_Drop( void );
 void CL_Shutdown( void );
 void CL_Frame( unsigned int msec );
+uint64_t CL_GetFrameInterval();
 void Con_Print( char *text );
 void SCR_BeginLoadingPlaque( void );
 
 void SV_Init( void );
 void SV_Shutdown( const char *finalmsg, bool reconnect );
 void SV_Frame( unsigned int msec );
+uint64_t SV_GetFrameInterval();
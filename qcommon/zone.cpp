@@ -0,0 +1,960 @@
+/******************************************************************************
+	Copyright © 1997-2001 Id Software, Inc.
+	Copyright © 2020-2025 Mark E Sowden <hogsy@oldtimes-software.com>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+******************************************************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "qcommon.h"
+
+// the real thing is defined here, rather than the versions that pass along where they're called from
+#undef Z_Malloc
+#undef Z_TagMalloc
+
+/*
+==============================================================================
+
+ZONE MEMORY ALLOCATION
+
+Small allocations are carved out of slabs, each of which holds blocks of a
+single size class for a single tag. Every tag has its own arena of slabs, so
+Z_FreeTags can hand back whole slabs at a time rather than walking every
+block that's been allocated. Anything bigger than the largest size class is
+allocated by itself and linked into its tag's arena.
+
+Building with CHRONON_TRACK_ALLOCATIONS has every allocation remember where
+it was made from, so mem_report can break things down by call site and list
+whatever's survived since a snapshot was taken.
+
+==============================================================================
+*/
+
+#define Z_MAGIC      0x1d1d
+#define Z_FREE_MAGIC 0xdead
+
+static constexpr size_t Z_ALIGNMENT = 16;
+static constexpr size_t Z_SLAB_SIZE = 64 * 1024;
+
+static constexpr uint32_t     z_sizeClasses[]    = { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096 };
+static constexpr unsigned int Z_NUM_SIZE_CLASSES = std::size( z_sizeClasses );
+static constexpr uint8_t      Z_LARGE_CLASS      = 0xFF;
+
+/**
+ * Allocates; aborts on fail.
+ * Memory allocated is zeroed.
+ */
+void *M_Alloc( size_t size )
+{
+	void *data = calloc( size, 1 );
+	if ( data == nullptr )
+		Com_Error( ERR_FATAL, "Failed to allocate %zu bytes!\n", size );
+
+	return data;
+}
+
+void M_Free( void *ptr )
+{
+	free( ptr );
+}
+
+struct ZoneArena;
+
+/**
+ * Sits in front of every allocation.
+ */
+struct alignas( Z_ALIGNMENT ) zhead_t
+{
+	void    *owner; /* the slab or large block it belongs to */
+	uint32_t size;  /* as requested */
+	uint16_t magic;
+	uint8_t  sizeClass;
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+	zsite_t *site;
+	uint32_t serial; /* for telling what's new since a snapshot */
+#endif
+};
+
+struct alignas( Z_ALIGNMENT ) ZoneSlab
+{
+	ZoneArena *arena;
+	ZoneSlab  *prev, *next;                   /* every slab in the arena for this class */
+	ZoneSlab  *prevAvailable, *nextAvailable; /* the ones that still have room */
+	void      *freeList;
+	uint32_t   numUsed;
+	uint32_t   numBlocks;
+	uint32_t   numTouched; /* blocks past this have never been handed out */
+	uint8_t    sizeClass;
+};
+
+struct alignas( Z_ALIGNMENT ) ZoneLarge
+{
+	ZoneArena *arena;
+	ZoneLarge *prev, *next;
+	size_t     size;
+};
+
+struct ZoneUsage
+{
+	size_t numBlocks;
+	size_t numBytes;    /* as requested */
+	size_t numReserved; /* slabs and large blocks, including headers */
+	size_t numSlabs;
+	size_t numAllocs;   /* ever made */
+	size_t peakBytes;
+};
+
+struct ZoneArena
+{
+	int16_t    tag;
+	size_t     numAllocsMark; /* as of the last snapshot, for working out the rate */
+	size_t     numBytesMark;
+	ZoneSlab  *slabs[ Z_NUM_SIZE_CLASSES ];
+	ZoneSlab  *available[ Z_NUM_SIZE_CLASSES ];
+	ZoneLarge *large;
+	ZoneUsage  usage;
+};
+
+// indexed by tag; all zero to begin with, so nothing here needs constructing
+static ZoneArena *z_arenas[ UINT16_MAX + 1 ];
+static ZoneUsage  z_classUsage[ Z_NUM_SIZE_CLASSES + 1 ]; /* the last one is for large blocks */
+
+// the filesystem workers allocate from the zone too
+static std::mutex z_mutex;
+
+// every trip to the heap, so a frame that should be allocation free can be checked
+static std::atomic< unsigned int > z_numHeapAllocs;
+
+// all guarded by z_mutex
+static size_t z_liveBytes;
+static size_t z_peakBytes;
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+static zsite_t  z_unknownSite = { "unknown", 0 }; /* anything allocated through a pointer, i.e. the game */
+static zsite_t *z_sites;                          /* every site that's been allocated from */
+static uint32_t z_serial;
+static uint32_t z_snapshotSerial;
+#endif
+
+template< typename T >
+static void Z_LinkHead( T **head, T *item, T *T::*prev, T *T::*next )
+{
+	item->*prev = nullptr;
+	item->*next = *head;
+	if ( *head != nullptr )
+		( *head )->*prev = item;
+	*head = item;
+}
+
+template< typename T >
+static void Z_Unlink( T **head, T *item, T *T::*prev, T *T::*next )
+{
+	if ( item->*prev != nullptr )
+		( item->*prev )->*next = item->*next;
+	else
+		*head = item->*next;
+
+	if ( item->*next != nullptr )
+		( item->*next )->*prev = item->*prev;
+
+	item->*prev = item->*next = nullptr;
+}
+
+static unsigned int Z_GetSizeClass( size_t size )
+{
+	for ( unsigned int i = 0; i < Z_NUM_SIZE_CLASSES; ++i )
+	{
+		if ( size <= z_sizeClasses[ i ] )
+			return i;
+	}
+
+	return Z_LARGE_CLASS;
+}
+
+static ZoneArena *Z_GetArena( int16_t tag )
+{
+	ZoneArena *&arena = z_arenas[ ( uint16_t ) tag ];
+	if ( arena == nullptr )
+	{
+		arena      = static_cast< ZoneArena * >( M_Alloc( sizeof( ZoneArena ) ) );
+		arena->tag = tag;
+	}
+
+	return arena;
+}
+
+static ZoneUsage &Z_GetClassUsage( unsigned int sizeClass )
+{
+	return z_classUsage[ ( sizeClass == Z_LARGE_CLASS ) ? Z_NUM_SIZE_CLASSES : sizeClass ];
+}
+
+/**
+ * Requested bytes are only tracked per tag, as the size classes would
+ * otherwise need every block visiting when a tag is freed.
+ */
+static void Z_AddUsage( ZoneArena *arena, unsigned int sizeClass, ptrdiff_t numBlocks, ptrdiff_t numBytes, ptrdiff_t numReserved, ptrdiff_t numSlabs )
+{
+	arena->usage.numBlocks += numBlocks;
+	arena->usage.numBytes += numBytes;
+	arena->usage.numReserved += numReserved;
+	arena->usage.numSlabs += numSlabs;
+	if ( numBlocks > 0 )
+		arena->usage.numAllocs += numBlocks;
+	arena->usage.peakBytes = std::max( arena->usage.peakBytes, arena->usage.numBytes );
+
+	z_liveBytes += numBytes;
+	z_peakBytes = std::max( z_peakBytes, z_liveBytes );
+
+	ZoneUsage &usage = Z_GetClassUsage( sizeClass );
+	usage.numBlocks += numBlocks;
+	usage.numReserved += numReserved;
+	usage.numSlabs += numSlabs;
+}
+
+static ZoneSlab *Z_NewSlab( ZoneArena *arena, unsigned int sizeClass )
+{
+	// no need to zero it, blocks are cleared as they're handed out
+	auto slab = static_cast< ZoneSlab * >( malloc( Z_SLAB_SIZE ) );
+	if ( slab == nullptr )
+		return nullptr;
+
+	*slab           = {};
+	slab->arena     = arena;
+	slab->sizeClass = sizeClass;
+	slab->numBlocks = ( Z_SLAB_SIZE - sizeof( ZoneSlab ) ) / ( sizeof( zhead_t ) + z_sizeClasses[ sizeClass ] );
+
+	Z_LinkHead( &arena->slabs[ sizeClass ], slab, &ZoneSlab::prev, &ZoneSlab::next );
+	Z_LinkHead( &arena->available[ sizeClass ], slab, &ZoneSlab::prevAvailable, &ZoneSlab::nextAvailable );
+	Z_AddUsage( arena, sizeClass, 0, 0, Z_SLAB_SIZE, 1 );
+
+	return slab;
+}
+
+static void Z_FreeSlab( ZoneSlab *slab )
+{
+	ZoneArena   *arena     = slab->arena;
+	unsigned int sizeClass = slab->sizeClass;
+
+	Z_Unlink( &arena->slabs[ sizeClass ], slab, &ZoneSlab::prev, &ZoneSlab::next );
+	if ( slab->numUsed < slab->numBlocks )
+		Z_Unlink( &arena->available[ sizeClass ], slab, &ZoneSlab::prevAvailable, &ZoneSlab::nextAvailable );
+
+	Z_AddUsage( arena, sizeClass, 0, 0, -( ptrdiff_t ) Z_SLAB_SIZE, -1 );
+
+	free( slab );
+}
+
+static zhead_t *Z_AllocSmall( ZoneArena *arena, unsigned int sizeClass )
+{
+	ZoneSlab *slab = arena->available[ sizeClass ];
+	if ( slab == nullptr && ( slab = Z_NewSlab( arena, sizeClass ) ) == nullptr )
+		return nullptr;
+
+	zhead_t *z;
+	if ( slab->freeList != nullptr )
+	{
+		z              = static_cast< zhead_t * >( slab->freeList );
+		slab->freeList = *reinterpret_cast< void ** >( z + 1 );
+	}
+	else
+	{
+		size_t stride = sizeof( zhead_t ) + z_sizeClasses[ sizeClass ];
+		z             = reinterpret_cast< zhead_t * >( reinterpret_cast< uint8_t * >( slab + 1 ) + slab->numTouched++ * stride );
+	}
+
+	// full up, so it's no use for anything else until something's freed
+	if ( ++slab->numUsed == slab->numBlocks )
+		Z_Unlink( &arena->available[ sizeClass ], slab, &ZoneSlab::prevAvailable, &ZoneSlab::nextAvailable );
+
+	z->owner     = slab;
+	z->sizeClass = sizeClass;
+	return z;
+}
+
+static void Z_FreeSmall( zhead_t *z )
+{
+	auto       slab  = static_cast< ZoneSlab * >( z->owner );
+	ZoneArena *arena = slab->arena;
+
+#if !defined( NDEBUG )
+	memset( z + 1, 0xdd, z_sizeClasses[ slab->sizeClass ] );
+#endif
+
+	if ( slab->numUsed-- == slab->numBlocks )
+		Z_LinkHead( &arena->available[ slab->sizeClass ], slab, &ZoneSlab::prevAvailable, &ZoneSlab::nextAvailable );
+
+	*reinterpret_cast< void ** >( z + 1 ) = slab->freeList;
+	slab->freeList                        = z;
+
+	// hang on to the last slab for the class, to save churning through them
+	if ( slab->numUsed == 0 && ( slab->prev != nullptr || slab->next != nullptr ) )
+		Z_FreeSlab( slab );
+}
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+
+static void Z_TrackAlloc( zhead_t *z, zsite_t *site )
+{
+	if ( site == nullptr )
+		site = &z_unknownSite;
+
+	if ( !site->linked )
+	{
+		site->linked = true;
+		site->next   = z_sites;
+		z_sites      = site;
+	}
+
+	site->numAllocs++;
+	site->numLive++;
+	site->liveBytes += z->size;
+	site->peakBytes = std::max( site->peakBytes, site->liveBytes );
+
+	z->site   = site;
+	z->serial = ++z_serial;
+}
+
+static void Z_TrackFree( const zhead_t *z )
+{
+	z->site->numLive--;
+	z->site->liveBytes -= z->size;
+}
+
+/**
+ * Visits every block that's currently allocated under the given arena.
+ */
+template< typename F >
+static void Z_ForEachBlock( const ZoneArena *arena, F function )
+{
+	for ( unsigned int i = 0; i < Z_NUM_SIZE_CLASSES; ++i )
+	{
+		size_t stride = sizeof( zhead_t ) + z_sizeClasses[ i ];
+		for ( const ZoneSlab *slab = arena->slabs[ i ]; slab != nullptr; slab = slab->next )
+		{
+			for ( uint32_t j = 0; j < slab->numTouched; ++j )
+			{
+				auto z = reinterpret_cast< const zhead_t * >( reinterpret_cast< const uint8_t * >( slab + 1 ) + j * stride );
+				if ( z->magic == Z_MAGIC )
+					function( z );
+			}
+		}
+	}
+
+	for ( const ZoneLarge *large = arena->large; large != nullptr; large = large->next )
+		function( reinterpret_cast< const zhead_t * >( large + 1 ) );
+}
+
+#endif
+
+void Z_Free( void *ptr )
+{
+	zhead_t *z = ( ( zhead_t * ) ptr ) - 1;
+
+	// checked up front, as erroring out with the lock held would leave it locked
+	if ( z->magic != Z_MAGIC )
+		Com_Error( ERR_FATAL, "Z_Free: %s", ( z->magic == Z_FREE_MAGIC ) ? "double free" : "bad magic" );
+
+	ZoneLarge *large = nullptr;
+	{
+		std::lock_guard< std::mutex > lock( z_mutex );
+
+		// set with the lock held, so mem_report never sees it half way through
+		z->magic = Z_FREE_MAGIC;
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+		Z_TrackFree( z );
+#endif
+
+		if ( z->sizeClass == Z_LARGE_CLASS )
+		{
+			large            = static_cast< ZoneLarge * >( z->owner );
+			ZoneArena *arena = large->arena;
+			Z_Unlink( &arena->large, large, &ZoneLarge::prev, &ZoneLarge::next );
+			Z_AddUsage( arena, Z_LARGE_CLASS, -1, -( ptrdiff_t ) z->size, -( ptrdiff_t ) large->size, 0 );
+		}
+		else
+		{
+			Z_AddUsage( static_cast< ZoneSlab * >( z->owner )->arena, z->sizeClass, -1, -( ptrdiff_t ) z->size, 0, 0 );
+			Z_FreeSmall( z );
+		}
+	}
+
+	if ( large != nullptr )
+		M_Free( large );
+}
+
+/**
+ * Release everything allocated under the given tag, a slab at a time.
+ */
+void Z_FreeTags( int tag )
+{
+	std::lock_guard< std::mutex > lock( z_mutex );
+
+	ZoneArena *arena = z_arenas[ ( uint16_t ) tag ];
+	if ( arena == nullptr )
+		return;
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+	Z_ForEachBlock( arena, []( const zhead_t *z ) { Z_TrackFree( z ); } );
+#endif
+
+	for ( unsigned int i = 0; i < Z_NUM_SIZE_CLASSES; ++i )
+	{
+		while ( arena->slabs[ i ] != nullptr )
+		{
+			ZoneSlab *slab = arena->slabs[ i ];
+			Z_AddUsage( arena, i, -( ptrdiff_t ) slab->numUsed, 0, 0, 0 );
+			Z_FreeSlab( slab );
+		}
+	}
+
+	while ( arena->large != nullptr )
+	{
+		ZoneLarge *large = arena->large;
+		Z_Unlink( &arena->large, large, &ZoneLarge::prev, &ZoneLarge::next );
+		Z_AddUsage( arena, Z_LARGE_CLASS, -1, 0, -( ptrdiff_t ) large->size, 0 );
+
+		M_Free( large );
+	}
+
+	// the rate and peak are kept, as they're about the tag rather than what's in it
+	z_liveBytes -= arena->usage.numBytes;
+	arena->usage.numBlocks = arena->usage.numBytes = arena->usage.numReserved = arena->usage.numSlabs = 0;
+}
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+void *Z_TagMallocSite( size_t size, int16_t tag, zsite_t *site )
+#else
+void *Z_TagMalloc( size_t size, int16_t tag )
+#endif
+{
+	z_numHeapAllocs.fetch_add( 1, std::memory_order_relaxed );
+
+	unsigned int sizeClass = Z_GetSizeClass( size );
+
+	zhead_t *z;
+	if ( sizeClass == Z_LARGE_CLASS )
+	{
+		size_t reserved = sizeof( ZoneLarge ) + sizeof( zhead_t ) + size;
+		auto   large    = static_cast< ZoneLarge * >( M_Alloc( reserved ) );
+		large->size     = reserved;
+
+		z            = reinterpret_cast< zhead_t * >( large + 1 );
+		z->owner     = large;
+		z->sizeClass = Z_LARGE_CLASS;
+		z->size      = ( uint32_t ) size;
+
+		std::lock_guard< std::mutex > lock( z_mutex );
+
+		ZoneArena *arena = Z_GetArena( tag );
+		large->arena     = arena;
+		Z_LinkHead( &arena->large, large, &ZoneLarge::prev, &ZoneLarge::next );
+		Z_AddUsage( arena, Z_LARGE_CLASS, 1, size, reserved, 0 );
+
+		z->magic = Z_MAGIC;
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+		Z_TrackAlloc( z, site );
+#endif
+	}
+	else
+	{
+		{
+			std::lock_guard< std::mutex > lock( z_mutex );
+
+			ZoneArena *arena = Z_GetArena( tag );
+			z                = Z_AllocSmall( arena, sizeClass );
+			if ( z != nullptr )
+			{
+				Z_AddUsage( arena, sizeClass, 1, size, 0, 0 );
+
+				z->size  = ( uint32_t ) size;
+				z->magic = Z_MAGIC;
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+				Z_TrackAlloc( z, site );
+#endif
+			}
+		}
+
+		if ( z == nullptr )
+			Com_Error( ERR_FATAL, "Z_Malloc: failed on allocation of %zu bytes", size );
+
+		memset( z + 1, 0, size );
+	}
+
+	return ( void * ) ( z + 1 );
+}
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+void *Z_TagMalloc( size_t size, int16_t tag ) { return Z_TagMallocSite( size, tag, nullptr ); }
+#endif
+
+void *Z_Malloc( size_t size ) { return Z_TagMalloc( size, 0 ); }
+
+/*
+==============================================================================
+
+FRAME SCRATCH
+
+Every thread gets its own block to bump allocate transient memory out of.
+The main thread's is reset at the top of each frame, so anything handed out
+is good until then. Threads that never reset theirs just wrap around to the
+start once they hit the end, so allocations there only live for as long as
+it takes to get through the rest of the block.
+
+Anything that doesn't fit spills out to the heap until the next reset, at
+which point the block's grown so it fits next time.
+
+==============================================================================
+*/
+
+static constexpr size_t Z_SCRATCH_SIZE     = 256 * 1024;
+static constexpr size_t Z_SCRATCH_MAX_SIZE = 4 * 1024 * 1024;
+
+struct ZoneSpill
+{
+	ZoneSpill *next;
+	size_t     size;
+};
+
+struct ZoneScratch
+{
+	byte      *base{};
+	size_t     size{};
+	size_t     used{};
+	size_t     peak{};        /* most used since the last reset, including spills */
+	size_t     spilled{};     /* bytes that went to the heap since the last reset */
+	ZoneSpill *spills{};      /* freed on reset, or a lap after they were made if it wraps */
+	ZoneSpill *spillsPrev{};  /* from the lap before */
+	bool       frameScoped{}; /* reset explicitly, rather than wrapping */
+
+	~ZoneScratch()
+	{
+		FreeSpills( spills );
+		FreeSpills( spillsPrev );
+		M_Free( base );
+	}
+
+	static void FreeSpills( ZoneSpill *spill )
+	{
+		while ( spill != nullptr )
+		{
+			ZoneSpill *next = spill->next;
+			M_Free( spill );
+			spill = next;
+		}
+	}
+};
+
+static thread_local ZoneScratch z_scratch;
+
+// for z_stats; only ever touched from the main thread
+static size_t       z_scratchSize;
+static size_t       z_scratchPeak;
+static unsigned int z_frameHeapAllocs;
+static unsigned int z_frameHeapAllocsMark;
+static unsigned int z_frameCount;
+static unsigned int z_snapshotFrame;
+
+static ZoneScratch &Z_GetScratch()
+{
+	ZoneScratch &s = z_scratch;
+	if ( s.base == nullptr )
+	{
+		s.size = Z_SCRATCH_SIZE;
+		s.base = static_cast< byte * >( M_Alloc( s.size ) );
+	}
+
+	return s;
+}
+
+static void *Z_SpillScratch( ZoneScratch &s, size_t size )
+{
+	z_numHeapAllocs.fetch_add( 1, std::memory_order_relaxed );
+
+	auto spill  = static_cast< ZoneSpill * >( M_Alloc( sizeof( ZoneSpill ) + Z_ALIGNMENT + size ) );
+	spill->size = size;
+	spill->next = s.spills;
+	s.spills    = spill;
+
+	s.spilled += size;
+	s.peak = std::max( s.peak, s.used + s.spilled );
+
+	return reinterpret_cast< byte * >( spill ) + ( ( sizeof( ZoneSpill ) + Z_ALIGNMENT - 1 ) & ~( Z_ALIGNMENT - 1 ) );
+}
+
+/**
+ * Hands out transient memory from the calling thread's scratch block.
+ * It's not cleared, and mustn't be freed.
+ */
+void *Z_ScratchAlloc( size_t size )
+{
+	ZoneScratch &s = Z_GetScratch();
+
+	size = ( size + Z_ALIGNMENT - 1 ) & ~( Z_ALIGNMENT - 1 );
+	if ( s.used + size > s.size )
+	{
+		if ( s.frameScoped || size > s.size )
+			return Z_SpillScratch( s, size );
+
+		// start the next lap; anything spilled two laps ago is long gone by now
+		ZoneScratch::FreeSpills( s.spillsPrev );
+		s.spillsPrev = s.spills;
+		s.spills     = nullptr;
+		s.spilled    = 0;
+		s.used       = 0;
+	}
+
+	void *ptr = s.base + s.used;
+	s.used += size;
+	s.peak = std::max( s.peak, s.used + s.spilled );
+
+	return ptr;
+}
+
+/**
+ * Formats straight into the scratch block where it fits, so only the one
+ * pass is needed in the common case.
+ */
+char *Z_ScratchVPrintf( const char *fmt, va_list args )
+{
+	ZoneScratch &s = Z_GetScratch();
+
+	size_t  available = s.size - s.used;
+	va_list argsCopy;
+	va_copy( argsCopy, args );
+	int length = vsnprintf( reinterpret_cast< char * >( s.base + s.used ), available, fmt, argsCopy );
+	va_end( argsCopy );
+	if ( length < 0 )
+		length = 0;
+
+	if ( ( size_t ) length < available )
+		return static_cast< char * >( Z_ScratchAlloc( length + 1 ) );
+
+	auto out = static_cast< char * >( Z_ScratchAlloc( length + 1 ) );
+	vsnprintf( out, length + 1, fmt, args );
+	return out;
+}
+
+/**
+ * Rewinding back to a mark hands back everything allocated since, for
+ * callers that are done with their scratch before they return.
+ */
+size_t Z_ScratchMark()
+{
+	return Z_GetScratch().used;
+}
+
+void Z_ScratchRewind( size_t mark )
+{
+	// if it's wrapped since, there's no telling what's still in use
+	ZoneScratch &s = Z_GetScratch();
+	if ( mark <= s.used )
+		s.used = mark;
+}
+
+/**
+ * Throws away everything in the calling thread's scratch block. Once a thread
+ * has done this, it's expected to keep doing so, and the block stops wrapping.
+ */
+void Z_ResetScratch()
+{
+	ZoneScratch &s = Z_GetScratch();
+	s.frameScoped  = true;
+
+	ZoneScratch::FreeSpills( s.spills );
+	ZoneScratch::FreeSpills( s.spillsPrev );
+	s.spills = s.spillsPrev = nullptr;
+
+	// grow so whatever spilled fits next time
+	if ( s.spilled > 0 && s.size < Z_SCRATCH_MAX_SIZE )
+	{
+		size_t size = s.size;
+		while ( size < s.peak && size < Z_SCRATCH_MAX_SIZE )
+			size *= 2;
+
+		z_numHeapAllocs.fetch_add( 1, std::memory_order_relaxed );
+
+		M_Free( s.base );
+		s.base = static_cast< byte * >( M_Alloc( size ) );
+		s.size = size;
+	}
+
+	s.used    = 0;
+	s.spilled = 0;
+	s.peak    = 0;
+}
+
+/**
+ * Called from the main thread at the top of every frame.
+ */
+void Z_BeginFrame()
+{
+	z_frameCount++;
+
+	const ZoneScratch &s = Z_GetScratch();
+	z_scratchPeak        = s.peak;
+
+	Z_ResetScratch();
+
+	z_scratchSize = s.size;
+
+	unsigned int numHeapAllocs = z_numHeapAllocs.load( std::memory_order_relaxed );
+	z_frameHeapAllocs          = numHeapAllocs - z_frameHeapAllocsMark;
+	z_frameHeapAllocsMark      = numHeapAllocs;
+}
+
+/**
+ * How many times the heap was gone to over the last frame, by any thread.
+ */
+unsigned int Z_GetFrameHeapAllocs()
+{
+	return z_frameHeapAllocs;
+}
+
+/*
+================
+Z_Stats_f
+
+Reports what's in use by each tag and each size class
+================
+*/
+void Z_Stats_f()
+{
+	std::vector< std::pair< int16_t, ZoneUsage > > tags;
+	ZoneUsage                                      classes[ Z_NUM_SIZE_CLASSES + 1 ];
+	{
+		std::lock_guard< std::mutex > lock( z_mutex );
+		for ( const ZoneArena *arena : z_arenas )
+		{
+			if ( arena != nullptr && arena->usage.numReserved > 0 )
+				tags.emplace_back( arena->tag, arena->usage );
+		}
+
+		memcpy( classes, z_classUsage, sizeof( classes ) );
+	}
+
+	// printing allocates, so it's held off until the lock's let go of
+	ZoneUsage total{};
+	Com_Printf( "Tags:\n" );
+	for ( const auto &i : tags )
+	{
+		Com_Printf( "  %6d: %8zu blocks, %10.2fKB used, %10.2fKB reserved (%zu slabs)\n",
+		            i.first, i.second.numBlocks, i.second.numBytes / 1024.0, i.second.numReserved / 1024.0, i.second.numSlabs );
+
+		total.numBlocks += i.second.numBlocks;
+		total.numBytes += i.second.numBytes;
+		total.numReserved += i.second.numReserved;
+	}
+
+	Com_Printf( "Size classes:\n" );
+	for ( unsigned int i = 0; i <= Z_NUM_SIZE_CLASSES; ++i )
+	{
+		if ( classes[ i ].numReserved == 0 )
+			continue;
+
+		if ( i < Z_NUM_SIZE_CLASSES )
+			Com_Printf( "  %6u: %8zu blocks, %10.2fKB reserved (%zu slabs)\n",
+			            z_sizeClasses[ i ], classes[ i ].numBlocks, classes[ i ].numReserved / 1024.0, classes[ i ].numSlabs );
+		else
+			Com_Printf( "   large: %8zu blocks, %10.2fKB reserved\n", classes[ i ].numBlocks, classes[ i ].numReserved / 1024.0 );
+	}
+
+	Com_Printf( "%zu bytes in %zu blocks, %zu bytes reserved\n", total.numBytes, total.numBlocks, total.numReserved );
+	Com_Printf( "Scratch: %.2fKB, %.2fKB used last frame, %u heap allocations last frame\n",
+	            z_scratchSize / 1024.0, z_scratchPeak / 1024.0, z_frameHeapAllocs );
+}
+
+static void Z_Snapshot()
+{
+	{
+		std::lock_guard< std::mutex > lock( z_mutex );
+		for ( ZoneArena *arena : z_arenas )
+		{
+			if ( arena != nullptr )
+			{
+				arena->numAllocsMark = arena->usage.numAllocs;
+				arena->numBytesMark  = arena->usage.numBytes;
+			}
+		}
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+		for ( zsite_t *site = z_sites; site != nullptr; site = site->next )
+			site->numAllocsMark = site->numAllocs;
+
+		z_snapshotSerial = z_serial;
+#endif
+	}
+
+	z_snapshotFrame = z_frameCount;
+
+	Hunk_Snapshot();
+
+	Com_Printf( "Snapshot taken, use \"mem_report diff\" to see what's changed since\n" );
+}
+
+static void Z_ReportDiff()
+{
+	std::vector< std::pair< int16_t, ptrdiff_t > > tags;
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+	struct Survivor
+	{
+		size_t numBlocks;
+		size_t numBytes;
+	};
+	std::map< std::pair< const zsite_t *, int16_t >, Survivor > survivors;
+#endif
+	{
+		std::lock_guard< std::mutex > lock( z_mutex );
+		for ( const ZoneArena *arena : z_arenas )
+		{
+			if ( arena == nullptr || arena->usage.numBytes == arena->numBytesMark )
+				continue;
+
+			tags.emplace_back( arena->tag, ( ptrdiff_t ) arena->usage.numBytes - ( ptrdiff_t ) arena->numBytesMark );
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+			auto countSurvivor = [ & ]( const zhead_t *z )
+			{
+				if ( z->serial <= z_snapshotSerial )
+					return;
+
+				Survivor &survivor = survivors[ { z->site, arena->tag } ];
+				survivor.numBlocks++;
+				survivor.numBytes += z->size;
+			};
+			Z_ForEachBlock( arena, countSurvivor );
+#endif
+		}
+	}
+
+	Com_Printf( "Tags that have changed since the snapshot:\n" );
+	for ( const auto &i : tags )
+		Com_Printf( "  %6d: %+10.2fKB\n", i.first, i.second / 1024.0 );
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+	std::vector< std::pair< std::pair< const zsite_t *, int16_t >, Survivor > > sorted( survivors.begin(), survivors.end() );
+	std::sort( sorted.begin(), sorted.end(), []( const auto &a, const auto &b ) { return a.second.numBytes > b.second.numBytes; } );
+
+	Survivor total{};
+	Com_Printf( "Allocations made since the snapshot that are still around:\n" );
+	for ( const auto &i : sorted )
+	{
+		const zsite_t *site = i.first.first;
+		Com_Printf( "  %24s:%-5i tag %6d: %8zu blocks, %10.2fKB\n",
+		            COM_SkipPath( ( char * ) site->file ), site->line, i.first.second, i.second.numBlocks, i.second.numBytes / 1024.0 );
+
+		total.numBlocks += i.second.numBlocks;
+		total.numBytes += i.second.numBytes;
+	}
+
+	Com_Printf( "%zu blocks, %.2fKB in total\n", total.numBlocks, total.numBytes / 1024.0 );
+#else
+	Com_Printf( "Build with CHRONON_TRACK_ALLOCATIONS to see which allocations survived\n" );
+#endif
+
+	Hunk_ReportSinceSnapshot();
+}
+
+static void Z_ReportSummary()
+{
+	std::vector< std::pair< int16_t, ZoneUsage > > tags;
+	size_t                                         liveBytes, peakBytes;
+	size_t                                         numFrames = std::max( 1U, z_frameCount - z_snapshotFrame );
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+	std::vector< zsite_t > sites;
+#endif
+	{
+		std::lock_guard< std::mutex > lock( z_mutex );
+		for ( const ZoneArena *arena : z_arenas )
+		{
+			if ( arena == nullptr || arena->usage.numAllocs == 0 )
+				continue;
+
+			ZoneUsage usage = arena->usage;
+			usage.numAllocs -= arena->numAllocsMark;
+			tags.emplace_back( arena->tag, usage );
+		}
+
+		liveBytes = z_liveBytes;
+		peakBytes = z_peakBytes;
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+		for ( const zsite_t *site = z_sites; site != nullptr; site = site->next )
+			sites.push_back( *site );
+#endif
+	}
+
+	Com_Printf( "Zone: %.2fKB live, %.2fKB at most, %u heap allocations last frame\n",
+	            liveBytes / 1024.0, peakBytes / 1024.0, z_frameHeapAllocs );
+
+	Com_Printf( "Tags (allocations per frame are since the last snapshot):\n" );
+	for ( const auto &i : tags )
+	{
+		Com_Printf( "  %6d: %8zu blocks, %10.2fKB live, %10.2fKB at most, %8.2f allocations per frame\n",
+		            i.first, i.second.numBlocks, i.second.numBytes / 1024.0, i.second.peakBytes / 1024.0,
+		            ( double ) i.second.numAllocs / numFrames );
+	}
+
+#if defined( CHRONON_TRACK_ALLOCATIONS )
+	static constexpr size_t MAX_SITES = 32;
+
+	std::sort( sites.begin(), sites.end(), []( const zsite_t &a, const zsite_t &b ) { return a.liveBytes > b.liveBytes; } );
+	if ( sites.size() > MAX_SITES )
+		sites.resize( MAX_SITES );
+
+	Com_Printf( "Sites:\n" );
+	for ( const zsite_t &site : sites )
+	{
+		Com_Printf( "  %24s:%-5i %8zu blocks, %10.2fKB live, %10.2fKB at most, %8.2f allocations per frame\n",
+		            COM_SkipPath( ( char * ) site.file ), site.line, site.numLive, site.liveBytes / 1024.0, site.peakBytes / 1024.0,
+		            ( double ) ( site.numAllocs - site.numAllocsMark ) / numFrames );
+	}
+#endif
+
+	Com_Printf( "Hunks:\n" );
+	Hunk_Stats_f();
+}
+
+/*
+================
+Z_Report_f
+
+mem_report [snapshot|diff]
+================
+*/
+void Z_Report_f()
+{
+	if ( Cmd_Argc() > 2 )
+	{
+		Com_Printf( "usage: mem_report [snapshot|diff]\n" );
+		return;
+	}
+
+	const char *mode = Cmd_Argv( 1 );
+	if ( *mode == '\0' )
+		Z_ReportSummary();
+	else if ( !Q_strcasecmp( mode, "snapshot" ) )
+		Z_Snapshot();
+	else if ( !Q_strcasecmp( mode, "diff" ) )
+		Z_ReportDiff();
+	else
+		Com_Printf( "unknown mode \"%s\", expected snapshot or diff\n", mode );
+}
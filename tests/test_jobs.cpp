@@ -0,0 +1,289 @@
+/******************************************************************************
+	Copyright © 2020-2025 Mark E Sowden <hogsy@oldtimes-software.com>
+
+	This program is free software; you can redistribute it and/or
+	modify it under the terms of the GNU General Public License
+	as published by the Free Software Foundation; either version 2
+	of the License, or (at your option) any later version.
+
+	This program is distributed in the hope that it will be useful,
+	but WITHOUT ANY WARRANTY; without even the implied warranty of
+	MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+
+	See the GNU General Public License for more details.
+
+	You should have received a copy of the GNU General Public License
+	along with this program; if not, write to the Free Software
+	Foundation, Inc., 59 Temple Place - Suite 330, Boston, MA  02111-1307, USA.
+******************************************************************************/
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "qcommon/qcommon.h"
+
+/*
+==============================================================================
+
+Exercises the job system on its own, run with the number of workers to
+start (0 runs everything as it's submitted).
+
+==============================================================================
+*/
+
+/* === just enough of the engine for jobs.cpp === */
+
+static cvar_t com_workers;
+
+cvar_t *Cvar_Get( const char *var_name, const char *value, int flags )
+{
+	return &com_workers;
+}
+
+void Com_Printf( const char *fmt, ... )
+{
+	va_list argptr;
+	va_start( argptr, fmt );
+	vprintf( fmt, argptr );
+	va_end( argptr );
+}
+
+char *va( const char *format, ... )
+{
+	static thread_local char string[ 1024 ];
+
+	va_list argptr;
+	va_start( argptr, format );
+	vsnprintf( string, sizeof( string ), format, argptr );
+	va_end( argptr );
+
+	return string;
+}
+
+std::atomic< bool > prof_active;
+void                Prof_BeginZone( const char *name ) {}
+void                Prof_EndZone() {}
+void                Prof_SetThreadName( const char *name ) {}
+
+/* === tests === */
+
+static int numFailed;
+
+#define CHECK( CONDITION )                                                        \
+	do                                                                            \
+	{                                                                             \
+		if ( !( CONDITION ) )                                                     \
+		{                                                                         \
+			printf( "%s:%d: check failed: %s\n", __FILE__, __LINE__, #CONDITION ); \
+			numFailed++;                                                          \
+		}                                                                         \
+	} while ( 0 )
+
+/**
+ * Every index should be visited exactly once, whatever the grain.
+ */
+static void Test_ParallelFor()
+{
+	static constexpr size_t NUM_INDICES = 100000;
+
+	for ( size_t grain : { size_t( 1 ), size_t( 7 ), size_t( 1000 ), NUM_INDICES * 2 } )
+	{
+		std::vector< std::atomic< unsigned int > > visits( NUM_INDICES );
+		Job_ParallelFor( 0, NUM_INDICES, [ & ]( size_t i )
+		{
+			visits[ i ]++;
+		}, grain );
+
+		size_t numWrong = 0;
+		for ( const auto &i : visits )
+		{
+			if ( i.load() != 1 )
+				numWrong++;
+		}
+		CHECK( numWrong == 0 );
+	}
+
+	// nothing to do shouldn't call anything
+	unsigned int numCalls = 0;
+	Job_ParallelFor( 10, 10, [ & ]( size_t i )
+	{
+		numCalls++;
+	} );
+	CHECK( numCalls == 0 );
+}
+
+static std::atomic< unsigned int > test_numFinished;
+static unsigned int                test_numSeenByDependent;
+
+/**
+ * A job depending on a counter mustn't start until everything on that
+ * counter has finished.
+ */
+static void Test_Dependencies()
+{
+	static constexpr unsigned int NUM_JOBS = 64;
+
+	test_numFinished        = 0;
+	test_numSeenByDependent = 0;
+
+	jobcounter_t first, second;
+	for ( unsigned int i = 0; i < NUM_JOBS; ++i )
+	{
+		Job_Submit( { []( void *data, size_t begin, size_t end )
+		              {
+			              std::this_thread::sleep_for( std::chrono::microseconds( 200 ) );
+			              test_numFinished++;
+		              } },
+		            &first );
+	}
+
+	Job_Submit( { []( void *data, size_t begin, size_t end )
+	              {
+		              test_numSeenByDependent = test_numFinished.load();
+	              } },
+	            &second, &first );
+
+	CHECK( Job_Wait( &second ) );
+	CHECK( first.count.load() == 0 );
+	CHECK( test_numSeenByDependent == NUM_JOBS );
+}
+
+/**
+ * Waiting with a timeout gives up if the counter doesn't get there in
+ * time, and otherwise sees it through.
+ */
+static void Test_WaitTimeout()
+{
+	// held open by hand, as if a job were still running against it
+	jobcounter_t gate;
+	gate.count = 1;
+
+	std::atomic< bool > ran{ false };
+	jobcounter_t        parked;
+	Job_Submit( { []( void *data, size_t begin, size_t end )
+	              {
+		              *( std::atomic< bool > * ) data = true;
+	              },
+	              &ran },
+	            &parked, &gate );
+
+	CHECK( !Job_Wait( &parked, 20 ) );
+	CHECK( !ran.load() );
+
+	// parked jobs are looked at again as other counters finish
+	gate.count = 0;
+
+	jobcounter_t nudge;
+	Job_Submit( { []( void *data, size_t begin, size_t end ) {} }, &nudge );
+	CHECK( Job_Wait( &nudge ) );
+
+	CHECK( Job_Wait( &parked, 5000 ) );
+	CHECK( ran.load() );
+}
+
+static std::atomic< bool > test_release;
+static std::thread::id     test_mainThread;
+
+/**
+ * Once a queue is full, jobs are run there and then by whoever submitted
+ * them rather than being lost.
+ */
+static void Test_QueueOverflow()
+{
+	// comfortably more than a queue holds, plus whatever the workers are holding on to
+	static constexpr unsigned int NUM_JOBS = 4096;
+
+	static std::atomic< unsigned int > numRun, numRunInline;
+	numRun       = 0;
+	numRunInline = 0;
+	test_release = false;
+
+	jobcounter_t counter;
+	for ( unsigned int i = 0; i < NUM_JOBS; ++i )
+	{
+		Job_Submit( { []( void *data, size_t begin, size_t end )
+		              {
+			              // workers hang on to what they've taken, so the queue fills up
+			              if ( std::this_thread::get_id() == test_mainThread )
+				              numRunInline++;
+			              else
+			              {
+				              while ( !test_release.load() )
+					              std::this_thread::yield();
+			              }
+			              numRun++;
+		              } },
+		            &counter );
+	}
+
+	// anything that didn't fit has already been run
+	unsigned int numQueued = NUM_JOBS - numRunInline.load();
+	CHECK( numQueued <= 1024 + Job_GetNumWorkers() );
+
+	test_release = true;
+	CHECK( Job_Wait( &counter ) );
+	CHECK( numRun.load() == NUM_JOBS );
+}
+
+/**
+ * Background jobs all get done, but never by the main thread unless
+ * there's nobody else to do them.
+ */
+static void Test_Background()
+{
+	static constexpr unsigned int NUM_JOBS = 256;
+
+	static std::atomic< unsigned int > numRun, numRunOnMain;
+	numRun       = 0;
+	numRunOnMain = 0;
+
+	jobcounter_t background, foreground;
+	for ( unsigned int i = 0; i < NUM_JOBS; ++i )
+	{
+		Job_SubmitBackground( { []( void *data, size_t begin, size_t end )
+		                        {
+			                        if ( std::this_thread::get_id() == test_mainThread )
+				                        numRunOnMain++;
+			                        numRun++;
+		                        } },
+		                      &background );
+		Job_Submit( { []( void *data, size_t begin, size_t end ) {} }, &foreground );
+	}
+
+	CHECK( Job_Wait( &foreground ) );
+	CHECK( Job_Wait( &background ) );
+	CHECK( numRun.load() == NUM_JOBS );
+	if ( Job_GetNumWorkers() > 0 )
+		CHECK( numRunOnMain.load() == 0 );
+	else
+		CHECK( numRunOnMain.load() == NUM_JOBS );
+}
+
+int main( int argc, char **argv )
+{
+	com_workers.value = ( argc > 1 ) ? ( float ) atoi( argv[ 1 ] ) : 0.0f;
+	test_mainThread   = std::this_thread::get_id();
+
+	Job_Init();
+	printf( "%u workers\n", Job_GetNumWorkers() );
+
+	Test_ParallelFor();
+	Test_Dependencies();
+	Test_WaitTimeout();
+	Test_QueueOverflow();
+	Test_Background();
+
+	Job_Shutdown();
+
+	if ( numFailed > 0 )
+	{
+		printf( "%d checks failed\n", numFailed );
+		return EXIT_FAILURE;
+	}
+
+	printf( "all passed\n" );
+	return EXIT_SUCCESS;
+}